@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AGGREGATE_MAP_H__
+#define __AGGREGATE_MAP_H__
+
+#include "array_list.h"
+#include "hash_map.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A map from fixed-size keys to 64 bit integers that many threads can
+ * update at once without locks, for counting or aggregating by key. Every
+ * update combines a value into the key's value with the operation picked
+ * when the map is created (sum, maximum or minimum), so there is no need to
+ * get the value first and put it back.
+ *
+ * Keys are claimed with compare-and-swap and values are updated with atomic
+ * operations. A thread never waits for another one: when the buckets fill
+ * up, a bigger set of buckets is chained after them and updates only go to
+ * the newest set. Each update also moves a few buckets of the older sets
+ * into the newest one, so the values gather there without stopping the
+ * other threads. Keys are compared byte by byte.
+ *
+ * Because no thread waits for a key being inserted or moved by another, the
+ * same key can end up in more than one bucket. As the operation combines
+ * values in any order, agmap_get and the drains combine those buckets and
+ * see one value per key. Lookups look at every set of buckets, so a good
+ * capacity hint keeps them fast.
+ */
+typedef struct aggregate_map aggregate_map;
+
+typedef enum agmap_op
+{
+  AGMAP_SUM,
+  AGMAP_MAX,
+  AGMAP_MIN
+} agmap_op;
+
+/**
+ * Constructs an aggregate map.
+ *
+ * @param key_size - Size of each key
+ * @param op - How values of the same key are combined
+ * @param hasher - Key hasher, NULL hashes the bytes of the key
+ * @param capacity - Number of keys expected, 0 picks a default
+ *
+ * @return NULL if key_size is zero or the map cannot be allocated
+ */
+aggregate_map *new_agmap            (size_t key_size,
+                                     agmap_op op,
+                                     hash_func *hasher,
+                                     size_t capacity);
+
+/**
+ * Destroys an aggregate map. No other thread may be using the map.
+ *
+ * @param map - Aggregate map being destroyed
+ */
+void delete_agmap                   (aggregate_map *map);
+
+/**
+ * Combines a value into the value of a key: adds it, or keeps the larger or
+ * smaller of the two. A new key starts with the value. Safe to call from any
+ * number of threads at once.
+ *
+ * @param map - Aggregate map
+ * @param key - Pointer to key
+ * @param value - Value being combined
+ *
+ * @return true if the value was combined, false if the key was new and
+ * memory could not be allocated
+ */
+bool agmap_update                   (aggregate_map *restrict map,
+                                     const void *restrict key,
+                                     int64_t value);
+
+/**
+ * Retrieves the value of a key. Updates happening at the same time might or
+ * might not be seen.
+ *
+ * @param map - Aggregate map
+ * @param key - Pointer to key
+ * @param out - Outputs the value if the key exists
+ *
+ * @return true if the key exists
+ */
+bool agmap_get                      (const aggregate_map *restrict map,
+                                     const void *restrict key,
+                                     int64_t *restrict out);
+
+/**
+ * Returns the size of the records produced by the drains: the key, followed
+ * by its value as an int64_t at agmap_value_offset.
+ *
+ * @param map - Aggregate map
+ *
+ * @return size of a record
+ */
+size_t agmap_record_size            (const aggregate_map *map);
+
+/**
+ * Returns the offset of the value inside a record
+ *
+ * @param map - Aggregate map
+ *
+ * @return offset of the value
+ */
+size_t agmap_value_offset           (const aggregate_map *map);
+
+/**
+ * Appends a record for every key to an array list and empties the map. No
+ * other thread may be using the map during this call.
+ *
+ * @param map - Aggregate map
+ * @param out - Array list initialized with agmap_record_size as data size
+ *
+ * @return true if every record was appended, false if the data size of out
+ * is wrong or memory could not be allocated, in which case the map is left
+ * as it was
+ */
+bool agmap_drain                    (aggregate_map *restrict map,
+                                     array_list *restrict out);
+
+/**
+ * Same as agmap_drain, then puts every appended record into a hash map. The
+ * hash map stores pointers into the array list, so the list must not grow
+ * or be freed while the map is in use. Its hasher and key comparator receive
+ * records, which start with the key. Out is grown to fit every key before
+ * the map is drained, so a failed allocation leaves the map and records as
+ * they were, though out may have grown.
+ *
+ * Draining would grow records, so it is refused if out already holds
+ * records of that list. Draining again into the same hash map needs a new
+ * array list every time.
+ *
+ * @param map - Aggregate map
+ * @param records - Array list initialized with agmap_record_size as data size
+ * @param out - Pointer to initialized hash map
+ *
+ * @return true if every record was appended and put into out, false if
+ * out already holds records of that list or memory could not be allocated
+ */
+bool agmap_drain_hmap               (aggregate_map *restrict map,
+                                     array_list *restrict records,
+                                     hash_map *restrict out);
+
+#endif
@@ -17,28 +17,34 @@
 #ifndef __ARRAY_LIST_H__
 #define __ARRAY_LIST_H__
 
+#include "growth_policy.h"
+
 #include <stddef.h>
 #include <stdbool.h>
 
 /**
- * The growth function for the array list.
- *
- * By default, the capacity is scaled to the next multiple of 16.
+ * The number of bytes of items stored inside the list itself. A list holding
+ * no more than this many bytes of items does not allocate; once it grows
+ * past this, the items move to the heap. The library and its users must
+ * agree on this size.
  *
- * @param n - The precomputed new capacity
- *
- * @return value >= n
+ * By default, the size of four pointers
  */
-#ifndef ARRLIST_GROW /* (size_t n) */
-#define ARRLIST_GROW(n) ((((n) / 16) + 1) * 16)
+#ifndef ARRLIST_INLINE
+#define ARRLIST_INLINE (4 * sizeof(char *))
 #endif
 
 typedef struct array_list
 {
   size_t len;
-  size_t cap;
+  size_t cap; /* at most ARRLIST_INLINE / blk while items are inline */
   size_t blk;
-  char *mem;
+  union
+  {
+    char *heap;
+    char local[ARRLIST_INLINE];
+  } mem;
+  growth_policy growth;
 } array_list;
 
 /**
@@ -94,7 +100,147 @@ void arrlist_compact                (array_list *list);
 void arrlist_reverse                (array_list *list);
 
 /**
- * Ensures the capacity is at least n.
+ * Sorts an array list in-place using pattern-defeating quicksort. Lists of
+ * elements of 1, 2, 4, 8 or 16 bytes are sorted directly, others by sorting
+ * pointers to the elements first and then moving each element once. To
+ * have the comparison inlined, see SORT_DEFINE in typed_sort.h.
+ *
+ * @param list - Pointer to initialized array list
+ * @param cmp - Comparator
+ */
+void arrlist_sort                   (array_list *list,
+                                     int (*cmp)(const void *, const void *));
+
+/**
+ * Sorts an array list in-place using merge sort, keeping elements that
+ * compare equal in the same order.
+ *
+ * @param list - Pointer to initialized array list
+ * @param cmp - Comparator
+ *
+ * @return true if the list was sorted, false if the buffer could not be
+ * allocated, in which case the list is left as it was
+ */
+bool arrlist_sort_stable            (array_list *list,
+                                     int (*cmp)(const void *, const void *));
+
+/**
+ * Finds where the first item not less than key is in a sorted list. The
+ * search does not branch on the comparisons.
+ *
+ * @param list - Pointer to initialized array list, sorted by cmp
+ * @param key - Pointer to the item being looked for
+ * @param cmp - Comparator, called with an item of the list first
+ *
+ * @return zero-based index of that item, the size of the list if there is
+ * none
+ */
+size_t arrlist_lower_bound          (const array_list *restrict list,
+                                     const void *restrict key,
+                                     int (*cmp)(const void *, const void *));
+
+/**
+ * Finds where the first item greater than key is in a sorted list. The
+ * search does not branch on the comparisons.
+ *
+ * @param list - Pointer to initialized array list, sorted by cmp
+ * @param key - Pointer to the item being looked for
+ * @param cmp - Comparator, called with an item of the list first
+ *
+ * @return zero-based index of that item, the size of the list if there is
+ * none
+ */
+size_t arrlist_upper_bound          (const array_list *restrict list,
+                                     const void *restrict key,
+                                     int (*cmp)(const void *, const void *));
+
+/**
+ * Finds the first item equal to key in a sorted list.
+ *
+ * @param list - Pointer to initialized array list, sorted by cmp
+ * @param key - Pointer to the item being looked for
+ * @param cmp - Comparator, called with an item of the list first
+ *
+ * @return Pointer to the item, NULL if there is none
+ */
+const void *arrlist_bsearch         (const array_list *restrict list,
+                                     const void *restrict key,
+                                     int (*cmp)(const void *, const void *));
+
+/**
+ * Inserts an item into a sorted list after the items equal to it, keeping
+ * the list sorted.
+ *
+ * @param list - Pointer to initialized array list, sorted by cmp
+ * @param el - Pointer to the item being inserted
+ * @param cmp - Comparator, called with an item of the list first
+ *
+ * @return true if item was successfully inserted
+ */
+bool arrlist_insert_sorted          (array_list *restrict list,
+                                     const void *restrict el,
+                                     int (*cmp)(const void *, const void *));
+
+/**
+ * Merges the items of another sorted list into a sorted list in a single
+ * pass, growing it at most once. Items of the list come before the equal
+ * items of the other list.
+ *
+ * @param list - Pointer to initialized array list, sorted by cmp
+ * @param other - Pointer to a different array list of the same data size,
+ *                sorted by cmp; left unchanged
+ * @param cmp - Comparator
+ *
+ * @return true if the lists were merged, false if the data sizes differ or
+ * memory could not be allocated, in which case the list is left as it was
+ */
+bool arrlist_merge_sorted           (array_list *restrict list,
+                                     const array_list *restrict other,
+                                     int (*cmp)(const void *, const void *));
+
+/**
+ * Reorders a sorted list into Eytzinger order: the items of an implicit
+ * binary search tree, level by level. Lookups on the list then walk the
+ * array front to back and the next levels can be prefetched, which helps
+ * once the list is much larger than the cache. Until arrlist_from_eytzinger
+ * is called, the list should only be searched with
+ * arrlist_eytzinger_lower_bound.
+ *
+ * @param list - Pointer to initialized array list, sorted
+ *
+ * @return true if the list was reordered, false if the temporary copy could
+ * not be allocated, in which case the list is left as it was
+ */
+bool arrlist_to_eytzinger           (array_list *list);
+
+/**
+ * Reorders a list in Eytzinger order back into sorted order.
+ *
+ * @param list - Pointer to initialized array list, in Eytzinger order
+ *
+ * @return true if the list was reordered, false if the temporary copy could
+ * not be allocated, in which case the list is left as it was
+ */
+bool arrlist_from_eytzinger         (array_list *list);
+
+/**
+ * Finds where the first item not less than key is in a list in Eytzinger
+ * order. The search does not branch on the comparisons.
+ *
+ * @param list - Pointer to initialized array list, in Eytzinger order
+ * @param key - Pointer to the item being looked for
+ * @param cmp - Comparator, called with an item of the list first
+ *
+ * @return zero-based index of that item in the reordered list, the size of
+ * the list if there is none
+ */
+size_t arrlist_eytzinger_lower_bound(const array_list *restrict list,
+                                     const void *restrict key,
+                                     int (*cmp)(const void *, const void *));
+
+/**
+ * Ensures the capacity is at least n. The capacity grows following the
+ * list's growth policy, so it can end up larger than n.
  *
  * @param list - Pointer to initialized array list
  * @param n - New minimum capacity of the list
@@ -105,6 +251,18 @@ void arrlist_reverse                (array_list *list);
 bool arrlist_ensure_capacity        (array_list *list,
                                      size_t n);
 
+/**
+ * Changes how the capacity grows once it is too small. The new policy is
+ * applied on the next growth.
+ *
+ * @param list - Pointer to initialized array list
+ * @param policy - New growth policy, NULL for the default one
+ *
+ * @return true if the policy was valid and applied
+ */
+bool arrlist_set_growth             (array_list *restrict list,
+                                     const growth_policy *restrict policy);
+
 /**
  * Adds an item to the end of the list. Behaviour is undefined if the item
  * being added is bigger than the data size defined during list
@@ -118,6 +276,20 @@ bool arrlist_ensure_capacity        (array_list *list,
 bool arrlist_add                    (array_list *restrict list,
                                      const void *restrict el);
 
+/**
+ * Adds count items to the end of the list, growing it at most once.
+ * Behaviour is undefined if the items overlap the list's own storage.
+ *
+ * @param list - Pointer to initialized array list
+ * @param els - Pointer to the first of the items being added
+ * @param count - Number of items being added
+ *
+ * @return true if all items were successfully added, false if none were
+ */
+bool arrlist_add_all                (array_list *restrict list,
+                                     const void *restrict els,
+                                     size_t count);
+
 /**
  * Inserts an item to a specific index of the list. Behaviour is undefined if
  * the item being inserted is bigger than the data size defined during list
@@ -133,6 +305,23 @@ bool arrlist_insert                 (array_list *restrict list,
                                      size_t index,
                                      const void *restrict el);
 
+/**
+ * Inserts count items to a specific index of the list. The items after the
+ * index are shifted towards the end of the list once, by count. Behaviour is
+ * undefined if the items overlap the list's own storage.
+ *
+ * @param list - Pointer to initialized array list
+ * @param index - Zero-based index where the first item will be
+ * @param els - Pointer to the first of the items being inserted
+ * @param count - Number of items being inserted
+ *
+ * @return true if all items were successfully inserted, false if none were
+ */
+bool arrlist_insert_range           (array_list *restrict list,
+                                     size_t index,
+                                     const void *restrict els,
+                                     size_t count);
+
 /**
  * Replaces an item at a specific index of the list. Behaviour is undefined if
  * the item replacing is bigger than the data size defined during list
@@ -165,6 +354,47 @@ bool arrlist_remove                 (array_list *restrict list,
                                      size_t index,
                                      void *restrict out);
 
+/**
+ * Removes the items in the range [lo, hi) of the list. If the upper bound is
+ * past the end of the list, it only removes up until the last item. The
+ * items after the range are shifted towards the head of the list once.
+ *
+ * @param list - Pointer to initialized array list
+ * @param lo - Lower bound of the removal range
+ * @param hi - Upper bound of the removal range
+ *
+ * @return the actual amount of items removed
+ */
+size_t arrlist_remove_range         (array_list *list,
+                                     size_t lo,
+                                     size_t hi);
+
+/**
+ * Removes all items matching the predicate in a single pass, keeping the
+ * order of the other items. The predicate is called once per item, in
+ * order. Each run of items kept is moved at most once.
+ *
+ * @param list - Pointer to initialized array list
+ * @param pred - Predicate to check if an item should be removed
+ *
+ * @return number of items removed
+ */
+size_t arrlist_remove_if            (array_list *list,
+                                     bool (*pred)(const void *));
+
+/**
+ * Removes all items not matching the predicate in a single pass, keeping
+ * the order of the other items. The predicate is called once per item, in
+ * order. Each run of items kept is moved at most once.
+ *
+ * @param list - Pointer to initialized array list
+ * @param pred - Predicate to check if an item should be kept
+ *
+ * @return number of items removed
+ */
+size_t arrlist_retain_if            (array_list *list,
+                                     bool (*pred)(const void *));
+
 /**
  * Iterates through every item of the list. The state of the list, apart from
  * the items stored in the list should be kept consistent during the iteration
@@ -176,6 +406,21 @@ bool arrlist_remove                 (array_list *restrict list,
 void arrlist_foreach                (const array_list *list,
                                      void (*it)(const void *));
 
+/**
+ * Iterates through every item of the list, passing ctx along, until the
+ * action returns false. The state of the list, apart from the items stored
+ * in the list should be kept consistent during the iteration process.
+ *
+ * @param list - Pointer to initialized array list
+ * @param it - An action to be performed on each item, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every item was visited, false if it stopped early
+ */
+bool arrlist_foreach_ctx            (const array_list *list,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
 /**
  * Returns the pointer to the item located at the specified index.
  *
@@ -206,7 +451,8 @@ size_t arrlist_size                 (const array_list *list);
 size_t arrlist_capacity             (const array_list *list);
 
 /**
- * Returns a pointer to the internal buffer
+ * Returns a pointer to the internal buffer. While the items are stored
+ * inside the list, the buffer moves along with the list.
  *
  * @param list - Pointer to initialized array list
  *
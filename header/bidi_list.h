@@ -97,6 +97,36 @@ void list_foreach                   (const bidi_list *list,
 void list_reveach                   (const bidi_list *list,
                                      void (*it)(const void *));
 
+/**
+ * Iterates from the first to last item of the list, passing ctx along, until
+ * the action returns false. The state of the list should be kept consistent
+ * during the iteration process.
+ *
+ * @param list - Pointer to initialized bidi list
+ * @param it - An action to be performed on each item, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every item was visited, false if it stopped early
+ */
+bool list_foreach_ctx               (const bidi_list *list,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
+/**
+ * Iterates from the last to first item of the list, passing ctx along, until
+ * the action returns false. The state of the list should be kept consistent
+ * during the iteration process.
+ *
+ * @param list - Pointer to initialized bidi list
+ * @param it - An action to be performed on each item, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every item was visited, false if it stopped early
+ */
+bool list_reveach_ctx               (const bidi_list *list,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
 /**
  * Returns the size of the bidi list
  *
@@ -24,6 +24,7 @@
 typedef struct bit_array
 {
   size_t c;
+  size_t w; /* number of words allocated */
   unsigned int *b;
 } bit_array;
 
@@ -149,6 +150,22 @@ size_t bitarr_size                  (const bit_array *arr);
 void bitarr_foreach                 (const bit_array *arr,
                                      void (*vis)(bool));
 
+/**
+ * Iterates through a bit array, passing ctx along, until the callback
+ * returns false. All bits are iterated as opposed only the true bits are
+ * being iterated.
+ *
+ * @param arr The bit array being iterated
+ * @param vis The callback function, takes a bit (bool) and ctx as
+ *            parameters, returns false to stop
+ * @param ctx Passed to every call of vis
+ *
+ * @returns true if every bit was visited, false if it stopped early
+ */
+bool bitarr_foreach_ctx             (const bit_array *arr,
+                                     bool (*vis)(bool, void *),
+                                     void *ctx);
+
 /**
  * Performs a bitwise and between two arrays. Only the lhs is modified.
  *
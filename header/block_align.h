@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Alignment of elements stored by size only, shared by the containers that
+ * pack keys and values into one block. C99 cannot ask for the alignment of
+ * a type, so it is derived from the size.
+ */
+
+#ifndef __BLOCK_ALIGN_H__
+#define __BLOCK_ALIGN_H__
+
+#include <stddef.h>
+
+/**
+ * The types with the strictest alignment. A flexible array of these starts
+ * at an address aligned as if it came straight from malloc.
+ */
+typedef union block_max_align
+{
+  long double ld;
+  long long ll;
+  void *p;
+  void (*fp)(void);
+} block_max_align;
+
+typedef struct block_align_probe
+{
+  char c;
+  block_max_align max;
+} block_align_probe;
+
+#define BLOCK_MAX_ALIGN offsetof(block_align_probe, max)
+
+/**
+ * @param size - Size of an element
+ *
+ * @return the alignment of any type of that size: a type's size is always
+ * a multiple of its alignment, which is a power of two no stricter than
+ * BLOCK_MAX_ALIGN
+ */
+static inline
+size_t block_align
+(size_t size)
+{
+  size_t align = 1;
+  while (size > 0 && align < BLOCK_MAX_ALIGN && size % (align * 2) == 0)
+  {
+    align *= 2;
+  }
+  return align;
+}
+
+/**
+ * @param n - Offset being rounded up
+ * @param align - Alignment, a power of two
+ *
+ * @return the smallest multiple of align not under n
+ */
+static inline
+size_t block_round_up
+(size_t n, size_t align)
+{
+  return (n + align - 1) / align * align;
+}
+
+#endif
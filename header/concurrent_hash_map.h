@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CONCURRENT_HASH_MAP_H__
+#define __CONCURRENT_HASH_MAP_H__
+
+#include "hash_map.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * A hash map that can be shared between threads. Lookups never take a lock:
+ * the buckets are published through an atomic pointer and each bucket is
+ * read atomically. Insertions and removals lock one of several stripes
+ * chosen by hashcode. Resizing locks every stripe, but readers keep using
+ * the old buckets until the new ones are published.
+ *
+ * Old buckets are retired instead of freed, since readers might still be
+ * probing them. Call chmap_reclaim when no thread is reading to free them.
+ * Pairs are owned by the caller: a removed pair might still be returned by
+ * a lookup that started before the removal.
+ */
+typedef struct concurrent_hash_map concurrent_hash_map;
+
+/**
+ * Constructs a concurrent hash map with the specified hash function and key
+ * comparator.
+ *
+ * @param hasher - Hash function
+ * @param key_equal - Key equality comparator
+ * @param stripes - Number of write locks, rounded up to a power of two; 0
+ *                  picks a default
+ *
+ * @return NULL if hasher or key_equal were NULL, or if the map cannot be
+ * allocated or its locks cannot be initialized
+ */
+concurrent_hash_map *new_chmap      (hash_func *hasher,
+                                     key_eq *key_equal,
+                                     size_t stripes);
+
+/**
+ * Destroys a concurrent hash map. No other thread may be using the map.
+ *
+ * @param map - Concurrent hash map being destroyed
+ */
+void delete_chmap                   (concurrent_hash_map *map);
+
+/**
+ * Frees the buckets retired by resizing. No other thread may be reading the
+ * map during this call.
+ *
+ * @param map - Concurrent hash map
+ */
+void chmap_reclaim                  (concurrent_hash_map *map);
+
+/**
+ * Puts a key-value pair into the map. If map already contains the same key,
+ * the existant key-value pair will be saved to provided pointer and it will
+ * be replaced by the new key-value pair.
+ *
+ * @param map - Concurrent hash map
+ * @param pair - Pointer to key-value pair
+ * @param repl - Modified to old key-value pair if replacement took place; ignored if NULL
+ *
+ * @return true if pair was successfully placed in
+ */
+bool chmap_put                      (concurrent_hash_map *restrict map,
+                                     const void *restrict pair,
+                                     const void **restrict repl);
+
+/**
+ * Puts a key-value pair into the map only if map does not contain a pair
+ * with the same key.
+ *
+ * @param map - Concurrent hash map
+ * @param pair - Pointer to key-value pair
+ *
+ * @return true if pair was successfully placed in
+ */
+bool chmap_put_if_absent            (concurrent_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Replaces exisiting pair with the same key with a new key-value pair. Does
+ * nothing if there are no exisiting pairs with the same key.
+ *
+ * @param map - Concurrent hash map
+ * @param pair - Pointer to key-value pair
+ *
+ * @return Pointer to exisiting pair or NULL if no such pair exists
+ */
+const void *chmap_replace           (concurrent_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Removes a pair with the same key
+ *
+ * @param map - Concurrent hash map
+ * @param pair - Pointer to key-value pair, only key is used
+ *
+ * @return Pointer to removed pair or NULL if no such pair exists
+ */
+const void *chmap_remove            (concurrent_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Checks if a pair with specified key exists. Never blocks.
+ *
+ * @param map - Concurrent hash map
+ * @param pair - Pointer to key-value pair, only key is used
+ *
+ * @return true if such pair exists, false otherwise
+ */
+bool chmap_has_key                  (const concurrent_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Retrieves a pair with the specified key. Never blocks.
+ *
+ * @param map - Concurrent hash map
+ * @param pair - Pointer to key-value pair, only key is used
+ *
+ * @return Pointer to such pair or NULL if no such pair exists
+ */
+const void *chmap_get               (const concurrent_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Retrieves a pair with the specified key or the default value if no such
+ * pair exists. Never blocks.
+ *
+ * @param map - Concurrent hash map
+ * @param pair - Pointer to key-value pair: this is also the default value
+ *
+ * @return Pointer to such pair or default value if no such pair exists
+ */
+const void *chmap_get_or_default    (const concurrent_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Returns the size of the concurrent hash map. The size may already be
+ * outdated if other threads are writing to the map.
+ *
+ * @param map - Concurrent hash map
+ *
+ * @return size of the concurrent hash map
+ */
+size_t chmap_size                   (const concurrent_hash_map *map);
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CUCKOO_HASH_MAP_H__
+#define __CUCKOO_HASH_MAP_H__
+
+#include "hash_map.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * A hash map where every pair lives in one of two buckets picked by its
+ * hashcode, each bucket holding CKMAP_SLOTS pairs. A lookup reads those two
+ * buckets and nothing else, however full the map or unlucky the keys, so it
+ * has a hard bound where hash_map only has an expected one. Inserting into
+ * two full buckets moves pairs to their other bucket along the shortest
+ * path found by a breadth-first search, and grows the map if there is none.
+ *
+ * A bucket is 64 bytes aligned to 64 bytes on 64 bit machines, so a lookup
+ * touches at most two cache lines before comparing keys.
+ *
+ * Pairs whose hashcodes collide so much that no size fixes it (more than
+ * 2 * CKMAP_SLOTS pairs with the same hashcode, for example) are kept in a
+ * small overflow list, which lookups only look at while it is not empty.
+ */
+
+/**
+ * The maximum load factor: the map grows once the pairs take up more than
+ * this fraction of the slots. Cuckoo insertion with four slots per bucket
+ * rarely fails below 0.95.
+ */
+#ifndef CKMAP_MAX_LOAD
+#define CKMAP_MAX_LOAD 0.9
+#endif
+
+/**
+ * Number of slots in a bucket
+ */
+#define CKMAP_SLOTS 4
+
+typedef struct ckmap_bucket
+{
+  map_entry slots[CKMAP_SLOTS]; /* pair is NULL for an empty slot */
+} ckmap_bucket;
+
+typedef struct cuckoo_hash_map
+{
+  size_t len;
+  size_t buckets; /* zero or a power of two */
+  ckmap_bucket *mem;
+  hash_func *hasher;
+  key_eq *key_equal;
+  size_t grow_at;
+  map_entry *stash; /* pairs that fit in neither bucket */
+  size_t stash_len;
+  size_t stash_cap;
+} cuckoo_hash_map;
+
+/**
+ * Initializes a cuckoo hash map with the specified hash function and key
+ * comparator.
+ *
+ * @param map - Pointer to an uninitialized cuckoo hash map
+ * @param hasher - Hash function
+ * @param key_equal - Key equality comparator
+ *
+ * @return true if hasher and key_equal were not NULL
+ */
+bool init_ckmap                     (cuckoo_hash_map *map,
+                                     hash_func *hasher,
+                                     key_eq *key_equal);
+
+/**
+ * Frees a cuckoo hash map, making it the same as uninitialized.
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ */
+void free_ckmap                     (cuckoo_hash_map *map);
+
+/**
+ * Clears the map by marking the slots as unoccupied. The size is set to
+ * zero.
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ */
+void ckmap_clear                    (cuckoo_hash_map *map);
+
+/**
+ * Ensures n pairs can be held without growing under the maximum load factor.
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ * @param n - Number of pairs
+ *
+ * @return true if n pairs already fit or buckets were able to be allocated
+ * successfully
+ */
+bool ckmap_ensure_capacity          (cuckoo_hash_map *map,
+                                     size_t n);
+
+/**
+ * Puts a key-value pair into the map. If map already contains the same key,
+ * the existant key-value pair will be saved to provided pointer and it will
+ * be replaced by the new key-value pair.
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ * @param pair - Pointer to key-value pair
+ * @param repl - Modified to old key-value pair if replacement took place; ignored if NULL
+ *
+ * @return true if pair was successfully placed in
+ */
+bool ckmap_put                      (cuckoo_hash_map *restrict map,
+                                     const void *restrict pair,
+                                     const void **restrict repl);
+
+/**
+ * Puts a key-value pair into the map only if map does not contain a pair
+ * with the same key.
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ * @param pair - Pointer to key-value pair
+ *
+ * @return true if pair was successfully placed in
+ */
+bool ckmap_put_if_absent            (cuckoo_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Replaces exisiting pair with the same key with a new key-value pair. Does
+ * nothing if there are no exisiting pairs with the same key.
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ * @param pair - Pointer to key-value pair
+ *
+ * @return Pointer to exisiting pair or NULL if no such pair exists
+ */
+const void *ckmap_replace           (cuckoo_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Removes a pair with the same key
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ * @param pair - Pointer to key-value pair, only key is used
+ *
+ * @return Pointer to removed pair or NULL if no such pair exists
+ */
+const void *ckmap_remove            (cuckoo_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Checks if a pair with specified key exists
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ * @param pair - Pointer to key-value pair, only key is used
+ *
+ * @return true if such pair exists, false otherwise
+ */
+bool ckmap_has_key                  (const cuckoo_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Retrieves a pair with the specified key
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ * @param pair - Pointer to key-value pair, only key is used
+ *
+ * @return Pointer to such pair or NULL if no such pair exists
+ */
+const void *ckmap_get               (const cuckoo_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Retrieves a pair with the specified key or the default value if no such
+ * pair exists
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ * @param pair - Pointer to key-value pair: this is also the default value
+ *
+ * @return Pointer to such pair or default value if no such pair exists
+ */
+const void *ckmap_get_or_default    (const cuckoo_hash_map *restrict map,
+                                     const void *restrict pair);
+
+/**
+ * Iterates through every pair of the map. The state of the map, apart from
+ * the pairs stored in the map should be kept consistent during the iteration
+ * process.
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ * @param it - An action to be performed on each pair
+ */
+void ckmap_foreach                  (const cuckoo_hash_map *map,
+                                     void (*it)(const void *));
+
+/**
+ * Iterates through every pair of the map, passing ctx along, until the action
+ * returns false. The state of the map should be kept consistent during the
+ * iteration process.
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ * @param it - An action to be performed on each pair, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every pair was visited, false if it stopped early
+ */
+bool ckmap_foreach_ctx              (const cuckoo_hash_map *map,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
+/**
+ * Returns the size of the map
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ *
+ * @return size of the map
+ */
+size_t ckmap_size                   (const cuckoo_hash_map *map);
+
+/**
+ * Returns the capacity of the map: the number of slots, always zero or a
+ * power of two
+ *
+ * @param map - Pointer to initialized cuckoo hash map
+ *
+ * @return capacity of the map
+ */
+size_t ckmap_capacity               (const cuckoo_hash_map *map);
+
+#endif
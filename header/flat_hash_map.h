@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FLAT_HASH_MAP_H__
+#define __FLAT_HASH_MAP_H__
+
+#include "hash_map.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * A hash map that stores keys and values by value, in the same bucket array
+ * as their hashcodes. Unlike hash_map, a lookup does not need to follow a
+ * pointer to reach the pair and the caller does not need to keep the pairs
+ * alive. The trade-off is that pointers returned by the map are invalidated
+ * by any modification.
+ *
+ * HMAP_GROW and HMAP_MAX_LOAD from hash_map.h apply to this map too.
+ */
+
+typedef void (fmap_it)(const void *, const void *);
+typedef bool (fmap_ctx_it)(const void *, void *, void *);
+
+typedef struct flat_hash_map
+{
+  size_t len;
+  size_t cap;
+  size_t key_blk;
+  size_t value_blk;
+  size_t key_off; /* offsets into each bucket */
+  size_t value_off;
+  size_t stride; /* size of each bucket */
+  char *mem;
+  unsigned char *ctrl; /* one control byte per bucket, shares mem's block */
+  hash_func *hasher;
+  key_eq *key_equal;
+  size_t dead; /* buckets marked as deleted */
+  size_t grow_at;
+} flat_hash_map;
+
+/**
+ * Initializes a flat hash map with the specified hasher, key equality
+ * function, key size and value size. Both functions receive pointers to
+ * keys.
+ *
+ * @param map - Pointer to an uninitialized flat hash map
+ * @param hasher - Key hasher
+ * @param key_equal - Key equality function
+ * @param key_size - Size of each key
+ * @param value_size - Size of each value, may be zero
+ *
+ * @return true if hasher and key_equal are not NULL and key size is not zero
+ */
+bool init_fmap                      (flat_hash_map *map,
+                                     hash_func *hasher,
+                                     key_eq *key_equal,
+                                     size_t key_size,
+                                     size_t value_size);
+
+/**
+ * Frees a flat hash map, making it the same as uninitialized.
+ *
+ * @param map - Pointer to initialized flat hash map
+ */
+void free_fmap                      (flat_hash_map *map);
+
+/**
+ * Clears a flat hash map by setting size to zero. The buckets are kept.
+ *
+ * @param map - Pointer to initialized flat hash map
+ */
+void fmap_clear                     (flat_hash_map *map);
+
+/**
+ * Makes sure the map can hold at least n entries without growing.
+ *
+ * @param map - Pointer to initialized flat hash map
+ * @param n - Number of entries
+ *
+ * @return true if the map can hold n entries, false if memory could not be
+ * allocated
+ */
+bool fmap_ensure_capacity           (flat_hash_map *map,
+                                     size_t n);
+
+/**
+ * Puts a key with corresponding value into the map. If the key already
+ * exists, its value is overwritten.
+ *
+ * @param map - Pointer to initialized flat hash map
+ * @param key - Pointer to key
+ * @param value - Pointer to value, may be NULL if value size is zero
+ *
+ * @return true if operation succeeded
+ */
+bool fmap_put                       (flat_hash_map *restrict map,
+                                     const void *restrict key,
+                                     const void *restrict value);
+
+/**
+ * Puts a key with corresponding value into the map only if key does not
+ * exist in the map.
+ *
+ * @param map - Pointer to initialized flat hash map
+ * @param key - Pointer to key
+ * @param value - Pointer to value, may be NULL if value size is zero
+ *
+ * @return true if operation succeeded, false if key already exists or
+ * memory could not be allocated
+ */
+bool fmap_put_if_absent             (flat_hash_map *restrict map,
+                                     const void *restrict key,
+                                     const void *restrict value);
+
+/**
+ * Removes a key along with its value
+ *
+ * @param map - Pointer to initialized flat hash map
+ * @param key - Pointer to key
+ *
+ * @return true if such a key was found and removed
+ */
+bool fmap_remove                    (flat_hash_map *restrict map,
+                                     const void *restrict key);
+
+/**
+ * Checks if specified key exists
+ *
+ * @param map - Pointer to initialized flat hash map
+ * @param key - Pointer to key
+ *
+ * @return true if such a key exists, false otherwise
+ */
+bool fmap_has_key                   (const flat_hash_map *restrict map,
+                                     const void *restrict key);
+
+/**
+ * Returns a pointer to the value corresponding to the specified key. The
+ * pointer is valid until the map is modified.
+ *
+ * @param map - Pointer to initialized flat hash map
+ * @param key - Pointer to key
+ *
+ * @return the pointer to the value or NULL
+ */
+void *fmap_get                      (const flat_hash_map *restrict map,
+                                     const void *restrict key);
+
+/**
+ * Returns a pointer to the value corresponding to the specified key. If value
+ * does not exist, the default value will be returned.
+ *
+ * @param map - Pointer to initialized flat hash map
+ * @param key - Pointer to key
+ * @param default_value - Default value
+ *
+ * @return the pointer to the value or the default value
+ */
+const void *fmap_get_or_default     (const flat_hash_map *restrict map,
+                                     const void *key,
+                                     const void *default_value);
+
+/**
+ * Iterates through every key-value entry of the map. The state of the map
+ * should be kept consistent during the iteration process.
+ *
+ * @param map - Pointer to initialized flat hash map
+ * @param it - An action to be performed on each entry
+ */
+void fmap_foreach                   (const flat_hash_map *map,
+                                     fmap_it *it);
+
+/**
+ * Iterates through every key-value entry of the map, passing ctx along, until
+ * the action returns false. Values may be modified in place, the rest of the
+ * map should be kept consistent during the iteration process.
+ *
+ * @param map - Pointer to initialized flat hash map
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool fmap_foreach_ctx               (const flat_hash_map *map,
+                                     fmap_ctx_it *it,
+                                     void *ctx);
+
+/**
+ * Returns the size of the flat hash map
+ *
+ * @param map - Pointer to initialized flat hash map
+ *
+ * @return size of the flat hash map
+ */
+size_t fmap_size                    (const flat_hash_map *map);
+
+/**
+ * Returns the number of buckets currently allocated
+ *
+ * @param map - Pointer to initialized flat hash map
+ *
+ * @return number of buckets, zero or a power of two
+ */
+size_t fmap_capacity                (const flat_hash_map *map);
+
+#endif
@@ -85,6 +85,21 @@ void fwdlist_sort                   (forward_list *list,
 void fwdlist_foreach                (const forward_list *list,
                                      void (*it)(const void *));
 
+/**
+ * Iterates through every item of the list, passing ctx along, until the
+ * action returns false. The state of the list should be kept consistent
+ * during the iteration process.
+ *
+ * @param list - Pointer to initialized forward list
+ * @param it - An action to be performed on each item, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every item was visited, false if it stopped early
+ */
+bool fwdlist_foreach_ctx            (const forward_list *list,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
 /**
  * Returns the size of the forward list
  *
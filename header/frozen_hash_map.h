@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FROZEN_HASH_MAP_H__
+#define __FROZEN_HASH_MAP_H__
+
+#include "hash_map.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * An immutable hash map built from a hash_map with a minimal perfect hash:
+ * every pair gets its own slot and there are exactly as many slots as pairs.
+ * The keys are split into buckets of about four, and each bucket stores a
+ * pilot, a small integer picked while freezing so that its keys land in
+ * slots no other key uses (hash and displace). A lookup reads one pilot and
+ * one slot and compares one key, hit or miss.
+ *
+ * The pairs are not copied, they must outlive the frozen map just like they
+ * must outlive the hash map.
+ */
+
+typedef struct frozen_hash_map
+{
+  size_t len;
+  size_t buckets;
+  uint64_t seed;
+  uint32_t *pilots; /* one per bucket, shares pairs' block */
+  const void **pairs; /* one per slot, len slots */
+  hash_func *hasher;
+  key_eq *key_equal;
+} frozen_hash_map;
+
+/**
+ * Builds a frozen map holding the pairs of a hash map, using the same hasher
+ * and key comparator. The hash map is not modified. Freezing takes time
+ * roughly proportional to n log n for n pairs.
+ *
+ * Fails if two different keys of the map have the same hashcode, since the
+ * hashcode is all that tells them apart before the final comparison.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param frozen - Pointer to an uninitialized frozen map
+ *
+ * @return true if the frozen map was built, false if memory could not be
+ * allocated or two keys have the same hashcode
+ */
+bool hmap_freeze                    (const hash_map *restrict map,
+                                     frozen_hash_map *restrict frozen);
+
+/**
+ * Frees a frozen map, making it the same as uninitialized.
+ *
+ * @param frozen - Pointer to initialized frozen map
+ */
+void free_fzmap                     (frozen_hash_map *frozen);
+
+/**
+ * Retrieves the pair with the same key
+ *
+ * @param frozen - Pointer to initialized frozen map
+ * @param key - Key being looked up
+ *
+ * @return pair or NULL if no such key exists
+ */
+const void *fzmap_get               (const frozen_hash_map *restrict frozen,
+                                     const void *restrict key);
+
+/**
+ * Checks if a pair with the same key exists
+ *
+ * @param frozen - Pointer to initialized frozen map
+ * @param key - Key being looked up
+ *
+ * @return true if such a key exists, false otherwise
+ */
+bool fzmap_has_key                  (const frozen_hash_map *restrict frozen,
+                                     const void *restrict key);
+
+/**
+ * Iterates through every pair of the frozen map.
+ *
+ * @param frozen - Pointer to initialized frozen map
+ * @param it - An action to be performed on each pair
+ */
+void fzmap_foreach                  (const frozen_hash_map *frozen,
+                                     void (*it)(const void *));
+
+/**
+ * Iterates through every pair of the frozen map, passing ctx along, until
+ * the action returns false.
+ *
+ * @param frozen - Pointer to initialized frozen map
+ * @param it - An action to be performed on each pair, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every pair was visited, false if it stopped early
+ */
+bool fzmap_foreach_ctx              (const frozen_hash_map *frozen,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
+/**
+ * Returns the size of the frozen map
+ *
+ * @param frozen - Pointer to initialized frozen map
+ *
+ * @return size of the frozen map
+ */
+size_t fzmap_size                   (const frozen_hash_map *frozen);
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * How the containers storing elements in one growable block (array_list,
+ * string_buffer and the value arrays of tree_multimap and hash_multimap)
+ * pick their next capacity. Growing by a factor of the current capacity
+ * makes appends amortized constant time: n appends copy fewer than
+ * n / (factor - 1) elements in total.
+ */
+
+#ifndef __GROWTH_POLICY_H__
+#define __GROWTH_POLICY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * The default growth factor, the minimum and the maximum number of elements
+ * added by each growth, 0 meaning unbounded. Containers start with these
+ * unless they say otherwise.
+ */
+#ifndef GROWTH_FACTOR
+#define GROWTH_FACTOR 1.5
+#endif
+
+#ifndef GROWTH_MIN_STEP
+#define GROWTH_MIN_STEP 16
+#endif
+
+#ifndef GROWTH_MAX_STEP
+#define GROWTH_MAX_STEP 0
+#endif
+
+typedef struct growth_policy
+{
+  double factor; /* in [1, 64] */
+  size_t min_step;
+  size_t max_step; /* 0 if unbounded, otherwise at least min_step */
+} growth_policy;
+
+/**
+ * @return the policy made of GROWTH_FACTOR, GROWTH_MIN_STEP and
+ * GROWTH_MAX_STEP
+ */
+static inline
+growth_policy growth_default
+(void)
+{
+  growth_policy const policy = { GROWTH_FACTOR, GROWTH_MIN_STEP, GROWTH_MAX_STEP };
+  return policy;
+}
+
+/**
+ * @param policy - Growth policy being checked
+ *
+ * @return true if factor is in [1, 64] and max_step is 0 or at least min_step
+ */
+static inline
+bool growth_valid
+(growth_policy const * const policy)
+{
+  return policy->factor >= 1 && policy->factor <= 64
+    && (policy->max_step == 0 || policy->max_step >= policy->min_step);
+}
+
+/**
+ * Picks the capacity to grow to. A single growth is bounded by max_step, but
+ * never leaves the capacity under n.
+ *
+ * @param policy - Growth policy
+ * @param cap - Current capacity
+ * @param n - Required capacity
+ *
+ * @return capacity at least n
+ */
+static inline
+size_t growth_next
+(growth_policy const * const policy, size_t const cap, size_t const n)
+{
+  if (cap >= n)
+  {
+    return cap;
+  }
+
+  /* factor is bounded, so this only saturates near SIZE_MAX */
+  double const scaled = (double) cap * (policy->factor - 1);
+  size_t step = scaled < (double) (SIZE_MAX / 2) ? (size_t) scaled : SIZE_MAX / 2;
+  if (step < policy->min_step)
+  {
+    step = policy->min_step;
+  }
+  if (policy->max_step > 0 && step > policy->max_step)
+  {
+    step = policy->max_step;
+  }
+
+  size_t const next = SIZE_MAX - cap > step ? cap + step : SIZE_MAX;
+  return next < n ? n : next;
+}
+
+#endif
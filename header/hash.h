@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Hash functions for the hash tables. Every hash is mixed with a seed that
+ * is picked at random once per process, so the hashcodes of the same key
+ * differ between runs and cannot be predicted by whoever supplies the keys.
+ * Do not store or send hashcodes anywhere.
+ */
+
+/**
+ * Returns the seed used by the hash functions of this process. It is picked
+ * at random the first time it is needed.
+ *
+ * @return the seed
+ */
+uint64_t hash_seed                  (void);
+
+/**
+ * Replaces the seed used by the hash functions of this process, for example
+ * to get reproducible hashcodes while testing. Must be called before any
+ * hashcode is computed, otherwise hash tables already filled will not find
+ * their keys.
+ *
+ * @param seed - The new seed
+ *
+ * @return true if seed is not zero
+ */
+bool hash_set_seed                  (uint64_t seed);
+
+/**
+ * Hashes a 32 bit integer.
+ *
+ * @param value - Integer being hashed
+ *
+ * @return hashcode
+ */
+uint64_t hash_u32                   (uint32_t value);
+
+/**
+ * Hashes a 64 bit integer.
+ *
+ * @param value - Integer being hashed
+ *
+ * @return hashcode
+ */
+uint64_t hash_u64                   (uint64_t value);
+
+/**
+ * Hashes a block of bytes. Short blocks are hashed a word at a time, long
+ * ones use SIMD when available (the result does not depend on it).
+ *
+ * @param data - Pointer to the bytes
+ * @param len - Number of bytes
+ *
+ * @return hashcode
+ */
+uint64_t hash_bytes                 (const void *data,
+                                     size_t len);
+
+/**
+ * Hashes a block of bytes with an explicit seed instead of the one of the
+ * process. Same as hash_bytes if seed is hash_seed().
+ *
+ * @param data - Pointer to the bytes
+ * @param len - Number of bytes
+ * @param seed - Seed
+ *
+ * @return hashcode
+ */
+uint64_t hash_bytes_seeded          (const void *data,
+                                     size_t len,
+                                     uint64_t seed);
+
+/**
+ * Hashes a NUL-terminated string, without the terminator.
+ *
+ * @param str - String being hashed
+ *
+ * @return hashcode, same as hash_bytes(str, strlen(str))
+ */
+uint64_t hash_str                   (const char *str);
+
+/*
+ * Ready-made hasher and key equality functions for hash_map and
+ * flat_hash_map. The *_key_* ones expect a pointer to the key, which for
+ * hash_map is usually a pair struct that starts with the key:
+ *
+ *   typedef struct { const char *key; int val; } pair;
+ *   init_hmap(&map, &hash_key_str, &equal_key_str);
+ *
+ * hash_cstr and equal_cstr expect the pointer to be the string itself.
+ */
+
+unsigned long hash_key_u32          (const void *key);
+bool equal_key_u32                  (const void *a, const void *b);
+
+unsigned long hash_key_u64          (const void *key);
+bool equal_key_u64                  (const void *a, const void *b);
+
+/* keys are pointers compared by address */
+unsigned long hash_key_ptr          (const void *key);
+bool equal_key_ptr                  (const void *a, const void *b);
+
+/* keys are pointers to NUL-terminated strings */
+unsigned long hash_key_str          (const void *key);
+bool equal_key_str                  (const void *a, const void *b);
+
+unsigned long hash_cstr             (const void *str);
+bool equal_cstr                     (const void *a, const void *b);
+
+#endif
@@ -21,41 +21,155 @@
 #include <stdbool.h>
 
 /**
- * The growth function for the hash map.
+ * The growth function for the hash map. The number of buckets needed to hold
+ * the result under the maximum load factor is rounded up to a power of two,
+ * so the map already grows geometrically.
  *
- * By default, the capacity is scaled to the next multiple of 16.
+ * By default, the size is unscaled.
  *
- * @param n - The precomputed new capacity
+ * @param n - The precomputed number of pairs
  *
  * @return value >= n
  */
 #ifndef HMAP_GROW /* (size_t n) */
-#define HMAP_GROW(n) ((((n) / 16) + 1) * 16)
+#define HMAP_GROW(n) (n)
 #endif
 
 /**
- * The probe function for locating buckets
+ * The default maximum load factor: the map grows once the pairs and deleted
+ * markers take up more than this fraction of the buckets.
+ */
+#ifndef HMAP_MAX_LOAD
+#define HMAP_MAX_LOAD 0.875
+#endif
+
+/**
+ * The default minimum load factor: the map shrinks once removals leave the
+ * pairs taking up less than this fraction of the buckets. 0 never shrinks.
+ */
+#ifndef HMAP_MIN_LOAD
+#define HMAP_MIN_LOAD 0.0
+#endif
+
+/**
+ * The probe function for locating buckets. Buckets are probed a group at a
+ * time (16 control bytes with SSE2, 32 with AVX2, 8 otherwise), so the
+ * iteration advances by the group width.
  *
  * By default, linear probing is used (base hash + iteration)
  *
  * @param h - Base hash
- * @param k - Iteration
+ * @param k - Iteration, a multiple of the group width
  *
- * @return potential bucket location
+ * @return potential bucket location of the group
  */
 #ifndef HMAP_PROBE /* (unsigned long h, size_t k) */
 #define HMAP_PROBE(h, k) ((h) + (k))
 #endif
 
+/**
+ * The longest probe distance allowed by robin hood insertion before the map
+ * grows to spread the pairs out. Has no effect while the map is less than an
+ * eighth full, as that means the hashcodes collide too much for growing to
+ * help.
+ */
+#ifndef HMAP_MAX_PROBE
+#define HMAP_MAX_PROBE 64
+#endif
+
+/**
+ * The number of buckets migrated by each insertion or removal while an
+ * incremental map is resizing.
+ */
+#ifndef HMAP_MIGRATE_STEP
+#define HMAP_MIGRATE_STEP 32
+#endif
+
+/**
+ * Flags for init_hmap_flags
+ *
+ * HMAP_ROBIN_HOOD - Use robin hood insertion with backward-shift deletion
+ *                   instead of probing groups of control bytes. The control
+ *                   byte of each bucket stores its probe distance.
+ *
+ * HMAP_INCREMENTAL - Resize without moving every pair at once: the old
+ *                    buckets are kept and migrated HMAP_MIGRATE_STEP at a
+ *                    time by later insertions and removals. Lookups search
+ *                    both sets of buckets until the migration is done.
+ *                    The insertion starting a resize still sets every
+ *                    control byte of the new buckets, one byte per bucket,
+ *                    so its cost stays O(capacity), only much smaller than
+ *                    moving every pair.
+ */
+#define HMAP_ROBIN_HOOD 0x1
+#define HMAP_INCREMENTAL 0x2
+
+/**
+ * Define HMAP_STATS when building the library to count calls to hasher and
+ * key_equal, resizes and moved buckets, which hmap_stats then reports.
+ * Without it nothing is counted and the counters stay zero. The counters
+ * are part of the map either way, so the layout of the map does not depend
+ * on the macro and callers built without it can share maps with a library
+ * built with it. Lookups update the counters as well, writing through the
+ * const map they are given, so with HMAP_STATS a map read by several
+ * threads at once needs its own locking.
+ */
+
+/**
+ * Number of bins of the probe distance histogram
+ */
+#define HMAP_STATS_BINS 16
+
 typedef unsigned long (hash_func)(const void *);
 typedef bool (key_eq)(const void *, const void *);
 
+/**
+ * Decides which pair hmap_merge keeps for a key both maps have. It may also
+ * modify the kept pair, for example to add the values together.
+ *
+ * @return the pair to keep
+ */
+typedef const void *(hmap_merge_func)(const void *kept, const void *merged, void *ctx);
+
 typedef struct map_entry
 {
   unsigned long hash;
   const void *pair;
 } map_entry;
 
+typedef struct hmap_policy
+{
+  double max_load; /* in (0, 1] */
+  double min_load; /* in [0, max_load / 2) */
+} hmap_policy;
+
+typedef struct hmap_counters
+{
+  size_t hasher_calls;
+  size_t key_equal_calls;
+  size_t resizes;
+  size_t bytes_moved;
+} hmap_counters;
+
+typedef struct hmap_statistics
+{
+  /*
+   * number of pairs by distance from their home bucket: the first bin
+   * counts distance 0, bin i counts [2^(i-1), 2^i), the last bin counts
+   * everything further
+   */
+  size_t probe_hist[HMAP_STATS_BINS];
+  size_t max_probe;
+  double mean_probe;
+  size_t longest_cluster; /* most consecutive full or deleted buckets */
+
+  /* only counted with HMAP_STATS, zero otherwise */
+  size_t hasher_calls;
+  size_t key_equal_calls;
+  size_t resizes; /* including rebuilds dropping deleted markers */
+  size_t bytes_moved; /* buckets copied into new buckets */
+} hmap_statistics;
+
 typedef struct hash_map
 {
   size_t len;
@@ -63,6 +177,17 @@ typedef struct hash_map
   map_entry *mem;
   hash_func *hasher;
   key_eq *key_equal;
+  size_t dead; /* buckets marked as deleted */
+  unsigned char *ctrl; /* one control byte per bucket, shares mem's block */
+  unsigned flags;
+  hmap_policy policy;
+  size_t grow_at; /* derived from policy and cap */
+  size_t shrink_at;
+  map_entry *old_mem; /* buckets being migrated by an incremental resize */
+  unsigned char *old_ctrl;
+  size_t old_cap;
+  size_t old_pos; /* buckets before this one were migrated */
+  hmap_counters counters; /* only counted with HMAP_STATS */
 } hash_map;
 
 /**
@@ -78,6 +203,22 @@ bool init_hmap                      (hash_map *map,
                                      hash_func *hasher,
                                      key_eq *key_equal);
 
+/**
+ * Initializes a hash map with the specified hash function, key comparator and
+ * flags changing how pairs are laid out.
+ *
+ * @param map - Pointer to an uninitialized hash map
+ * @param hasher - Hash function
+ * @param key_equal - Key equality comparator
+ * @param flags - Bitwise or of the HMAP_* flags, 0 for the default
+ *
+ * @return true if hasher and key_equal were not NULL
+ */
+bool init_hmap_flags                (hash_map *map,
+                                     hash_func *hasher,
+                                     key_eq *key_equal,
+                                     unsigned flags);
+
 /**
  * Frees a hash map, making it the same as uninitialized.
  *
@@ -94,17 +235,29 @@ void free_hmap                      (hash_map *map);
 void hmap_clear                     (hash_map *map);
 
 /**
- * Ensures the capacity is at least n.
+ * Ensures n pairs can be held without growing under the maximum load factor.
  *
  * @param map - Pointer to initialized hash map
- * @param n - New minimum capacity of the list
+ * @param n - Number of pairs
  *
- * @return true if capacity was already at least n or buckets were able to be
- * allocated successfully
+ * @return true if n pairs already fit or buckets were able to be allocated
+ * successfully
  */
 bool hmap_ensure_capacity           (hash_map *map,
                                      size_t n);
 
+/**
+ * Changes the load factors deciding when the map grows and shrinks. The new
+ * policy is applied on the next insertion or removal.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param policy - New capacity policy, NULL restores the defaults
+ *
+ * @return true if max_load was in (0, 1] and min_load in [0, max_load / 2)
+ */
+bool hmap_set_policy                (hash_map *restrict map,
+                                     const hmap_policy *restrict policy);
+
 /**
  * Puts a key-value pair into the map. If map already contains the same key,
  * the existant key-value pair will be saved to provided pointer and it will
@@ -189,6 +342,40 @@ const void *hmap_get                (const hash_map *restrict map,
 const void *hmap_get_or_default     (const hash_map *restrict map,
                                      const void *restrict pair);
 
+/**
+ * Retrieves the pairs with the same keys as a batch of probes. Faster than
+ * calling hmap_get in a loop on large maps, as the memory accesses of
+ * several probes are overlapped.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param pairs - Array of pointers to key-value pairs, only keys are used;
+ *                must not contain NULL
+ * @param count - Number of probes
+ * @param out - Array filled with the pair found for each probe or NULL if no
+ *              such pair exists
+ */
+void hmap_get_many                  (const hash_map *restrict map,
+                                     const void *const *restrict pairs,
+                                     size_t count,
+                                     const void **restrict out);
+
+/**
+ * Checks if pairs with the same keys as a batch of probes exist. See
+ * hmap_get_many.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param pairs - Array of pointers to key-value pairs, only keys are used;
+ *                must not contain NULL
+ * @param count - Number of probes
+ * @param out - Array filled with true for each probe whose key exists
+ *
+ * @return the number of keys that exist
+ */
+size_t hmap_has_key_many            (const hash_map *restrict map,
+                                     const void *const *restrict pairs,
+                                     size_t count,
+                                     bool *restrict out);
+
 /**
  * Forces the map to rehash all pairs with the new hash function. Internal
  * hash function will only be updated if rehash operation was successful.
@@ -201,6 +388,108 @@ const void *hmap_get_or_default     (const hash_map *restrict map,
 bool hmap_rehash                    (hash_map *map,
                                      hash_func *hasher);
 
+/**
+ * Puts every pair of an array into the map, same as calling hmap_put on each
+ * of them in order: later pairs replace earlier ones with the same key. The
+ * buckets are allocated once for the final size and, for large arrays, the
+ * pairs are hashed and placed by several threads.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param pairs - Array of pointers to key-value pairs, NULL ones are skipped
+ * @param count - Number of pairs
+ * @param threads - Number of threads to use, 0 uses one per processor, at
+ *                  most 64 are used
+ *
+ * @return true if every pair was put, false if memory could not be allocated
+ */
+bool hmap_put_all                   (hash_map *restrict map,
+                                     const void *const *restrict pairs,
+                                     size_t count,
+                                     size_t threads);
+
+/**
+ * Initializes a hash map and fills it with an array of pairs. See
+ * hmap_put_all.
+ *
+ * @param map - Pointer to an uninitialized hash map
+ * @param hasher - Hash function
+ * @param key_equal - Key equality function
+ * @param pairs - Array of pointers to key-value pairs, NULL ones are skipped
+ * @param count - Number of pairs
+ * @param threads - Number of threads to use, 0 uses one per processor
+ *
+ * @return true if the map was initialized and filled. If only filling failed
+ * the map is initialized and must still be freed.
+ */
+bool hmap_build_from                (hash_map *restrict map,
+                                     hash_func *hasher,
+                                     key_eq *key_equal,
+                                     const void *const *restrict pairs,
+                                     size_t count,
+                                     size_t threads);
+
+/**
+ * Puts every pair of src into the map, same as calling hmap_put on each of
+ * them except the buckets are sized once and, if both maps use the same
+ * hasher, the hashcodes stored in src are reused instead of hashing again.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param src - Pointer to initialized hash map being merged in
+ * @param resolve - Called when both maps have the same key, NULL replaces
+ *                  the pair of map with the one of src
+ * @param ctx - Passed to every call of resolve
+ *
+ * @return true if every pair was put, false if memory could not be allocated
+ */
+bool hmap_merge                     (hash_map *restrict map,
+                                     const hash_map *restrict src,
+                                     hmap_merge_func *resolve,
+                                     void *ctx);
+
+/**
+ * Removes every pair of the map whose key is not in other. Iterates the
+ * smaller of the two maps unless drop is given, and reuses the stored
+ * hashcodes if both maps use the same hasher.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param other - Pointer to initialized hash map with the keys to keep
+ * @param drop - Called with every removed pair; ignored if NULL
+ *
+ * @return true unless memory could not be allocated, in which case the map
+ * is left as it was
+ */
+bool hmap_intersect                 (hash_map *restrict map,
+                                     const hash_map *restrict other,
+                                     void (*drop)(const void *));
+
+/**
+ * Removes every pair of the map whose key is in other. Iterates the smaller
+ * of the two maps and reuses the stored hashcodes if both maps use the same
+ * hasher.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param other - Pointer to initialized hash map with the keys to remove
+ * @param drop - Called with every removed pair; ignored if NULL
+ *
+ * @return true unless memory could not be allocated, in which case the map
+ * is left as it was
+ */
+bool hmap_difference                (hash_map *restrict map,
+                                     const hash_map *restrict other,
+                                     void (*drop)(const void *));
+
+/**
+ * Migrates up to n buckets left over by an incremental resize. Lookups alone
+ * never migrate buckets, so this lets read-mostly maps finish a migration.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param n - Maximum number of buckets to migrate
+ *
+ * @return true if there are still buckets waiting to be migrated
+ */
+bool hmap_migrate                   (hash_map *map,
+                                     size_t n);
+
 /**
  * Iterates through every pair of the map. The state of the map, apart from
  * the pairs stored in the map should be kept consistent during the iteration
@@ -212,6 +501,21 @@ bool hmap_rehash                    (hash_map *map,
 void hmap_foreach                   (const hash_map *map,
                                      void (*it)(const void *));
 
+/**
+ * Iterates through every pair of the map, passing ctx along, until the action
+ * returns false. The state of the map should be kept consistent during the
+ * iteration process.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param it - An action to be performed on each pair, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every pair was visited, false if it stopped early
+ */
+bool hmap_foreach_ctx               (const hash_map *map,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
 /**
  * Returns the size of the hash map
  *
@@ -222,7 +526,8 @@ void hmap_foreach                   (const hash_map *map,
 size_t hmap_size                    (const hash_map *map);
 
 /**
- * Returns the capacity of the hash map
+ * Returns the capacity of the hash map: the number of buckets, always zero
+ * or a power of two
  *
  * @param map - Pointer to initialized hash map
  *
@@ -230,4 +535,17 @@ size_t hmap_size                    (const hash_map *map);
  */
 size_t hmap_capacity                (const hash_map *map);
 
+/**
+ * Measures how well the pairs are spread over the buckets and, with
+ * HMAP_STATS, reports the counters accumulated since the map was
+ * initialized. Long probe distances or clusters usually mean a poor hash
+ * function or a load factor that is too high. Takes time proportional to
+ * the capacity.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param stats - Outputs the statistics
+ */
+void hmap_stats                     (const hash_map *restrict map,
+                                     hmap_statistics *restrict stats);
+
 #endif
\ No newline at end of file
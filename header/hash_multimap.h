@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HASH_MULTIMAP_H__
+#define __HASH_MULTIMAP_H__
+
+#include "block_align.h"
+#include "hash_map.h"
+#include "growth_policy.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * An unordered multimap. Every key has a node holding the key followed by
+ * an array of its values, like tree_multimap, and a hash_map finds the node
+ * by key instead of a tree. The map stores pointers to the keys inside the
+ * nodes, so the hasher and key equality function receive pointers to keys.
+ */
+
+typedef void (hmmap_it)(const void *, size_t, const void *);
+typedef bool (hmmap_ctx_it)(const void *, size_t, const void *, void *);
+
+typedef struct hmmap_node
+{
+  size_t count;
+  size_t cap;
+  block_max_align data[]; /* key, then values */
+} hmmap_node;
+
+typedef struct hash_multimap
+{
+  size_t len;
+  size_t key_blk;
+  size_t value_blk;
+  size_t value_off; /* key_blk rounded up to the alignment of a value */
+  growth_policy growth; /* of the values of each key */
+  hash_map map;
+} hash_multimap;
+
+/**
+ * Initializes a hash multimap with the specified hasher, key equality
+ * function, key size and value size.
+ *
+ * @param map - Pointer to an uninitialized hash multimap
+ * @param hasher - Key hasher
+ * @param key_equal - Key equality function
+ * @param key_size - Size of each key
+ * @param value_size - Size of each value
+ *
+ * @return true if hasher and key_equal are not NULL and neither size is zero
+ */
+bool init_hmmap                     (hash_multimap *map,
+                                     hash_func *hasher,
+                                     key_eq *key_equal,
+                                     size_t key_size,
+                                     size_t value_size);
+
+/**
+ * Frees a hash multimap, making it the same as uninitialized.
+ *
+ * @param map - Pointer to initialized hash multimap
+ */
+void free_hmmap                     (hash_multimap *map);
+
+/**
+ * Changes how the values of a key grow once they do not fit. A new key
+ * starts with room for one value. By default, the room grows by
+ * GROWTH_FACTOR with a minimum step of one value.
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param policy - New growth policy, NULL for the default one
+ *
+ * @return true if the policy was valid and applied
+ */
+bool hmmap_set_growth               (hash_multimap *restrict map,
+                                     const growth_policy *restrict policy);
+
+/**
+ * Clears a hash multimap by deallocating all nodes and setting size to zero.
+ *
+ * @param map - Pointer to initialized hash multimap
+ */
+void hmmap_clear                    (hash_multimap *map);
+
+/**
+ * Adds a value to the ones associated with the key.
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param key - Pointer to key
+ * @param value - Pointer to value
+ *
+ * @returns true if operation succeeded
+ */
+bool hmmap_put                      (hash_multimap *restrict map,
+                                     const void *restrict key,
+                                     const void *restrict value);
+
+/**
+ * Puts a key with corresponding value into the map only if key does not
+ * exist in the map. If such key already exists, false is returned
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param key - Pointer to key
+ * @param value - Pointer to value
+ *
+ * @returns true if operation succeeded, false if key already exists or
+ * memory could not be allocated
+ */
+bool hmmap_put_if_absent            (hash_multimap *restrict map,
+                                     const void *restrict key,
+                                     const void *restrict value);
+
+/**
+ * Removes a key and all of its values
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param key - Pointer to key
+ *
+ * @return true if such a key was found and removed
+ */
+bool hmmap_remove                   (hash_multimap *restrict map,
+                                     const void *restrict key);
+
+/**
+ * Removes a range of values associated with the key. If the upper bound of
+ * the range is more than the amount of values associated, it only removes up
+ * until the last associated value. If the range covers all or more than all
+ * values, then the key is removed from the multimap.
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param key - Pointer to key
+ * @param lo - Lower bound of the removal range
+ * @param hi - Upper bound of the removal range
+ *
+ * @return the actual amount of values removed
+ */
+size_t hmmap_remove_values          (hash_multimap *restrict map,
+                                     const void *restrict key,
+                                     size_t lo,
+                                     size_t hi);
+
+/**
+ * Checks if specified key exists
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param key - Pointer to key
+ *
+ * @return true if such a key exists, false otherwise
+ */
+bool hmmap_has_key                  (const hash_multimap *restrict map,
+                                     const void *restrict key);
+
+/**
+ * Checks the number of values associated with the specified key
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param key - Pointer to key
+ *
+ * @return the number of values
+ */
+size_t hmmap_count_matches          (const hash_multimap *restrict map,
+                                     const void *restrict key);
+
+/**
+ * Returns the list of values corresponding to the specified key. The list
+ * is invalidated by adding to or removing from the same key.
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param key - Pointer to key
+ * @param out_matches - Pointer that will be filled with the number of
+ *                      matches; ignored if NULL
+ *
+ * @return the list of values (as this is a multimap) or NULL
+ */
+const void *hmmap_get               (const hash_multimap *restrict map,
+                                     const void *restrict key,
+                                     size_t *restrict out_matches);
+
+/**
+ * Returns the list of values corresponding to the specified key, or the
+ * default value if the key does not exist.
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param key - Pointer to key
+ * @param default_value - Default value
+ *
+ * @return the list of values (as this is a multimap) or the default value
+ */
+const void *hmmap_get_or_default    (const hash_multimap *restrict map,
+                                     const void *key,
+                                     const void *default_value);
+
+/**
+ * Iterates through every key with its values, in no particular order. The
+ * state of the map should be kept consistent during the iteration process.
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param it - An action to be performed on each key
+ */
+void hmmap_foreach                  (const hash_multimap *map,
+                                     hmmap_it *it);
+
+/**
+ * Iterates through every key with its values, passing ctx along, until the
+ * action returns false. The state of the map should be kept consistent
+ * during the iteration process.
+ *
+ * @param map - Pointer to initialized hash multimap
+ * @param it - An action to be performed on each key, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every key was visited, false if it stopped early
+ */
+bool hmmap_foreach_ctx              (const hash_multimap *map,
+                                     hmmap_ctx_it *it,
+                                     void *ctx);
+
+/**
+ * Returns the size of the hash multimap: the number of values of all keys
+ *
+ * @param map - Pointer to initialized hash multimap
+ *
+ * @return number of values
+ */
+size_t hmmap_size                   (const hash_multimap *map);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HASH_SET_H__
+#define __HASH_SET_H__
+
+#include "flat_hash_map.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * An unordered set storing its keys by value next to their hashcodes, so a
+ * lookup never follows a pointer. It is a flat_hash_map without values, and
+ * probes the same way as hash_map. Pointers to keys passed to the iteration
+ * actions are invalidated by any modification.
+ */
+
+typedef struct hash_set
+{
+  flat_hash_map map;
+} hash_set;
+
+/**
+ * Initializes a hash set with the specified hasher, key equality function
+ * and key size. Both functions receive pointers to keys.
+ *
+ * @param set - Pointer to an uninitialized hash set
+ * @param hasher - Key hasher
+ * @param key_equal - Key equality function
+ * @param key_size - Size of each key
+ *
+ * @return true if hasher and key_equal are not NULL and key_size is not zero
+ */
+bool init_hset                      (hash_set *set,
+                                     hash_func *hasher,
+                                     key_eq *key_equal,
+                                     size_t key_size);
+
+/**
+ * Frees a hash set, making it the same as uninitialized.
+ *
+ * @param set - Pointer to initialized hash set
+ */
+void free_hset                      (hash_set *set);
+
+/**
+ * Clears the hash set by marking the buckets as unoccupied. The size is set
+ * to zero.
+ *
+ * @param set - Pointer to initialized hash set
+ */
+void hset_clear                     (hash_set *set);
+
+/**
+ * Ensures n keys can be held without growing.
+ *
+ * @param set - Pointer to initialized hash set
+ * @param n - Number of keys
+ *
+ * @return true if n keys already fit or buckets were able to be allocated
+ * successfully
+ */
+bool hset_ensure_capacity           (hash_set *set,
+                                     size_t n);
+
+/**
+ * Puts a key into the set. Does nothing if the same key already exists.
+ *
+ * @param set - Pointer to initialized hash set
+ * @param key - Pointer to key
+ *
+ * @return true if operation succeeded
+ */
+bool hset_put                       (hash_set *restrict set,
+                                     const void *restrict key);
+
+/**
+ * Puts a key into the set only if key does not exist in the set.
+ *
+ * @param set - Pointer to initialized hash set
+ * @param key - Pointer to key
+ *
+ * @return true if operation succeeded, false if key already exists or
+ * memory could not be allocated
+ */
+bool hset_put_if_absent             (hash_set *restrict set,
+                                     const void *restrict key);
+
+/**
+ * Removes a key
+ *
+ * @param set - Pointer to initialized hash set
+ * @param key - Pointer to key
+ *
+ * @return true if such a key was found and removed
+ */
+bool hset_remove                    (hash_set *restrict set,
+                                     const void *restrict key);
+
+/**
+ * Checks if specified key exists
+ *
+ * @param set - Pointer to initialized hash set
+ * @param key - Pointer to key
+ *
+ * @return true if such a key exists, false otherwise
+ */
+bool hset_has_key                   (const hash_set *restrict set,
+                                     const void *restrict key);
+
+/**
+ * Iterates through every key of the set. The state of the set should be
+ * kept consistent during the iteration process.
+ *
+ * @param set - Pointer to initialized hash set
+ * @param it - An action to be performed on each key
+ */
+void hset_foreach                   (const hash_set *set,
+                                     void (*it)(const void *));
+
+/**
+ * Iterates through every key of the set, passing ctx along, until the action
+ * returns false. The state of the set should be kept consistent during the
+ * iteration process.
+ *
+ * @param set - Pointer to initialized hash set
+ * @param it - An action to be performed on each key, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every key was visited, false if it stopped early
+ */
+bool hset_foreach_ctx               (const hash_set *set,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
+/**
+ * Returns the size of the hash set
+ *
+ * @param set - Pointer to initialized hash set
+ *
+ * @return number of keys
+ */
+size_t hset_size                    (const hash_set *set);
+
+/**
+ * Returns the capacity of the hash set: the number of buckets, always zero
+ * or a power of two
+ *
+ * @param set - Pointer to initialized hash set
+ *
+ * @return capacity of the hash set
+ */
+size_t hset_capacity                (const hash_set *set);
+
+#endif
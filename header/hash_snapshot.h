@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HASH_SNAPSHOT_H__
+#define __HASH_SNAPSHOT_H__
+
+#include "hash_map.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A hash map written to a file as control bytes, buckets and the pairs
+ * themselves, using offsets instead of pointers. The file is mapped read-only
+ * and searched in place, so opening it only costs one pass over the buckets
+ * and processes mapping the same file share the same pages.
+ *
+ * The hashcodes are stored in the file: the hasher used to write it and the
+ * one used to read it must give the same hashcode for the same key, in every
+ * process. Seeded hashes such as hash_bytes are fine only with a fixed seed
+ * (hash_bytes_seeded). Snapshots are only portable between machines with the
+ * same byte order and size of unsigned long.
+ */
+
+/**
+ * Serializes a pair for a snapshot. Called twice per pair: once with out set
+ * to NULL to get the size, then with out pointing to that many bytes.
+ *
+ * @return the number of bytes of the serialized pair
+ */
+typedef size_t (hsnap_writer)(const void *pair, void *out);
+
+typedef struct hash_snapshot
+{
+  size_t len;
+  size_t cap;
+  const unsigned char *ctrl;
+  const uint64_t *slots; /* hashcode and data offset per bucket */
+  const unsigned char *data;
+  hash_func *hasher;
+  key_eq *key_equal;
+  void *base; /* the whole mapping */
+  size_t size;
+} hash_snapshot;
+
+/**
+ * Writes a snapshot of the map to a file. The file is first written under
+ * a temporary name and then renamed, so processes that still have an older
+ * snapshot at the same path mapped are not affected.
+ *
+ * Pairs are stored aligned to 8 bytes.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param path - Path of the snapshot file
+ * @param pair_size - Number of bytes copied from each pair if writer is NULL
+ * @param writer - Serializer for pairs that are not flat, may be NULL
+ *
+ * @return true if the snapshot was written, false if memory could not be
+ * allocated or the file could not be written
+ */
+bool hmap_write_snapshot            (const hash_map *restrict map,
+                                     const char *restrict path,
+                                     size_t pair_size,
+                                     hsnap_writer *writer);
+
+/**
+ * Opens a snapshot by mapping it read-only. Lookups call the hasher on the
+ * key being looked up and key_equal with the stored pair as the first
+ * argument and that key as the second.
+ *
+ * @param snap - Pointer to an uninitialized snapshot
+ * @param path - Path of the snapshot file
+ * @param hasher - Hash function, see above
+ * @param key_equal - Key equality function
+ *
+ * Opening checks the layout and reads every bucket once, so that each
+ * stored pair lies within the file. Only the size of the smallest pair is
+ * known, so key_equal must not read past it in a pair before finding out
+ * how long that pair is.
+ *
+ * @return true if the file was mapped and is a valid snapshot
+ */
+bool init_hsnap                     (hash_snapshot *restrict snap,
+                                     const char *restrict path,
+                                     hash_func *hasher,
+                                     key_eq *key_equal);
+
+/**
+ * Unmaps a snapshot, making it the same as uninitialized. Pointers returned
+ * by hsnap_get become invalid.
+ *
+ * @param snap - Pointer to initialized snapshot
+ */
+void free_hsnap                     (hash_snapshot *snap);
+
+/**
+ * Retrieves the stored pair with the same key. The pair is the one written
+ * for the hash map pair, not a copy, and lives as long as the mapping.
+ *
+ * @param snap - Pointer to initialized snapshot
+ * @param key - Key being looked up, as understood by hasher and key_equal
+ *
+ * @return stored pair or NULL if no such key exists
+ */
+const void *hsnap_get               (const hash_snapshot *restrict snap,
+                                     const void *restrict key);
+
+/**
+ * Checks if a pair with the same key is stored.
+ *
+ * @param snap - Pointer to initialized snapshot
+ * @param key - Key being looked up, as understood by hasher and key_equal
+ *
+ * @return true if such a key exists, false otherwise
+ */
+bool hsnap_has_key                  (const hash_snapshot *restrict snap,
+                                     const void *restrict key);
+
+/**
+ * Iterates through every stored pair, passing ctx along, until the action
+ * returns false.
+ *
+ * @param snap - Pointer to initialized snapshot
+ * @param it - An action to be performed on each pair, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every pair was visited, false if it stopped early
+ */
+bool hsnap_foreach_ctx              (const hash_snapshot *snap,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
+/**
+ * Returns the number of pairs stored
+ *
+ * @param snap - Pointer to initialized snapshot
+ *
+ * @return number of pairs
+ */
+size_t hsnap_size                   (const hash_snapshot *snap);
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Open addressing core shared by the hash tables and the maps generated by
+ * HMAP_DEFINE. Everything here is inlined into the including file, so the
+ * group width follows the instruction set that file is compiled for.
+ */
+
+#ifndef __HMAP_GROUP_H__
+#define __HMAP_GROUP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Each bucket has a control byte stored in a separate array: full buckets
+ * hold 7 bits of the hashcode (the tag), vacant buckets have the high bit
+ * set. Lookups compare a whole group of control bytes against the tag at
+ * once and only call key_equal on the buckets whose tag matched.
+ *
+ * The control array has HMAP_GROUP_WIDTH extra bytes mirroring the first
+ * ones so a group starting near the end can be loaded without wrapping.
+ */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HMAP_GROUP_WIDTH 32
+#define HMAP_MASK_SHIFT 0
+#elif defined(__SSE2__) || defined(_M_X64) \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HMAP_GROUP_WIDTH 16
+#define HMAP_MASK_SHIFT 0
+#else
+#define HMAP_GROUP_WIDTH 8
+#define HMAP_MASK_SHIFT 3
+#endif
+
+#define HMAP_CTRL_EMPTY   ((unsigned char) 0x80)
+#define HMAP_CTRL_DELETED ((unsigned char) 0xFE)
+
+#define HMAP_NPOS ((size_t) -1)
+
+typedef uint64_t hmap_group_mask;
+
+#if HMAP_GROUP_WIDTH == 32
+
+static inline
+hmap_group_mask hmap_group_match
+(unsigned char const * group, unsigned char tag)
+{
+  __m256i const ctrl = _mm256_loadu_si256((__m256i const *) group);
+  __m256i const cmp = _mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8((char) tag));
+  return (uint32_t) _mm256_movemask_epi8(cmp);
+}
+
+static inline
+hmap_group_mask hmap_group_match_vacant
+(unsigned char const * group)
+{
+  /* empty and deleted are the only ones with the high bit set */
+  __m256i const ctrl = _mm256_loadu_si256((__m256i const *) group);
+  return (uint32_t) _mm256_movemask_epi8(ctrl);
+}
+
+#elif HMAP_GROUP_WIDTH == 16
+
+static inline
+hmap_group_mask hmap_group_match
+(unsigned char const * group, unsigned char tag)
+{
+  __m128i const ctrl = _mm_loadu_si128((__m128i const *) group);
+  __m128i const cmp = _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) tag));
+  return (uint32_t) _mm_movemask_epi8(cmp);
+}
+
+static inline
+hmap_group_mask hmap_group_match_vacant
+(unsigned char const * group)
+{
+  /* empty and deleted are the only ones with the high bit set */
+  __m128i const ctrl = _mm_loadu_si128((__m128i const *) group);
+  return (uint32_t) _mm_movemask_epi8(ctrl);
+}
+
+#else
+
+#define HMAP_LSBS UINT64_C(0x0101010101010101)
+#define HMAP_MSBS UINT64_C(0x8080808080808080)
+
+static inline
+uint64_t hmap_load_group
+(unsigned char const * group)
+{
+  /* little endian load regardless of the host */
+  uint64_t word = 0;
+  for (size_t i = HMAP_GROUP_WIDTH; i-- > 0; )
+  {
+    word = (word << 8) | group[i];
+  }
+  return word;
+}
+
+static inline
+hmap_group_mask hmap_group_match
+(unsigned char const * group, unsigned char tag)
+{
+  /* may report false positives, those are filtered by the caller */
+  uint64_t const word = hmap_load_group(group) ^ (HMAP_LSBS * tag);
+  return (word - HMAP_LSBS) & ~word & HMAP_MSBS;
+}
+
+static inline
+hmap_group_mask hmap_group_match_vacant
+(unsigned char const * group)
+{
+  return hmap_load_group(group) & HMAP_MSBS;
+}
+
+#endif
+
+static inline
+hmap_group_mask hmap_group_match_empty
+(unsigned char const * group)
+{
+  return hmap_group_match(group, HMAP_CTRL_EMPTY);
+}
+
+static inline
+size_t hmap_mask_first
+(hmap_group_mask mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return (size_t) __builtin_ctzll(mask) >> HMAP_MASK_SHIFT;
+#else
+  size_t n = 0;
+  for (; !(mask & 1); mask >>= 1) ++n;
+  return n >> HMAP_MASK_SHIFT;
+#endif
+}
+
+static inline
+size_t hmap_log2_cap
+(size_t cap)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return (size_t) __builtin_ctzll(cap);
+#else
+  size_t n = 0;
+  for (; cap > 1; cap >>= 1) ++n;
+  return n;
+#endif
+}
+
+static inline
+unsigned char hmap_tag
+(unsigned long hashcode)
+{
+  return hashcode & 0x7F;
+}
+
+static inline
+size_t hmap_home
+(unsigned long hashcode, size_t cap)
+{
+  /* fibonacci hashing: the high bits of the product are the best mixed */
+  uint64_t const spread = (uint64_t) hashcode * UINT64_C(0x9E3779B97F4A7C15);
+  return (size_t) (spread >> (64 - hmap_log2_cap(cap)));
+}
+
+static inline
+void hmap_set_ctrl
+(unsigned char * ctrl, size_t cap, size_t slot, unsigned char value)
+{
+  ctrl[slot] = value;
+  if (slot < HMAP_GROUP_WIDTH)
+  {
+    /* keep the mirrored bytes in sync */
+    ctrl[cap + slot] = value;
+  }
+}
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Internals of hash_map shared with the bulk builder, which lives in its
+ * own file so only programs using hmap_put_all need threads. Not part of
+ * the API.
+ */
+
+#ifndef __HMAP_INTERNAL_H__
+#define __HMAP_INTERNAL_H__
+
+#include "hash_map.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * In robin hood mode, full buckets hold the probe distance instead of the
+ * tag. Distances that do not fit are saturated and recomputed from the
+ * hashcode when needed.
+ */
+#define HMAP_CTRL_FAR ((unsigned char) 0x7F)
+
+#ifdef HMAP_STATS
+/* lookups count too, so the counters are written through const maps */
+#define HMAP_STAT_ADD(map, field, n) (((hash_map *) (map))->counters.field += (n))
+#else
+#define HMAP_STAT_ADD(map, field, n) ((void) sizeof (n))
+#endif
+
+/**
+ * @param dist - distance of a pair from its home bucket
+ *
+ * @return the control byte of the pair in robin hood mode
+ */
+static inline
+unsigned char hmap_rh_ctrl
+(size_t dist)
+{
+  return dist < HMAP_CTRL_FAR ? (unsigned char) dist : HMAP_CTRL_FAR;
+}
+
+/**
+ * @param map - Pointer to initialized hash map
+ * @param n - Number of pairs
+ *
+ * @return the fewest buckets that hold n pairs under the maximum load factor
+ */
+size_t hmap_buckets_for             (const hash_map *map,
+                                     size_t n);
+
+/**
+ * @param cap - Bucket count, must be a power of two and at least
+ *              HMAP_GROUP_WIDTH
+ * @param out_ctrl - Outputs the control bytes of the new buckets
+ *
+ * @return buckets with all control bytes empty or NULL if allocation failed
+ */
+map_entry *hmap_alloc_buckets       (size_t cap,
+                                     unsigned char **out_ctrl);
+
+/**
+ * Replaces the buckets of a map that is not migrating with buckets from
+ * hmap_alloc_buckets holding len pairs and no deleted markers.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param mem - New buckets
+ * @param ctrl - Control bytes of mem
+ * @param cap - Capacity of mem
+ * @param len - Number of pairs in mem
+ */
+void hmap_adopt_buckets             (hash_map *map,
+                                     map_entry *mem,
+                                     unsigned char *ctrl,
+                                     size_t cap,
+                                     size_t len);
+
+/**
+ * Same as hmap_put with a known hashcode, without growing the buckets
+ * first. The map must have room for one more pair.
+ *
+ * @param map - Pointer to initialized hash map
+ * @param pair - Pointer to key-value pair
+ * @param hashcode - Hashcode of pair
+ *
+ * @return true if pair was placed
+ */
+bool hmap_put_hashed                (hash_map *restrict map,
+                                     const void *restrict pair,
+                                     unsigned long hashcode);
+
+#endif
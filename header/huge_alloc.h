@@ -0,0 +1,98 @@
+/* 
+ * Copyright (c) 2019 Paul Teng
+ * 
+ * PCLIB is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU Lesser General Public License as   
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HUGE_ALLOC_H__
+#define __HUGE_ALLOC_H__
+
+#include <stddef.h>
+
+/*
+ * Allocation of the backing stores of array_list, string_buffer and
+ * bit_array. Blocks of at least HUGE_ALLOC_THRESHOLD bytes are mapped
+ * directly from the system where mremap exists (Linux), asking for
+ * transparent huge pages. Growing such a block remaps its pages instead of
+ * copying them. Smaller blocks, and every block elsewhere, use malloc.
+ *
+ * Whether a block is mapped is decided by its size alone, so the caller
+ * must pass the exact size the block was last allocated with.
+ */
+
+/**
+ * The size in bytes from which blocks are mapped. It is read only when
+ * building the library.
+ *
+ * By default, 64 MiB
+ */
+#ifndef HUGE_ALLOC_THRESHOLD
+#define HUGE_ALLOC_THRESHOLD ((size_t) 64 << 20)
+#endif
+
+/**
+ * Allocates a block
+ *
+ * @param size - Size of the block in bytes, must not be zero
+ *
+ * @return the block, NULL if it could not be allocated
+ */
+void *huge_alloc                    (size_t size);
+
+/**
+ * Allocates a block with every byte set to zero. Mapped blocks come from
+ * the system zeroed and are not touched.
+ *
+ * @param size - Size of the block in bytes, must not be zero
+ *
+ * @return the block, NULL if it could not be allocated
+ */
+void *huge_calloc                   (size_t size);
+
+/**
+ * Resizes a block, keeping its contents up to the smaller of both sizes.
+ * The block is copied only when it moves between malloc and a mapping.
+ *
+ * @param ptr - Block being resized, NULL to allocate a new one
+ * @param old_size - Size the block was allocated with, 0 if ptr is NULL
+ * @param new_size - New size of the block in bytes, must not be zero
+ *
+ * @return the resized block, NULL if it could not be resized, in which
+ * case the original block is left as it was
+ */
+void *huge_realloc                  (void *ptr,
+                                     size_t old_size,
+                                     size_t new_size);
+
+/**
+ * Frees a block
+ *
+ * @param ptr - Block being freed, ignored if NULL
+ * @param size - Size the block was allocated with
+ */
+void huge_free                      (void *ptr,
+                                     size_t size);
+
+/**
+ * Turns a block into one that can be released with free.
+ *
+ * @param ptr - Block being turned, is invalid afterwards unless returned
+ * @param size - Size the block was allocated with, must not be zero
+ *
+ * @return a block holding the same bytes that must be freed with free, NULL
+ * if it could not be allocated, in which case ptr is left as it was
+ */
+void *huge_to_malloc                (void *ptr,
+                                     size_t size);
+
+#endif
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LRU_CACHE_H__
+#define __LRU_CACHE_H__
+
+#include "block_align.h"
+#include "hash_map.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * A cache that drops its least recently used entries once it holds too many
+ * entries or bytes. Every entry is a node holding the key and the value,
+ * linked into a list from most to least recently used, and a hash_map finds
+ * the node by key, so lookups, insertions and evictions take constant time.
+ * The map stores pointers to the keys inside the nodes, so the hasher and key
+ * equality function receive pointers to keys.
+ *
+ * An entry weighs the bytes of its node unless it is put with a weight of
+ * its own, for values pointing to memory the cache does not see.
+ */
+
+/**
+ * Called with an entry the cache drops: evicted to stay within its bounds,
+ * replaced by a put, or cleared. Not called for entries taken out by
+ * lru_remove.
+ */
+typedef void (lru_evict_func)(const void *key, const void *value, void *ctx);
+
+typedef struct lru_node
+{
+  struct lru_node *prev; /* more recently used */
+  struct lru_node *next; /* less recently used */
+  size_t weight;
+  block_max_align data[]; /* key, then value */
+} lru_node;
+
+typedef struct lru_cache
+{
+  size_t len;
+  size_t key_blk;
+  size_t value_blk;
+  size_t value_off; /* key_blk rounded up to the alignment of a value */
+  size_t max_entries; /* 0 if unbounded */
+  size_t max_bytes; /* 0 if unbounded */
+  size_t bytes;
+  lru_node *first; /* most recently used */
+  lru_node *last; /* least recently used */
+  lru_node *spare; /* an evicted node kept for the next insertion */
+  lru_evict_func *on_evict;
+  void *evict_ctx;
+  hash_map map;
+} lru_cache;
+
+typedef struct sharded_lru sharded_lru;
+
+/**
+ * Initializes an LRU cache with the specified hasher, key equality function,
+ * key size, value size and maximum number of entries.
+ *
+ * @param cache - Pointer to an uninitialized LRU cache
+ * @param hasher - Key hasher
+ * @param key_equal - Key equality function
+ * @param key_size - Size of each key
+ * @param value_size - Size of each value
+ * @param max_entries - Maximum number of entries, 0 if unbounded
+ *
+ * @return true if hasher and key_equal are not NULL and key_size is not zero
+ */
+bool init_lru                       (lru_cache *cache,
+                                     hash_func *hasher,
+                                     key_eq *key_equal,
+                                     size_t key_size,
+                                     size_t value_size,
+                                     size_t max_entries);
+
+/**
+ * Frees an LRU cache, making it the same as uninitialized. The eviction
+ * callback is called for every entry.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ */
+void free_lru                       (lru_cache *cache);
+
+/**
+ * Removes every entry, calling the eviction callback for each.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ */
+void lru_clear                      (lru_cache *cache);
+
+/**
+ * Changes the maximum number of entries and bytes, evicting entries until
+ * the cache is within them.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ * @param max_entries - Maximum number of entries, 0 if unbounded
+ * @param max_bytes - Maximum total weight of the entries, 0 if unbounded
+ */
+void lru_set_bounds                 (lru_cache *cache,
+                                     size_t max_entries,
+                                     size_t max_bytes);
+
+/**
+ * Sets the function called with every entry the cache drops.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ * @param on_evict - Eviction callback, NULL for none
+ * @param ctx - Passed to every call of on_evict
+ */
+void lru_set_evict                  (lru_cache *cache,
+                                     lru_evict_func *on_evict,
+                                     void *ctx);
+
+/**
+ * Puts a key with corresponding value into the cache as the most recently
+ * used entry, replacing the value if the key exists. Least recently used
+ * entries are evicted to make room.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ * @param key - Pointer to key
+ * @param value - Pointer to value
+ *
+ * @return true if the entry was put, false if memory could not be allocated
+ */
+bool lru_put                        (lru_cache *restrict cache,
+                                     const void *restrict key,
+                                     const void *restrict value);
+
+/**
+ * Same as lru_put with the weight counted against the maximum bytes given
+ * explicitly instead of being the size of the node.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ * @param key - Pointer to key
+ * @param value - Pointer to value
+ * @param weight - Weight of the entry
+ *
+ * @return true if the entry was put, false if it weighs more than the
+ * maximum bytes or memory could not be allocated
+ */
+bool lru_put_weighted               (lru_cache *restrict cache,
+                                     const void *restrict key,
+                                     const void *restrict value,
+                                     size_t weight);
+
+/**
+ * Retrieves the value of a key and marks the entry as the most recently
+ * used. The value stays valid until the entry is dropped.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ * @param key - Pointer to key
+ *
+ * @return the value or NULL if no such key exists
+ */
+const void *lru_get                 (lru_cache *restrict cache,
+                                     const void *restrict key);
+
+/**
+ * Retrieves the value of a key without marking it as used.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ * @param key - Pointer to key
+ *
+ * @return the value or NULL if no such key exists
+ */
+const void *lru_peek                (const lru_cache *restrict cache,
+                                     const void *restrict key);
+
+/**
+ * Checks if specified key exists without marking it as used.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ * @param key - Pointer to key
+ *
+ * @return true if such a key exists, false otherwise
+ */
+bool lru_has_key                    (const lru_cache *restrict cache,
+                                     const void *restrict key);
+
+/**
+ * Removes a key without calling the eviction callback.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ * @param key - Pointer to key
+ * @param value - Filled with the removed value; ignored if NULL
+ *
+ * @return true if such a key was found and removed
+ */
+bool lru_remove                     (lru_cache *restrict cache,
+                                     const void *restrict key,
+                                     void *restrict value);
+
+/**
+ * Evicts the least recently used entry.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ *
+ * @return true if an entry was evicted, false if the cache is empty
+ */
+bool lru_evict                      (lru_cache *cache);
+
+/**
+ * Iterates through every entry from the most to the least recently used,
+ * passing ctx along, until the action returns false. Entries are not marked
+ * as used. The state of the cache should be kept consistent during the
+ * iteration process.
+ *
+ * @param cache - Pointer to initialized LRU cache
+ * @param it - An action performed on each key and value, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool lru_foreach_ctx                (const lru_cache *cache,
+                                     bool (*it)(const void *, const void *, void *),
+                                     void *ctx);
+
+/**
+ * Returns the number of entries in the cache
+ *
+ * @param cache - Pointer to initialized LRU cache
+ *
+ * @return number of entries
+ */
+size_t lru_size                     (const lru_cache *cache);
+
+/**
+ * Returns the total weight of the entries in the cache
+ *
+ * @param cache - Pointer to initialized LRU cache
+ *
+ * @return total weight
+ */
+size_t lru_bytes                    (const lru_cache *cache);
+
+/*
+ * A sharded LRU cache splits the keys by hashcode between several LRU
+ * caches, each with its own lock, so threads using different shards do not
+ * wait for each other. The bounds are split between the shards so their sum
+ * is the global bound, which only approximates a global LRU order. There are
+ * never more shards than a bound allows, so each shard holds at least one
+ * entry. Values are copied out since another thread could drop them right
+ * after the lock is released. The eviction callback runs with the shard's
+ * lock held and must not use the cache.
+ */
+
+/**
+ * Constructs a sharded LRU cache.
+ *
+ * @param hasher - Key hasher
+ * @param key_equal - Key equality function
+ * @param key_size - Size of each key
+ * @param value_size - Size of each value
+ * @param max_entries - Maximum number of entries, 0 if unbounded
+ * @param max_bytes - Maximum total weight of the entries, 0 if unbounded
+ * @param shards - Number of shards, 0 picks a default; rounded up to a power
+ *                 of two, then down until no bound is smaller than it
+ *
+ * @return NULL if any argument is invalid or the cache cannot be allocated
+ */
+sharded_lru *new_slru               (hash_func *hasher,
+                                     key_eq *key_equal,
+                                     size_t key_size,
+                                     size_t value_size,
+                                     size_t max_entries,
+                                     size_t max_bytes,
+                                     size_t shards);
+
+/**
+ * Destroys a sharded LRU cache, calling the eviction callback for every
+ * entry. No other thread may be using the cache.
+ *
+ * @param cache - Sharded LRU cache being destroyed
+ */
+void delete_slru                    (sharded_lru *cache);
+
+/**
+ * Sets the eviction callback of every shard. No other thread may be using
+ * the cache.
+ *
+ * @param cache - Sharded LRU cache
+ * @param on_evict - Eviction callback, NULL for none
+ * @param ctx - Passed to every call of on_evict
+ */
+void slru_set_evict                 (sharded_lru *cache,
+                                     lru_evict_func *on_evict,
+                                     void *ctx);
+
+/**
+ * Same as lru_put, on the shard of the key.
+ */
+bool slru_put                       (sharded_lru *restrict cache,
+                                     const void *restrict key,
+                                     const void *restrict value);
+
+/**
+ * Same as lru_put_weighted, on the shard of the key.
+ */
+bool slru_put_weighted              (sharded_lru *restrict cache,
+                                     const void *restrict key,
+                                     const void *restrict value,
+                                     size_t weight);
+
+/**
+ * Copies the value of a key and marks the entry as the most recently used.
+ *
+ * @param cache - Sharded LRU cache
+ * @param key - Pointer to key
+ * @param value - Filled with the value if the key exists
+ *
+ * @return true if such a key exists
+ */
+bool slru_get                       (sharded_lru *restrict cache,
+                                     const void *restrict key,
+                                     void *restrict value);
+
+/**
+ * Same as lru_remove, on the shard of the key.
+ */
+bool slru_remove                    (sharded_lru *restrict cache,
+                                     const void *restrict key,
+                                     void *restrict value);
+
+/**
+ * Returns the number of entries in every shard. Entries put or dropped at
+ * the same time might or might not be counted.
+ *
+ * @param cache - Sharded LRU cache
+ *
+ * @return number of entries
+ */
+size_t slru_size                    (sharded_lru *cache);
+
+#endif
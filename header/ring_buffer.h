@@ -124,4 +124,18 @@ const void *ringbuf_peek            (const ring_buffer *buf);
 void ringbuf_foreach                (const ring_buffer *buf,
                                      void (*it)(const void *));
 
+/**
+ * Iterates through the ring buffer in order of insertion, passing ctx along,
+ * until the action returns false.
+ *
+ * @param buf - Pointer to initialized ring buffer
+ * @param it - An action to be performed on each item, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every item was visited, false if it stopped early
+ */
+bool ringbuf_foreach_ctx            (const ring_buffer *buf,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
 #endif
\ No newline at end of file
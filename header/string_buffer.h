@@ -17,27 +17,32 @@
 #ifndef __STRING_BUFFER_H__
 #define __STRING_BUFFER_H__
 
+#include "growth_policy.h"
+
 #include <stddef.h>
 #include <stdbool.h>
 
 /**
- * The growth function for the string buffer.
- *
- * By default, the capacity is scaled to the next multiple of 16.
- *
- * @param n - The precomputed new capacity
+ * The number of bytes, including the null byte, stored inside the buffer
+ * itself. Shorter strings do not allocate; once the string grows past this,
+ * it moves to the heap. The library and its users must agree on this size.
  *
- * @return value >= n
+ * By default, the size of four pointers
  */
-#ifndef STRBUF_GROW /* (size_t n) */
-#define STRBUF_GROW(n) ((((n) / 16) + 1) * 16)
+#ifndef STRBUF_INLINE
+#define STRBUF_INLINE (4 * sizeof(char *))
 #endif
 
 typedef struct string_buffer
 {
   size_t len;
-  size_t cap;
-  char *mem;
+  size_t cap; /* less than STRBUF_INLINE while the string is inline */
+  union
+  {
+    char *heap;
+    char local[STRBUF_INLINE];
+  } mem;
+  growth_policy growth;
 } string_buffer;
 
 /**
@@ -90,7 +95,9 @@ void strbuf_clear                   (string_buffer *buffer);
 void strbuf_compact                 (string_buffer *buffer);
 
 /**
- * Ensures the capacity is at least n.
+ * Ensures the capacity is at least n, not counting the null byte. The
+ * capacity grows following the buffer's growth policy, so it can end up
+ * larger than n.
  *
  * @param buffer - Pointer to initialized string buffer
  * @param n - New minimum capacity of the buffer
@@ -101,6 +108,18 @@ void strbuf_compact                 (string_buffer *buffer);
 bool strbuf_ensure_capacity         (string_buffer *buffer,
                                      size_t n);
 
+/**
+ * Changes how the capacity grows once it is too small. The new policy is
+ * applied on the next growth.
+ *
+ * @param buffer - Pointer to initialized string buffer
+ * @param policy - New growth policy, NULL for the default one
+ *
+ * @return true if the policy was valid and applied
+ */
+bool strbuf_set_growth              (string_buffer *restrict buffer,
+                                     const growth_policy *restrict policy);
+
 /**
  * Appends a character to the end of the buffer
  *
@@ -156,7 +175,8 @@ size_t strbuf_size                  (const string_buffer *buffer);
 size_t strbuf_capacity              (const string_buffer *buffer);
 
 /**
- * Returns a pointer to the first character
+ * Returns a pointer to the first character. While the string is stored
+ * inside the buffer, it moves along with the buffer.
  *
  * @param buffer - Pointer to initialized string buffer
  *
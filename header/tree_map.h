@@ -21,6 +21,7 @@
 #include <stdbool.h>
 
 typedef void (tmap_it)(const void *, const void *);
+typedef bool (tmap_ctx_it)(const void *, const void *, void *);
 typedef int (key_cmp)(const void *, const void *);
 
 typedef struct tmap_node
@@ -179,6 +180,53 @@ void tmap_foreach_lt                (const tree_map *restrict tree,
                                      const void *restrict key,
                                      tmap_it *it);
 
+/**
+ * Iterates through every key-value entry of the tree in sorted order, passing
+ * ctx along, until the action returns false. The state of the tree should be
+ * kept consistent during the iteration process.
+ *
+ * @param tree - Pointer to initialized tree map
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tmap_foreach_ctx               (const tree_map *tree,
+                                     tmap_ctx_it *it,
+                                     void *ctx);
+
+/**
+ * Same as tmap_foreach_ctx, but only iterates through the entries greater
+ * than the specified key.
+ *
+ * @param tree - Pointer to initialized tree map
+ * @param key - Key being compared
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tmap_foreach_gt_ctx            (const tree_map *restrict tree,
+                                     const void *restrict key,
+                                     tmap_ctx_it *it,
+                                     void *ctx);
+
+/**
+ * Same as tmap_foreach_ctx, but only iterates through the entries lesser
+ * than the specified key.
+ *
+ * @param tree - Pointer to initialized tree map
+ * @param key - Key being compared
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tmap_foreach_lt_ctx            (const tree_map *restrict tree,
+                                     const void *restrict key,
+                                     tmap_ctx_it *it,
+                                     void *ctx);
+
 /**
  * Returns the size of the tree map
  *
@@ -17,23 +17,13 @@
 #ifndef __TREE_MULTIMAP_H__
 #define __TREE_MULTIMAP_H__
 
+#include "growth_policy.h"
+
 #include <stddef.h>
 #include <stdbool.h>
 
-/**
- * The growth function for each node of the multimap.
- *
- * By default, the capacity is unscaled (no elements are preallocated)
- *
- * @param n - The precomputed new capacity
- *
- * @return value >= n
- */
-#ifndef TMMAP_GROW /* (size_t n) */
-#define TMMAP_GROW(n) (n)
-#endif
-
 typedef void (tmmap_it)(const void *, size_t, const void *);
+typedef bool (tmmap_ctx_it)(const void *, size_t, const void *, void *);
 typedef int (key_cmp)(const void *, const void *);
 
 typedef struct tmmap_node
@@ -52,6 +42,7 @@ typedef struct tree_multimap
   size_t value_blk;
   tmmap_node *root;
   key_cmp *key_compare;
+  growth_policy growth; /* of the values of each key */
 } tree_multimap;
 
 /**
@@ -77,6 +68,19 @@ bool init_tmmap                     (tree_multimap *tree,
  */
 void free_tmmap                     (tree_multimap *tree);
 
+/**
+ * Changes how the values of a key grow once they do not fit. A new key
+ * starts with room for one value. By default, the room grows by
+ * GROWTH_FACTOR with a minimum step of one value.
+ *
+ * @param tree - Pointer to initialized tree multimap
+ * @param policy - New growth policy, NULL for the default one
+ *
+ * @return true if the policy was valid and applied
+ */
+bool tmmap_set_growth               (tree_multimap *restrict tree,
+                                     const growth_policy *restrict policy);
+
 /**
  * Clears a tree multimap by deallocating all nodes and setting size to zero.
  *
@@ -230,6 +234,53 @@ void tmmap_foreach_lt               (const tree_multimap *restrict tree,
                                      const void *restrict key,
                                      tmmap_it *it);
 
+/**
+ * Iterates through every key with its values of the tree in sorted order,
+ * passing ctx along, until the action returns false. The state of the tree
+ * should be kept consistent during the iteration process.
+ *
+ * @param tree - Pointer to initialized tree multimap
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tmmap_foreach_ctx              (const tree_multimap *tree,
+                                     tmmap_ctx_it *it,
+                                     void *ctx);
+
+/**
+ * Same as tmmap_foreach_ctx, but only iterates through the entries greater
+ * than the specified key.
+ *
+ * @param tree - Pointer to initialized tree multimap
+ * @param key - Key being compared
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tmmap_foreach_gt_ctx           (const tree_multimap *restrict tree,
+                                     const void *restrict key,
+                                     tmmap_ctx_it *it,
+                                     void *ctx);
+
+/**
+ * Same as tmmap_foreach_ctx, but only iterates through the entries lesser
+ * than the specified key.
+ *
+ * @param tree - Pointer to initialized tree multimap
+ * @param key - Key being compared
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tmmap_foreach_lt_ctx           (const tree_multimap *restrict tree,
+                                     const void *restrict key,
+                                     tmmap_ctx_it *it,
+                                     void *ctx);
+
 /**
  * Returns the size of the tree multimap
  *
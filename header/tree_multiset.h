@@ -21,6 +21,7 @@
 #include <stdbool.h>
 
 typedef void (tmset_it)(const void *, size_t);
+typedef bool (tmset_ctx_it)(const void *, size_t, void *);
 typedef int (key_cmp)(const void *, const void *);
 
 typedef struct tmset_node
@@ -174,6 +175,53 @@ void tmset_foreach_lt               (const tree_multiset *restrict tree,
                                      const void *restrict key,
                                      tmset_it *it);
 
+/**
+ * Iterates through every key with its count of the tree in sorted order,
+ * passing ctx along, until the action returns false. The state of the tree
+ * should be kept consistent during the iteration process.
+ *
+ * @param tree - Pointer to initialized tree multiset
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tmset_foreach_ctx              (const tree_multiset *tree,
+                                     tmset_ctx_it *it,
+                                     void *ctx);
+
+/**
+ * Same as tmset_foreach_ctx, but only iterates through the entries greater
+ * than the specified key.
+ *
+ * @param tree - Pointer to initialized tree multiset
+ * @param key - Key being compared
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tmset_foreach_gt_ctx           (const tree_multiset *restrict tree,
+                                     const void *restrict key,
+                                     tmset_ctx_it *it,
+                                     void *ctx);
+
+/**
+ * Same as tmset_foreach_ctx, but only iterates through the entries lesser
+ * than the specified key.
+ *
+ * @param tree - Pointer to initialized tree multiset
+ * @param key - Key being compared
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tmset_foreach_lt_ctx           (const tree_multiset *restrict tree,
+                                     const void *restrict key,
+                                     tmset_ctx_it *it,
+                                     void *ctx);
+
 /**
  * Returns the size of the tree multiset
  *
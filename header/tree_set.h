@@ -146,6 +146,53 @@ void tset_foreach_lt                (const tree_set *restrict tree,
                                      const void *restrict key,
                                      void (*it)(const void *));
 
+/**
+ * Iterates through every key of the tree in sorted order, passing ctx along,
+ * until the action returns false. The state of the tree should be kept
+ * consistent during the iteration process.
+ *
+ * @param tree - Pointer to initialized tree set
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tset_foreach_ctx               (const tree_set *tree,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
+/**
+ * Same as tset_foreach_ctx, but only iterates through the entries greater
+ * than the specified key.
+ *
+ * @param tree - Pointer to initialized tree set
+ * @param key - Key being compared
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tset_foreach_gt_ctx            (const tree_set *restrict tree,
+                                     const void *restrict key,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
+/**
+ * Same as tset_foreach_ctx, but only iterates through the entries lesser
+ * than the specified key.
+ *
+ * @param tree - Pointer to initialized tree set
+ * @param key - Key being compared
+ * @param it - An action to be performed on each entry, returns false to stop
+ * @param ctx - Passed to every call of it
+ *
+ * @return true if every entry was visited, false if it stopped early
+ */
+bool tset_foreach_lt_ctx            (const tree_set *restrict tree,
+                                     const void *restrict key,
+                                     bool (*it)(const void *, void *),
+                                     void *ctx);
+
 /**
  * Returns the size of the tree set
  *
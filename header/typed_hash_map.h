@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TYPED_HASH_MAP_H__
+#define __TYPED_HASH_MAP_H__
+
+#include "hash_map.h"
+#include "hmap_group.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Defines a hash map type with keys and values stored by type and the hash
+ * and equality inlined into every operation, so no call goes through a
+ * function pointer. Probing works like hash_map. HMAP_GROW, HMAP_MAX_LOAD
+ * and HMAP_PROBE from hash_map.h apply.
+ *
+ * To define a map called int_map from int to double:
+ *
+ *    #define INT_HASH(k) ((unsigned long) (k))
+ *    #define INT_EQ(a, b) ((a) == (b))
+ *
+ *    HMAP_DEFINE(int_map, int, double, INT_HASH, INT_EQ)
+ *
+ * which defines the types int_map and int_map_entry and the following
+ * functions, all static inline:
+ *
+ *    bool init_int_map(int_map *map);
+ *    void free_int_map(int_map *map);
+ *    void int_map_clear(int_map *map);
+ *    bool int_map_ensure_capacity(int_map *map, size_t n);
+ *    bool int_map_put(int_map *map, int key, double value);
+ *    bool int_map_put_if_absent(int_map *map, int key, double value);
+ *    bool int_map_remove(int_map *map, int key);
+ *    bool int_map_has_key(const int_map *map, int key);
+ *    double *int_map_get(const int_map *map, int key);
+ *    void int_map_foreach(const int_map *map, void (*it)(const int *, double *));
+ *    bool int_map_foreach_ctx(const int_map *map,
+ *                             bool (*it)(const int *, double *, void *),
+ *                             void *ctx);
+ *    size_t int_map_size(const int_map *map);
+ *
+ * They behave like the hash_map functions of the same name except pointers
+ * returned by int_map_get are invalidated by any modification.
+ *
+ * @param name - The name of the map type, also used to prefix the functions
+ * @param K - The key type
+ * @param V - The value type
+ * @param hash_expr - Function or function-like macro taking a key and
+ *                    returning its hashcode as unsigned long
+ * @param eq_expr - Function or function-like macro taking two keys and
+ *                  returning true if they are the same
+ */
+#define HMAP_DEFINE(name, K, V, hash_expr, eq_expr) \
+  typedef struct name##_entry \
+  { \
+    K key; \
+    V value; \
+  } name##_entry; \
+  \
+  typedef struct name \
+  { \
+    size_t len; \
+    size_t cap; \
+    size_t dead; \
+    size_t grow_at; \
+    name##_entry *mem; \
+    unsigned char *ctrl; \
+  } name; \
+  \
+  static inline \
+  bool init_##name \
+  (name * const map) \
+  { \
+    map->len = 0; \
+    map->cap = 0; \
+    map->dead = 0; \
+    map->grow_at = 0; \
+    map->mem = NULL; \
+    map->ctrl = NULL; \
+    return true; \
+  } \
+  \
+  static inline \
+  void free_##name \
+  (name * const map) \
+  { \
+    free(map->mem); \
+    init_##name(map); \
+  } \
+  \
+  static inline \
+  void name##_clear \
+  (name * const map) \
+  { \
+    map->len = 0; \
+    map->dead = 0; \
+    if (map->cap > 0) \
+    { \
+      memset(map->ctrl, HMAP_CTRL_EMPTY, map->cap + HMAP_GROUP_WIDTH); \
+    } \
+  } \
+  \
+  static inline \
+  size_t name##_find_slot \
+  (name const * const map, K const key, unsigned long const hashcode) \
+  { \
+    size_t const cap = map->cap; \
+    unsigned char const tag = hmap_tag(hashcode); \
+    size_t const home = hmap_home(hashcode, cap); \
+    for (size_t k = 0; k < cap; k += HMAP_GROUP_WIDTH) \
+    { \
+      size_t const offset = HMAP_PROBE(home, k) & (cap - 1); \
+      unsigned char const * group = &map->ctrl[offset]; \
+      for (hmap_group_mask mask = hmap_group_match(group, tag); mask != 0; mask &= mask - 1) \
+      { \
+        size_t const slot = (offset + hmap_mask_first(mask)) & (cap - 1); \
+        if (eq_expr(map->mem[slot].key, key)) \
+        { \
+          return slot; \
+        } \
+      } \
+      if (hmap_group_match_empty(group) != 0) \
+      { \
+        break; \
+      } \
+    } \
+    return HMAP_NPOS; \
+  } \
+  \
+  static inline \
+  size_t name##_vacant_slot \
+  (unsigned char const * const ctrl, size_t const cap, unsigned long const hashcode) \
+  { \
+    size_t const home = hmap_home(hashcode, cap); \
+    for (size_t k = 0; ; k += HMAP_GROUP_WIDTH) \
+    { \
+      size_t const offset = HMAP_PROBE(home, k) & (cap - 1); \
+      hmap_group_mask const mask = hmap_group_match_vacant(&ctrl[offset]); \
+      if (mask != 0) \
+      { \
+        return (offset + hmap_mask_first(mask)) & (cap - 1); \
+      } \
+    } \
+  } \
+  \
+  static inline \
+  bool name##_resize \
+  (name * const map, size_t const new_cap) \
+  { \
+    name##_entry * const new_mem = \
+        malloc(new_cap * sizeof(name##_entry) + new_cap + HMAP_GROUP_WIDTH); \
+    if (new_mem == NULL) \
+    { \
+      return false; \
+    } \
+    unsigned char * const new_ctrl = (unsigned char *) (new_mem + new_cap); \
+    memset(new_ctrl, HMAP_CTRL_EMPTY, new_cap + HMAP_GROUP_WIDTH); \
+    for (size_t i = 0; i < map->cap; ++i) \
+    { \
+      if (!(map->ctrl[i] & 0x80)) \
+      { \
+        unsigned long const hashcode = hash_expr(map->mem[i].key); \
+        size_t const slot = name##_vacant_slot(new_ctrl, new_cap, hashcode); \
+        new_mem[slot] = map->mem[i]; \
+        hmap_set_ctrl(new_ctrl, new_cap, slot, hmap_tag(hashcode)); \
+      } \
+    } \
+    free(map->mem); \
+    map->mem = new_mem; \
+    map->ctrl = new_ctrl; \
+    map->cap = new_cap; \
+    map->dead = 0; \
+    map->grow_at = (size_t) (new_cap * HMAP_MAX_LOAD); \
+    return true; \
+  } \
+  \
+  static inline \
+  bool name##_ensure_capacity \
+  (name * const map, size_t const n) \
+  { \
+    if (map->grow_at >= n) \
+    { \
+      return true; \
+    } \
+    size_t cap = HMAP_GROUP_WIDTH; \
+    while (cap * HMAP_MAX_LOAD < HMAP_GROW(n)) \
+    { \
+      cap *= 2; \
+    } \
+    return name##_resize(map, cap); \
+  } \
+  \
+  static inline \
+  bool name##_reserve_one \
+  (name * const map) \
+  { \
+    if (map->len + 1 > map->grow_at) \
+    { \
+      return name##_ensure_capacity(map, map->len + 1); \
+    } \
+    if (map->len + map->dead + 1 > map->grow_at) \
+    { \
+      return name##_resize(map, map->cap); \
+    } \
+    return true; \
+  } \
+  \
+  static inline \
+  void name##_place \
+  (name * const map, K const key, V const value, unsigned long const hashcode) \
+  { \
+    size_t const slot = name##_vacant_slot(map->ctrl, map->cap, hashcode); \
+    if (map->ctrl[slot] == HMAP_CTRL_DELETED) \
+    { \
+      --map->dead; \
+    } \
+    map->mem[slot].key = key; \
+    map->mem[slot].value = value; \
+    hmap_set_ctrl(map->ctrl, map->cap, slot, hmap_tag(hashcode)); \
+    ++map->len; \
+  } \
+  \
+  static inline \
+  bool name##_put \
+  (name * const map, K const key, V const value) \
+  { \
+    if (!name##_reserve_one(map)) \
+    { \
+      return false; \
+    } \
+    unsigned long const hashcode = hash_expr(key); \
+    size_t const slot = name##_find_slot(map, key, hashcode); \
+    if (slot == HMAP_NPOS) \
+    { \
+      name##_place(map, key, value, hashcode); \
+    } \
+    else \
+    { \
+      map->mem[slot].value = value; \
+    } \
+    return true; \
+  } \
+  \
+  static inline \
+  bool name##_put_if_absent \
+  (name * const map, K const key, V const value) \
+  { \
+    if (!name##_reserve_one(map)) \
+    { \
+      return false; \
+    } \
+    unsigned long const hashcode = hash_expr(key); \
+    if (name##_find_slot(map, key, hashcode) != HMAP_NPOS) \
+    { \
+      return false; \
+    } \
+    name##_place(map, key, value, hashcode); \
+    return true; \
+  } \
+  \
+  static inline \
+  bool name##_remove \
+  (name * const map, K const key) \
+  { \
+    if (map->len < 1) \
+    { \
+      return false; \
+    } \
+    size_t const slot = name##_find_slot(map, key, hash_expr(key)); \
+    if (slot == HMAP_NPOS) \
+    { \
+      return false; \
+    } \
+    --map->len; \
+    ++map->dead; \
+    hmap_set_ctrl(map->ctrl, map->cap, slot, HMAP_CTRL_DELETED); \
+    return true; \
+  } \
+  \
+  static inline \
+  V * name##_get \
+  (name const * const map, K const key) \
+  { \
+    if (map->len < 1) \
+    { \
+      return NULL; \
+    } \
+    size_t const slot = name##_find_slot(map, key, hash_expr(key)); \
+    return slot == HMAP_NPOS ? NULL : &map->mem[slot].value; \
+  } \
+  \
+  static inline \
+  bool name##_has_key \
+  (name const * const map, K const key) \
+  { \
+    return name##_get(map, key) != NULL; \
+  } \
+  \
+  static inline \
+  void name##_foreach \
+  (name const * const map, void (* it)(K const *, V *)) \
+  { \
+    for (size_t i = 0; i < map->cap; ++i) \
+    { \
+      if (!(map->ctrl[i] & 0x80)) \
+      { \
+        it(&map->mem[i].key, &map->mem[i].value); \
+      } \
+    } \
+  } \
+  \
+  static inline \
+  bool name##_foreach_ctx \
+  (name const * const map, bool (* it)(K const *, V *, void *), void * ctx) \
+  { \
+    for (size_t i = 0; i < map->cap; ++i) \
+    { \
+      if (!(map->ctrl[i] & 0x80) && !it(&map->mem[i].key, &map->mem[i].value, ctx)) \
+      { \
+        return false; \
+      } \
+    } \
+    return true; \
+  } \
+  \
+  static inline \
+  size_t name##_size \
+  (name const * const map) \
+  { \
+    return map->len; \
+  }
+
+#endif
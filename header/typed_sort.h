@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TYPED_SORT_H__
+#define __TYPED_SORT_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Pattern-defeating quicksort: median of three (ninther for large ranges)
+ * pivots, insertion sort for small ranges, a partition that groups elements
+ * equal to the previous pivot, and a check that stops early on ranges that
+ * are already sorted. Ranges that partition badly get some elements swapped
+ * to break the pattern and fall back to heapsort after too many of them, so
+ * the worst case stays O(n log n).
+ *
+ * The stable sort is a merge sort with insertion sorted runs, merging
+ * through a buffer of half the elements and skipping merges of ranges that
+ * are already in order.
+ */
+
+/* ranges smaller than this are insertion sorted */
+#define SORT_INSERTION_LIMIT 24
+
+/* ranges larger than this take the pivot from a ninther */
+#define SORT_NINTHER_LIMIT 128
+
+/* runs insertion sorted by the stable sort */
+#define SORT_STABLE_RUN 32
+
+/**
+ * Defines sort functions for arrays of a type with the comparison inlined,
+ * so no call goes through a function pointer and elements are moved by
+ * assignment.
+ *
+ * To sort arrays of int:
+ *
+ *    #define INT_LESS(a, b) ((a) < (b))
+ *
+ *    SORT_DEFINE(int_sort, int, INT_LESS)
+ *
+ * which defines the following functions, all static inline:
+ *
+ *    void int_sort(int *ptr, size_t count);
+ *    bool int_sort_stable(int *ptr, size_t count);
+ *
+ * The stable one allocates a buffer of count / 2 elements and returns false
+ * if it cannot, leaving the array as it was. An array list of ints is sorted
+ * with int_sort(arrlist_data(&list), arrlist_size(&list)).
+ *
+ * @param name - The name of the sort function, also used to prefix the others
+ * @param T - The element type
+ * @param less_expr - Function or function-like macro taking two elements
+ *                    (always lvalues) and returning true if the first one
+ *                    goes before the second one
+ */
+#define SORT_DEFINE(name, T, less_expr) \
+  SORT_DEFINE_CTX(name##_with_, T, int, less_expr) \
+  \
+  static inline \
+  void name \
+  (T * const ptr, size_t const count) \
+  { \
+    name##_with_(ptr, count, 0); \
+  } \
+  \
+  static inline \
+  bool name##_stable \
+  (T * const ptr, size_t const count) \
+  { \
+    return name##_with__stable(ptr, count, 0); \
+  }
+
+/**
+ * Same as SORT_DEFINE except every function takes a context of type C as
+ * its last parameter, which less_expr sees as ctx. For example, to sort
+ * indices by the values they point to:
+ *
+ *    #define BY_VALUE(a, b) (ctx[a] < ctx[b])
+ *
+ *    SORT_DEFINE_CTX(index_sort, size_t, const double *, BY_VALUE)
+ *
+ * defines:
+ *
+ *    void index_sort(size_t *ptr, size_t count, const double *ctx);
+ *    bool index_sort_stable(size_t *ptr, size_t count, const double *ctx);
+ *
+ * @param name - The name of the sort function, also used to prefix the others
+ * @param T - The element type
+ * @param C - The context type
+ * @param less_expr - Same as SORT_DEFINE, may use ctx
+ */
+#define SORT_DEFINE_CTX(name, T, C, less_expr) \
+  static inline \
+  void name##_insertion_ \
+  (T * const begin, T * const end, C const ctx) \
+  { \
+    (void) ctx; \
+    if (begin == end) return; \
+    for (T * cur = begin + 1; cur != end; ++cur) \
+    { \
+      T * sift = cur; \
+      T * sift_1 = cur - 1; \
+      if (less_expr(*sift, *sift_1)) \
+      { \
+        T tmp = *sift; \
+        do \
+        { \
+          *sift-- = *sift_1; \
+        } \
+        while (sift != begin && less_expr(tmp, *--sift_1)); \
+        *sift = tmp; \
+      } \
+    } \
+  } \
+  \
+  /* the element before begin must not go after any element of the range */ \
+  static inline \
+  void name##_unguarded_insertion_ \
+  (T * const begin, T * const end, C const ctx) \
+  { \
+    (void) ctx; \
+    if (begin == end) return; \
+    for (T * cur = begin + 1; cur != end; ++cur) \
+    { \
+      T * sift = cur; \
+      T * sift_1 = cur - 1; \
+      if (less_expr(*sift, *sift_1)) \
+      { \
+        T tmp = *sift; \
+        do \
+        { \
+          *sift-- = *sift_1; \
+        } \
+        while (less_expr(tmp, *--sift_1)); \
+        *sift = tmp; \
+      } \
+    } \
+  } \
+  \
+  /* gives up once it has moved elements too far */ \
+  static inline \
+  bool name##_partial_insertion_ \
+  (T * const begin, T * const end, C const ctx) \
+  { \
+    (void) ctx; \
+    if (begin == end) return true; \
+    size_t moved = 0; \
+    for (T * cur = begin + 1; cur != end; ++cur) \
+    { \
+      T * sift = cur; \
+      T * sift_1 = cur - 1; \
+      if (less_expr(*sift, *sift_1)) \
+      { \
+        T tmp = *sift; \
+        do \
+        { \
+          *sift-- = *sift_1; \
+        } \
+        while (sift != begin && less_expr(tmp, *--sift_1)); \
+        *sift = tmp; \
+        moved += (size_t) (cur - sift); \
+      } \
+      if (moved > 8) return false; \
+    } \
+    return true; \
+  } \
+  \
+  static inline \
+  void name##_sort2_ \
+  (T * const a, T * const b, C const ctx) \
+  { \
+    (void) ctx; \
+    if (less_expr(*b, *a)) \
+    { \
+      T tmp = *a; \
+      *a = *b; \
+      *b = tmp; \
+    } \
+  } \
+  \
+  static inline \
+  void name##_sort3_ \
+  (T * const a, T * const b, T * const c, C const ctx) \
+  { \
+    name##_sort2_(a, b, ctx); \
+    name##_sort2_(b, c, ctx); \
+    name##_sort2_(a, b, ctx); \
+  } \
+  \
+  static inline \
+  void name##_swap_ \
+  (T * const a, T * const b) \
+  { \
+    T tmp = *a; \
+    *a = *b; \
+    *b = tmp; \
+  } \
+  \
+  static inline \
+  void name##_sift_down_ \
+  (T * const ptr, size_t i, size_t const count, C const ctx) \
+  { \
+    (void) ctx; \
+    T tmp = ptr[i]; \
+    for (size_t child; (child = 2 * i + 1) < count; i = child) \
+    { \
+      if (child + 1 < count && less_expr(ptr[child], ptr[child + 1])) ++child; \
+      if (!less_expr(tmp, ptr[child])) break; \
+      ptr[i] = ptr[child]; \
+    } \
+    ptr[i] = tmp; \
+  } \
+  \
+  static inline \
+  void name##_heapsort_ \
+  (T * const ptr, size_t const count, C const ctx) \
+  { \
+    for (size_t i = count / 2; i > 0; --i) \
+    { \
+      name##_sift_down_(ptr, i - 1, count, ctx); \
+    } \
+    for (size_t i = count; i > 1; --i) \
+    { \
+      name##_swap_(&ptr[0], &ptr[i - 1]); \
+      name##_sift_down_(ptr, 0, i - 1, ctx); \
+    } \
+  } \
+  \
+  /* \
+   * Partitions around *begin into [less than pivot] pivot [the rest] and \
+   * tells if no element had to be swapped. \
+   */ \
+  static inline \
+  T * name##_partition_right_ \
+  (T * const begin, T * const end, bool * const already_partitioned, C const ctx) \
+  { \
+    (void) ctx; \
+    T const pivot = *begin; \
+    T * first = begin; \
+    T * last = end; \
+    while (less_expr(*++first, pivot)); \
+    if (first - 1 == begin) \
+    { \
+      while (first < last && !less_expr(*--last, pivot)); \
+    } \
+    else \
+    { \
+      while (!less_expr(*--last, pivot)); \
+    } \
+    *already_partitioned = first >= last; \
+    while (first < last) \
+    { \
+      name##_swap_(first, last); \
+      while (less_expr(*++first, pivot)); \
+      while (!less_expr(*--last, pivot)); \
+    } \
+    T * const pivot_pos = first - 1; \
+    *begin = *pivot_pos; \
+    *pivot_pos = pivot; \
+    return pivot_pos; \
+  } \
+  \
+  /* \
+   * Partitions around *begin into [equal to pivot] pivot [greater than \
+   * pivot], used when no element can be less than the pivot. \
+   */ \
+  static inline \
+  T * name##_partition_left_ \
+  (T * const begin, T * const end, C const ctx) \
+  { \
+    (void) ctx; \
+    T const pivot = *begin; \
+    T * first = begin; \
+    T * last = end; \
+    while (less_expr(pivot, *--last)); \
+    if (last + 1 == end) \
+    { \
+      while (first < last && !less_expr(pivot, *++first)); \
+    } \
+    else \
+    { \
+      while (!less_expr(pivot, *++first)); \
+    } \
+    while (first < last) \
+    { \
+      name##_swap_(first, last); \
+      while (less_expr(pivot, *--last)); \
+      while (!less_expr(pivot, *++first)); \
+    } \
+    T * const pivot_pos = last; \
+    *begin = *pivot_pos; \
+    *pivot_pos = pivot; \
+    return pivot_pos; \
+  } \
+  \
+  static \
+  void name##_loop_ \
+  (T * begin, T * end, int bad_allowed, bool leftmost, C const ctx) \
+  { \
+    while (true) \
+    { \
+      size_t const size = (size_t) (end - begin); \
+      if (size < SORT_INSERTION_LIMIT) \
+      { \
+        if (leftmost) name##_insertion_(begin, end, ctx); \
+        else name##_unguarded_insertion_(begin, end, ctx); \
+        return; \
+      } \
+      \
+      /* the pivot ends up in *begin */ \
+      size_t const half = size / 2; \
+      if (size > SORT_NINTHER_LIMIT) \
+      { \
+        name##_sort3_(begin, begin + half, end - 1, ctx); \
+        name##_sort3_(begin + 1, begin + (half - 1), end - 2, ctx); \
+        name##_sort3_(begin + 2, begin + (half + 1), end - 3, ctx); \
+        name##_sort3_(begin + (half - 1), begin + half, begin + (half + 1), ctx); \
+        name##_swap_(begin, begin + half); \
+      } \
+      else \
+      { \
+        name##_sort3_(begin + half, begin, end - 1, ctx); \
+      } \
+      \
+      /* equal to the previous pivot, so nothing goes to its left */ \
+      if (!leftmost && !less_expr(*(begin - 1), *begin)) \
+      { \
+        begin = name##_partition_left_(begin, end, ctx) + 1; \
+        continue; \
+      } \
+      \
+      bool already_partitioned; \
+      T * const pivot_pos = name##_partition_right_(begin, end, &already_partitioned, ctx); \
+      size_t const l_size = (size_t) (pivot_pos - begin); \
+      size_t const r_size = (size_t) (end - (pivot_pos + 1)); \
+      \
+      if (l_size < size / 8 || r_size < size / 8) \
+      { \
+        if (--bad_allowed == 0) \
+        { \
+          name##_heapsort_(begin, size, ctx); \
+          return; \
+        } \
+        \
+        /* shuffle some elements around to break the pattern */ \
+        if (l_size >= SORT_INSERTION_LIMIT) \
+        { \
+          name##_swap_(begin, begin + l_size / 4); \
+          name##_swap_(pivot_pos - 1, pivot_pos - l_size / 4); \
+          if (l_size > SORT_NINTHER_LIMIT) \
+          { \
+            name##_swap_(begin + 1, begin + (l_size / 4 + 1)); \
+            name##_swap_(begin + 2, begin + (l_size / 4 + 2)); \
+            name##_swap_(pivot_pos - 2, pivot_pos - (l_size / 4 + 1)); \
+            name##_swap_(pivot_pos - 3, pivot_pos - (l_size / 4 + 2)); \
+          } \
+        } \
+        if (r_size >= SORT_INSERTION_LIMIT) \
+        { \
+          name##_swap_(pivot_pos + 1, pivot_pos + (1 + r_size / 4)); \
+          name##_swap_(end - 1, end - r_size / 4); \
+          if (r_size > SORT_NINTHER_LIMIT) \
+          { \
+            name##_swap_(pivot_pos + 2, pivot_pos + (2 + r_size / 4)); \
+            name##_swap_(pivot_pos + 3, pivot_pos + (3 + r_size / 4)); \
+            name##_swap_(end - 2, end - (1 + r_size / 4)); \
+            name##_swap_(end - 3, end - (2 + r_size / 4)); \
+          } \
+        } \
+      } \
+      else if (already_partitioned \
+        && name##_partial_insertion_(begin, pivot_pos, ctx) \
+        && name##_partial_insertion_(pivot_pos + 1, end, ctx)) \
+      { \
+        /* probably sorted already */ \
+        return; \
+      } \
+      \
+      /* recurse into the smaller side to bound the stack */ \
+      if (l_size < r_size) \
+      { \
+        name##_loop_(begin, pivot_pos, bad_allowed, leftmost, ctx); \
+        begin = pivot_pos + 1; \
+        leftmost = false; \
+      } \
+      else \
+      { \
+        name##_loop_(pivot_pos + 1, end, bad_allowed, false, ctx); \
+        end = pivot_pos; \
+      } \
+    } \
+  } \
+  \
+  static inline \
+  void name \
+  (T * const ptr, size_t const count, C const ctx) \
+  { \
+    int bad_allowed = 1; \
+    for (size_t n = count; n > 1; n /= 2) ++bad_allowed; \
+    if (count > 1) name##_loop_(ptr, ptr + count, bad_allowed, true, ctx); \
+  } \
+  \
+  static \
+  void name##_merge_ \
+  (T * const ptr, size_t const count, T * const buf, C const ctx) \
+  { \
+    (void) ctx; \
+    if (count <= SORT_STABLE_RUN) \
+    { \
+      name##_insertion_(ptr, ptr + count, ctx); \
+      return; \
+    } \
+    \
+    size_t const mid = count / 2; \
+    name##_merge_(ptr, mid, buf, ctx); \
+    name##_merge_(ptr + mid, count - mid, buf, ctx); \
+    if (!less_expr(ptr[mid], ptr[mid - 1])) \
+    { \
+      /* both halves are already in order */ \
+      return; \
+    } \
+    \
+    memcpy(buf, ptr, mid * sizeof(T)); \
+    T * left = buf; \
+    T * const left_end = buf + mid; \
+    T * right = ptr + mid; \
+    T * const right_end = ptr + count; \
+    T * out = ptr; \
+    while (left < left_end && right < right_end) \
+    { \
+      /* ties take the left element to stay stable */ \
+      if (less_expr(*right, *left)) *out++ = *right++; \
+      else *out++ = *left++; \
+    } \
+    while (left < left_end) *out++ = *left++; \
+  } \
+  \
+  static inline \
+  bool name##_stable \
+  (T * const ptr, size_t const count, C const ctx) \
+  { \
+    if (count <= SORT_STABLE_RUN) \
+    { \
+      name##_insertion_(ptr, ptr + count, ctx); \
+      return true; \
+    } \
+    T * const buf = malloc(count / 2 * sizeof(T)); \
+    if (buf == NULL) return false; \
+    name##_merge_(ptr, count, buf, ctx); \
+    free(buf); \
+    return true; \
+  }
+
+#endif
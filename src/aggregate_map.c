@@ -0,0 +1,602 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aggregate_map.h"
+#include "hash.h"
+#include "hmap_group.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The map is a chain of tables, each twice as big as the one before. Updates
+ * only probe the last table, so their cost does not depend on how often the
+ * chain grew. Keys of older tables are inserted again when they are next
+ * updated, and every update also helps move a chunk of the oldest table not
+ * moved yet into the last one: it swaps each value for the identity of the
+ * operation and combines what it took into the last table. A value combined
+ * into an older table by an update that started before the chain grew stays
+ * there, which is fine since lookups and drains combine every table.
+ *
+ * Buckets are probed linearly. A bucket's tag is EMPTY until a writer swaps
+ * in BUSY, copies the key and publishes the full tag: the hashcode with the
+ * low bits replaced by FULL. Other writers skip BUSY buckets instead of
+ * waiting, which is how the same key can end up twice.
+ */
+
+#define EMPTY 0
+#define BUSY  1
+#define FULL  2
+
+#define MIN_CAP 16
+
+/* buckets of an older table moved by each update */
+#define MIGRATE_CHUNK 16
+
+typedef struct agmap_slot
+{
+  _Atomic(uint64_t) tag;
+  _Atomic(int64_t) value;
+  unsigned char key[];
+} agmap_slot;
+
+typedef struct agmap_table
+{
+  size_t cap;
+  size_t limit; /* buckets claimed before the next table is added */
+  atomic_size_t used;
+  atomic_size_t moved; /* buckets claimed by updates moving them */
+  _Atomic(struct agmap_table *) next;
+  unsigned char mem[];
+} agmap_table;
+
+struct aggregate_map
+{
+  size_t key_size;
+  size_t stride; /* bytes per bucket */
+  agmap_op op;
+  hash_func *hasher;
+  agmap_table *head;
+  _Atomic(agmap_table *) last; /* takes the updates, might lag behind */
+  _Atomic(agmap_table *) moving; /* oldest table not moved yet */
+};
+
+typedef enum probe_result
+{
+  UPDATED,
+  MISSING,
+  TABLE_FULL
+} probe_result;
+
+static inline
+size_t align8
+(size_t n)
+{
+  return (n + 7) & ~(size_t) 7;
+}
+
+static inline
+agmap_slot *slot_at
+(aggregate_map const * const map, agmap_table const * const table, size_t const i)
+{
+  return (agmap_slot *) (table->mem + i * map->stride);
+}
+
+static inline
+uint64_t full_tag
+(unsigned long const hashcode)
+{
+  return ((uint64_t) hashcode & ~(uint64_t) 3) | FULL;
+}
+
+static
+agmap_table *alloc_table
+(aggregate_map const * const map, size_t const cap)
+{
+  agmap_table *table = malloc(sizeof(agmap_table) + cap * map->stride);
+  if (table == NULL)
+  {
+    return NULL;
+  }
+
+  table->cap = cap;
+  table->limit = cap / 4 * 3;
+  atomic_init(&table->used, 0);
+  atomic_init(&table->moved, 0);
+  atomic_init(&table->next, NULL);
+  for (size_t i = 0; i < cap; ++i)
+  {
+    atomic_init(&slot_at(map, table, i)->tag, EMPTY);
+  }
+  return table;
+}
+
+static
+void free_tables
+(agmap_table * table)
+{
+  while (table != NULL)
+  {
+    agmap_table * const next = atomic_load_explicit(&table->next, memory_order_relaxed);
+    free(table);
+    table = next;
+  }
+}
+
+static inline
+int64_t combine
+(agmap_op const op, int64_t const a, int64_t const b)
+{
+  switch (op)
+  {
+    case AGMAP_MAX:
+      return a > b ? a : b;
+    case AGMAP_MIN:
+      return a < b ? a : b;
+    default:
+      return (int64_t) ((uint64_t) a + (uint64_t) b);
+  }
+}
+
+/**
+ * @return the value that combining with changes nothing
+ */
+static inline
+int64_t identity
+(agmap_op const op)
+{
+  switch (op)
+  {
+    case AGMAP_MAX:
+      return INT64_MIN;
+    case AGMAP_MIN:
+      return INT64_MAX;
+    default:
+      return 0;
+  }
+}
+
+static
+void combine_into
+(agmap_op const op, _Atomic(int64_t) * const dst, int64_t const value)
+{
+  if (op == AGMAP_SUM)
+  {
+    atomic_fetch_add_explicit(dst, value, memory_order_relaxed);
+    return;
+  }
+
+  int64_t old = atomic_load_explicit(dst, memory_order_relaxed);
+  while (combine(op, old, value) != old
+    && !atomic_compare_exchange_weak_explicit(dst, &old, value,
+                                              memory_order_relaxed, memory_order_relaxed))
+  {
+    /* old was reloaded, try again unless it already wins */
+  }
+}
+
+/**
+ * Combines the value into the first bucket of the table holding the key.
+ * If there is none and may_insert is set, claims a bucket for the key.
+ */
+static
+probe_result update_table
+(aggregate_map * const map, agmap_table * const table, void const * const key,
+ unsigned long const hashcode, int64_t const value, bool const may_insert)
+{
+  size_t const cap = table->cap;
+  uint64_t const tag = full_tag(hashcode);
+  size_t slot = hmap_home(hashcode, cap);
+
+  for (size_t k = 0; k < cap; ++k, slot = (slot + 1) & (cap - 1))
+  {
+    agmap_slot * const bucket = slot_at(map, table, slot);
+    uint64_t seen = atomic_load_explicit(&bucket->tag, memory_order_acquire);
+    if (seen == EMPTY)
+    {
+      if (!may_insert)
+      {
+        return MISSING;
+      }
+      if (atomic_compare_exchange_strong_explicit(&bucket->tag, &seen, BUSY,
+                                                  memory_order_acquire, memory_order_acquire))
+      {
+        atomic_fetch_add_explicit(&table->used, 1, memory_order_relaxed);
+        memcpy(bucket->key, key, map->key_size);
+        atomic_store_explicit(&bucket->value, value, memory_order_relaxed);
+        atomic_store_explicit(&bucket->tag, tag, memory_order_release);
+        return UPDATED;
+      }
+      /* lost the bucket, seen now holds what the winner stored */
+    }
+
+    if (seen == tag && memcmp(bucket->key, key, map->key_size) == 0)
+    {
+      combine_into(map->op, &bucket->value, value);
+      return UPDATED;
+    }
+  }
+  return TABLE_FULL;
+}
+
+/**
+ * Chains a table twice as big after the given one unless another thread
+ * did so first.
+ */
+static
+agmap_table *grow_chain
+(aggregate_map const * const map, agmap_table * const table)
+{
+  agmap_table * next = alloc_table(map, table->cap * 2);
+  if (next == NULL)
+  {
+    return NULL;
+  }
+
+  agmap_table * expected = NULL;
+  if (!atomic_compare_exchange_strong_explicit(&table->next, &expected, next,
+                                               memory_order_acq_rel, memory_order_acquire))
+  {
+    free(next);
+    next = expected;
+  }
+  return next;
+}
+
+static inline
+unsigned long hash_key
+(aggregate_map const * const map, void const * const key)
+{
+  return map->hasher != NULL ? map->hasher(key) : (unsigned long) hash_bytes(key, map->key_size);
+}
+
+aggregate_map *new_agmap
+(size_t const key_size, agmap_op const op, hash_func * hasher, size_t const capacity)
+{
+  if (key_size == 0)
+  {
+    return NULL;
+  }
+
+  aggregate_map * map = malloc(sizeof(aggregate_map));
+  if (map == NULL)
+  {
+    return NULL;
+  }
+
+  map->key_size = key_size;
+  map->stride = sizeof(agmap_slot) + align8(key_size);
+  map->op = op;
+  map->hasher = hasher;
+
+  size_t cap = MIN_CAP;
+  while (cap / 4 * 3 < capacity)
+  {
+    cap *= 2;
+  }
+
+  map->head = alloc_table(map, cap);
+  if (map->head == NULL)
+  {
+    free(map);
+    return NULL;
+  }
+  atomic_init(&map->last, map->head);
+  atomic_init(&map->moving, map->head);
+  return map;
+}
+
+void delete_agmap
+(aggregate_map * const map)
+{
+  if (map != NULL)
+  {
+    free_tables(map->head);
+    free(map);
+  }
+}
+
+/**
+ * Combines the value into the last table, growing the chain if it is full.
+ */
+static
+bool update_last
+(aggregate_map * const map, void const * const key, unsigned long const hashcode,
+ int64_t const value)
+{
+  agmap_table * table = atomic_load_explicit(&map->last, memory_order_acquire);
+  while (true)
+  {
+    agmap_table * const next = atomic_load_explicit(&table->next, memory_order_acquire);
+    if (next != NULL)
+    {
+      /* the key goes to the newer table even if this one has it */
+      table = next;
+      continue;
+    }
+
+    bool const may_insert = atomic_load_explicit(&table->used, memory_order_relaxed) < table->limit;
+    if (update_table(map, table, key, hashcode, value, may_insert) == UPDATED)
+    {
+      return true;
+    }
+
+    agmap_table * const grown = grow_chain(map, table);
+    if (grown == NULL)
+    {
+      return false;
+    }
+
+    /* fails if another thread already moved it past table */
+    atomic_compare_exchange_strong_explicit(&map->last, &table, grown,
+                                            memory_order_acq_rel, memory_order_acquire);
+    table = grown;
+  }
+}
+
+/**
+ * Moves a chunk of the oldest table not moved yet into the last table.
+ * Buckets still being claimed are skipped, their values stay where they
+ * are.
+ */
+static
+void help_move
+(aggregate_map * const map)
+{
+  agmap_table * table = atomic_load_explicit(&map->moving, memory_order_acquire);
+  agmap_table * const next = atomic_load_explicit(&table->next, memory_order_acquire);
+  if (next == NULL)
+  {
+    /* the oldest table left is the last one */
+    return;
+  }
+
+  size_t const start = atomic_fetch_add_explicit(&table->moved, MIGRATE_CHUNK, memory_order_relaxed);
+  size_t const end = start < table->cap && table->cap - start > MIGRATE_CHUNK
+    ? start + MIGRATE_CHUNK : table->cap;
+  int64_t const none = identity(map->op);
+  for (size_t i = start; i < end; ++i)
+  {
+    agmap_slot * const bucket = slot_at(map, table, i);
+    if ((atomic_load_explicit(&bucket->tag, memory_order_acquire) & 3) != FULL)
+    {
+      continue;
+    }
+
+    int64_t const value = atomic_exchange_explicit(&bucket->value, none, memory_order_relaxed);
+    if (value != none && !update_last(map, bucket->key, hash_key(map, bucket->key), value))
+    {
+      /* out of memory, leave the value where lookups still find it */
+      combine_into(map->op, &bucket->value, value);
+    }
+  }
+
+  if (end == table->cap)
+  {
+    atomic_compare_exchange_strong_explicit(&map->moving, &table, next,
+                                            memory_order_acq_rel, memory_order_acquire);
+  }
+}
+
+bool agmap_update
+(aggregate_map * restrict const map, void const * restrict key, int64_t const value)
+{
+  if (!update_last(map, key, hash_key(map, key), value))
+  {
+    return false;
+  }
+  help_move(map);
+  return true;
+}
+
+/**
+ * Counts the used buckets of every table. Keys spread over several tables
+ * are counted once per table, so this bounds the number of distinct keys.
+ */
+static
+size_t used_buckets
+(aggregate_map const * const map)
+{
+  size_t used = 0;
+  for (agmap_table * table = map->head; table != NULL; table = table->next)
+  {
+    used += table->used;
+  }
+  return used;
+}
+
+/**
+ * Combines the values of every bucket of the table holding the key.
+ */
+static
+bool get_table
+(aggregate_map const * const map, agmap_table const * const table, void const * const key,
+ unsigned long const hashcode, bool found, int64_t * const out)
+{
+  size_t const cap = table->cap;
+  uint64_t const tag = full_tag(hashcode);
+  size_t slot = hmap_home(hashcode, cap);
+
+  for (size_t k = 0; k < cap; ++k, slot = (slot + 1) & (cap - 1))
+  {
+    agmap_slot * const bucket = slot_at(map, table, slot);
+    uint64_t const seen = atomic_load_explicit(&bucket->tag, memory_order_acquire);
+    if (seen == EMPTY)
+    {
+      break;
+    }
+    if (seen == tag && memcmp(bucket->key, key, map->key_size) == 0)
+    {
+      int64_t const value = atomic_load_explicit(&bucket->value, memory_order_relaxed);
+      *out = found ? combine(map->op, *out, value) : value;
+      found = true;
+    }
+  }
+  return found;
+}
+
+bool agmap_get
+(aggregate_map const * restrict const map, void const * restrict key, int64_t * restrict out)
+{
+  unsigned long const hashcode = hash_key(map, key);
+  bool found = false;
+  int64_t value = 0;
+  for (agmap_table const * table = map->head; table != NULL;
+       table = atomic_load_explicit(&table->next, memory_order_acquire))
+  {
+    found = get_table(map, table, key, hashcode, found, &value);
+  }
+
+  if (found)
+  {
+    *out = value;
+  }
+  return found;
+}
+
+size_t agmap_record_size
+(aggregate_map const * const map)
+{
+  return align8(map->key_size) + sizeof(int64_t);
+}
+
+size_t agmap_value_offset
+(aggregate_map const * const map)
+{
+  return align8(map->key_size);
+}
+
+bool agmap_drain
+(aggregate_map * restrict const map, array_list * restrict out)
+{
+  size_t const record_size = agmap_record_size(map);
+  if (out->blk != record_size)
+  {
+    return false;
+  }
+
+  size_t const used = used_buckets(map);
+
+  /* merge every table into one big enough to never grow */
+  size_t cap = MIN_CAP;
+  while (cap / 4 * 3 < used)
+  {
+    cap *= 2;
+  }
+  agmap_table * const merged = alloc_table(map, cap);
+  unsigned char * const record = calloc(1, record_size);
+  if (merged == NULL || record == NULL)
+  {
+    free(merged);
+    free(record);
+    return false;
+  }
+
+  for (agmap_table * table = map->head; table != NULL; table = table->next)
+  {
+    for (size_t i = 0; i < table->cap; ++i)
+    {
+      agmap_slot * const bucket = slot_at(map, table, i);
+      uint64_t const tag = bucket->tag;
+      if (tag != EMPTY)
+      {
+        update_table(map, merged, bucket->key, tag, bucket->value, true);
+      }
+    }
+  }
+
+  if (!arrlist_ensure_capacity(out, out->len + merged->used))
+  {
+    free(merged);
+    free(record);
+    return false;
+  }
+
+  for (size_t i = 0; i < merged->cap; ++i)
+  {
+    agmap_slot * const bucket = slot_at(map, merged, i);
+    if (bucket->tag != EMPTY)
+    {
+      int64_t const value = bucket->value;
+      memcpy(record, bucket->key, map->key_size);
+      memcpy(record + align8(map->key_size), &value, sizeof(int64_t));
+      arrlist_add(out, record);
+    }
+  }
+  free(merged);
+  free(record);
+
+  /* keep the first table so the map stays usable */
+  agmap_table * const head = map->head;
+  free_tables(head->next);
+  head->next = NULL;
+  head->used = 0;
+  head->moved = 0;
+  map->last = head;
+  map->moving = head;
+  for (size_t i = 0; i < head->cap; ++i)
+  {
+    slot_at(map, head, i)->tag = EMPTY;
+  }
+  return true;
+}
+
+typedef struct record_range
+{
+  uintptr_t begin;
+  uintptr_t end;
+} record_range;
+
+static
+bool outside_range
+(void const * pair, void * ctx)
+{
+  record_range const * range = ctx;
+  uintptr_t const addr = (uintptr_t) pair;
+  return addr < range->begin || addr >= range->end;
+}
+
+bool agmap_drain_hmap
+(aggregate_map * restrict const map, array_list * restrict records, hash_map * restrict out)
+{
+  /* appending may move the records, which would leave out pointing at freed memory */
+  size_t const start = records->len;
+  if (start > 0 && hmap_size(out) > 0)
+  {
+    uintptr_t const begin = (uintptr_t) arrlist_get(records, 0);
+    record_range const range = { begin, begin + start * records->blk };
+    if (!hmap_foreach_ctx(out, &outside_range, (void *) &range))
+    {
+      return false;
+    }
+  }
+
+  /* size out first, so nothing can fail once the map has been emptied */
+  if (!hmap_ensure_capacity(out, hmap_size(out) + used_buckets(map)) || !agmap_drain(map, records))
+  {
+    return false;
+  }
+
+  for (size_t i = start; i < records->len; ++i)
+  {
+    if (!hmap_put(out, arrlist_get(records, i), NULL))
+    {
+      return false;
+    }
+  }
+  return true;
+}
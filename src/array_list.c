@@ -15,10 +15,60 @@
  */
 
 #include "array_list.h"
+#include "heap.h"
+#include "huge_alloc.h"
+#include "typed_sort.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+typedef int (elem_cmp)(const void *, const void *);
+
+/*
+ * Elements of the sizes that are sorted directly. They only hold bytes, so
+ * they can stand for elements of any type and alignment.
+ */
+typedef struct elem1 { unsigned char b[1]; } elem1;
+typedef struct elem2 { unsigned char b[2]; } elem2;
+typedef struct elem4 { unsigned char b[4]; } elem4;
+typedef struct elem8 { unsigned char b[8]; } elem8;
+typedef struct elem16 { unsigned char b[16]; } elem16;
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(addr) __builtin_prefetch((addr))
+#else
+#define PREFETCH(addr) ((void) (addr))
+#endif
+
+/* the size of the block fetched by one prefetch */
+#define CACHE_LINE 64
+
+#define ELEM_LESS(a, b) (ctx(&(a), &(b)) < 0)
+#define PTR_LESS(a, b) (ctx((a), (b)) < 0)
+
+SORT_DEFINE_CTX(sort_elem1, elem1, elem_cmp *, ELEM_LESS)
+SORT_DEFINE_CTX(sort_elem2, elem2, elem_cmp *, ELEM_LESS)
+SORT_DEFINE_CTX(sort_elem4, elem4, elem_cmp *, ELEM_LESS)
+SORT_DEFINE_CTX(sort_elem8, elem8, elem_cmp *, ELEM_LESS)
+SORT_DEFINE_CTX(sort_elem16, elem16, elem_cmp *, ELEM_LESS)
+SORT_DEFINE_CTX(sort_ptr, char *, elem_cmp *, PTR_LESS)
+
+static inline
+bool is_inline
+(const array_list *list)
+{
+  /* heap capacities are always past what fits inline */
+  return list->cap * list->blk <= ARRLIST_INLINE;
+}
+
+static inline
+char *items_of
+(const array_list *list)
+{
+  return is_inline(list) ? (char *) list->mem.local : list->mem.heap;
+}
+
 bool init_arrlist
 (array_list *list, size_t data_size)
 {
@@ -28,23 +78,22 @@ bool init_arrlist
   }
 
   list->len = 0;
-  list->cap = 0;
+  list->cap = ARRLIST_INLINE / data_size;
   list->blk = data_size;
-  list->mem = NULL;
+  list->growth = growth_default();
   return true;
 }
 
 void free_arrlist
 (array_list *list)
 {
-  if (list->cap > 0)
+  if (!is_inline(list))
   {
-    free(list->mem);
-
-    list->len = 0;
-    list->cap = 0;
-    list->mem = NULL;
+    huge_free(list->mem.heap, list->cap * list->blk);
   }
+
+  list->len = 0;
+  list->cap = ARRLIST_INLINE / list->blk;
 }
 
 void *cpy_free_arrlist
@@ -58,11 +107,27 @@ void *cpy_free_arrlist
     return ptr;
   }
 
-  /* return the internal buffer directly */
-  void *ptr = list->mem;
+  if (is_inline(list))
+  {
+    /* the items live in the list, so they must be copied out */
+    void *ptr = malloc(list->len * list->blk);
+    if (ptr != NULL)
+    {
+      memcpy(ptr, list->mem.local, list->len * list->blk);
+      free_arrlist(list);
+    }
+    return ptr;
+  }
+
+  /* return the internal buffer directly, unless it was mapped */
+  void *ptr = huge_to_malloc(list->mem.heap, list->cap * list->blk);
+  if (ptr == NULL)
+  {
+    return NULL;
+  }
+
   list->len = 0;
-  list->cap = 0;
-  list->mem = NULL;
+  list->cap = ARRLIST_INLINE / list->blk;
   return ptr;
 }
 
@@ -76,25 +141,28 @@ void arrlist_compact
 (array_list *list)
 {
   size_t len = list->len;
-  if (list->cap == len)
+  if (list->cap == len || is_inline(list))
   {
-    /* already compact */
+    /* already compact, or nothing to release */
     return;
   }
 
-  if (len == 0)
+  if (len * list->blk <= ARRLIST_INLINE)
   {
-    /* equivalent operation as free_arrlist */
-    free_arrlist(list);
+    /* move the items back into the list */
+    char *old_mem = list->mem.heap;
+    memcpy(list->mem.local, old_mem, len * list->blk);
+    huge_free(old_mem, list->cap * list->blk);
+    list->cap = ARRLIST_INLINE / list->blk;
     return;
   }
 
-  char *new_mem = realloc(list->mem, len * list->blk);
+  char *new_mem = huge_realloc(list->mem.heap, list->cap * list->blk, len * list->blk);
   if (new_mem != NULL)
   {
     /* update cap if memory is resized */
     list->cap = len;
-    list->mem = new_mem;
+    list->mem.heap = new_mem;
   }
 
   /* if realloc failed, original memory is still usable */
@@ -109,15 +177,47 @@ bool arrlist_ensure_capacity
   }
 
   /* resize list to at least n */
-  size_t new_cap = ARRLIST_GROW(n);
-  char *new_mem = realloc(list->mem, new_cap * list->blk);
+  size_t new_cap = growth_next(&list->growth, list->cap, n);
+  char *new_mem;
+  if (is_inline(list))
+  {
+    /* first time on the heap, the inline items are copied over */
+    new_mem = huge_alloc(new_cap * list->blk);
+    if (new_mem != NULL)
+    {
+      memcpy(new_mem, list->mem.local, list->len * list->blk);
+    }
+  }
+  else
+  {
+    new_mem = huge_realloc(list->mem.heap, list->cap * list->blk, new_cap * list->blk);
+  }
+
   if (new_mem == NULL)
   {
     return false;
   }
 
   list->cap = new_cap;
-  list->mem = new_mem;
+  list->mem.heap = new_mem;
+  return true;
+}
+
+bool arrlist_set_growth
+(array_list *restrict list, const growth_policy *restrict policy)
+{
+  growth_policy const fallback = growth_default();
+  if (policy == NULL)
+  {
+    policy = &fallback;
+  }
+
+  if (!growth_valid(policy))
+  {
+    return false;
+  }
+
+  list->growth = *policy;
   return true;
 }
 
@@ -127,19 +227,364 @@ void arrlist_reverse
   size_t const len = list->len;
   size_t const midpoint = len / 2;
   size_t const blk = list->blk;
+  char *const mem = items_of(list);
 
   char temp_buf[blk];
   for (size_t i = 0; i < midpoint; ++i)
   {
     /* swap [i] with [len - i - 1] */
-    char *const near = list->mem + i * blk;
-    char *const far = list->mem + (len - i - 1) * blk;
+    char *const near = mem + i * blk;
+    char *const far = mem + (len - i - 1) * blk;
     memcpy(temp_buf, near, blk);
     memmove(near, far, blk);
     memcpy(far, temp_buf, blk);
   }
 }
 
+/**
+ * Moves every element to its place once its pointer was sorted, following
+ * each cycle of the permutation with a single element on the side.
+ */
+static
+void apply_order
+(char *restrict mem, char **restrict order, size_t count, size_t blk, char *restrict tmp)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (order[i] == mem + i * blk)
+    {
+      continue;
+    }
+
+    memcpy(tmp, mem + i * blk, blk);
+    size_t j = i;
+    while (true)
+    {
+      size_t const k = (size_t) (order[j] - mem) / blk;
+      order[j] = mem + j * blk;
+      if (k == i)
+      {
+        memcpy(mem + j * blk, tmp, blk);
+        break;
+      }
+
+      memcpy(mem + j * blk, mem + k * blk, blk);
+      j = k;
+    }
+  }
+}
+
+/**
+ * Sorts big or oddly sized elements through an array of pointers
+ *
+ * @return false if the pointers could not be allocated
+ */
+static
+bool sort_by_pointer
+(array_list *list, elem_cmp *cmp, bool stable)
+{
+  size_t const len = list->len;
+  size_t const blk = list->blk;
+  char *const mem = items_of(list);
+  char **order = malloc(len * sizeof(char *) + blk);
+  if (order == NULL)
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < len; ++i)
+  {
+    order[i] = mem + i * blk;
+  }
+
+  if (stable)
+  {
+    if (!sort_ptr_stable(order, len, cmp))
+    {
+      free(order);
+      return false;
+    }
+  }
+  else
+  {
+    sort_ptr(order, len, cmp);
+  }
+
+  apply_order(mem, order, len, blk, (char *) (order + len));
+  free(order);
+  return true;
+}
+
+void arrlist_sort
+(array_list *list, int (*cmp)(const void *, const void *))
+{
+  size_t const len = list->len;
+  char *mem = items_of(list);
+  switch (list->blk)
+  {
+    case 1:
+      sort_elem1((elem1 *) mem, len, cmp);
+      break;
+    case 2:
+      sort_elem2((elem2 *) mem, len, cmp);
+      break;
+    case 4:
+      sort_elem4((elem4 *) mem, len, cmp);
+      break;
+    case 8:
+      sort_elem8((elem8 *) mem, len, cmp);
+      break;
+    case 16:
+      sort_elem16((elem16 *) mem, len, cmp);
+      break;
+    default:
+      if (len > 1 && !sort_by_pointer(list, cmp, false))
+      {
+        /* no memory for the pointers, sort in place */
+        heapsort(mem, len, list->blk, cmp);
+      }
+      break;
+  }
+}
+
+bool arrlist_sort_stable
+(array_list *list, int (*cmp)(const void *, const void *))
+{
+  size_t const len = list->len;
+  char *mem = items_of(list);
+  switch (list->blk)
+  {
+    case 1:
+      return sort_elem1_stable((elem1 *) mem, len, cmp);
+    case 2:
+      return sort_elem2_stable((elem2 *) mem, len, cmp);
+    case 4:
+      return sort_elem4_stable((elem4 *) mem, len, cmp);
+    case 8:
+      return sort_elem8_stable((elem8 *) mem, len, cmp);
+    case 16:
+      return sort_elem16_stable((elem16 *) mem, len, cmp);
+    default:
+      return len < 2 || sort_by_pointer(list, cmp, true);
+  }
+}
+
+/**
+ * Finds the first item the predicate is false for, assuming it is true for
+ * a prefix of the list. The range halves every step whatever the outcome,
+ * so the outcome only picks the base, which compiles to a conditional move.
+ *
+ * @param upper - false to look for the first item not less than key, true
+ *                for the first item greater than key
+ */
+static
+size_t search_sorted
+(const array_list *list, const void *key, elem_cmp *cmp, bool upper)
+{
+  size_t n = list->len;
+  if (n == 0)
+  {
+    return 0;
+  }
+
+  size_t const blk = list->blk;
+  char const *mem = items_of(list);
+  int const limit = upper ? 0 : -1;
+  size_t base = 0;
+  while (n > 1)
+  {
+    /* both candidates for the next probe are fetched while this one waits */
+    size_t const half = n / 2;
+    PREFETCH(mem + (base + (n - half) / 2) * blk);
+    PREFETCH(mem + (base + half + (n - half) / 2) * blk);
+    base = cmp(mem + (base + half) * blk, key) <= limit ? base + half : base;
+    n -= half;
+  }
+  return base + (cmp(mem + base * blk, key) <= limit);
+}
+
+size_t arrlist_lower_bound
+(const array_list *restrict list, const void *restrict key, int (*cmp)(const void *, const void *))
+{
+  return search_sorted(list, key, cmp, false);
+}
+
+size_t arrlist_upper_bound
+(const array_list *restrict list, const void *restrict key, int (*cmp)(const void *, const void *))
+{
+  return search_sorted(list, key, cmp, true);
+}
+
+const void *arrlist_bsearch
+(const array_list *restrict list, const void *restrict key, int (*cmp)(const void *, const void *))
+{
+  size_t const index = search_sorted(list, key, cmp, false);
+  if (index < list->len)
+  {
+    char const *found = items_of(list) + index * list->blk;
+    if (cmp(found, key) == 0)
+    {
+      return found;
+    }
+  }
+
+  return NULL;
+}
+
+bool arrlist_insert_sorted
+(array_list *restrict list, const void *restrict el, int (*cmp)(const void *, const void *))
+{
+  /* after the equal items, so items inserted in order stay in order */
+  return arrlist_insert(list, search_sorted(list, el, cmp, true), el);
+}
+
+bool arrlist_merge_sorted
+(array_list *restrict list, const array_list *restrict other, int (*cmp)(const void *, const void *))
+{
+  size_t const blk = list->blk;
+  size_t const len = list->len;
+  size_t const count = other->len;
+  if (other->blk != blk || count > SIZE_MAX / blk - len)
+  {
+    return false;
+  }
+
+  if (!arrlist_ensure_capacity(list, len + count))
+  {
+    return false;
+  }
+
+  /* merge from the back into the free space, taking list items on ties */
+  char *mem = items_of(list);
+  char const *src = items_of(other);
+  size_t i = len;
+  size_t j = count;
+  size_t k = len + count;
+  while (j > 0)
+  {
+    if (i > 0 && cmp(mem + (i - 1) * blk, src + (j - 1) * blk) > 0)
+    {
+      memcpy(mem + --k * blk, mem + --i * blk, blk);
+    }
+    else
+    {
+      memcpy(mem + --k * blk, src + --j * blk, blk);
+    }
+  }
+
+  list->len = len + count;
+  return true;
+}
+
+/**
+ * Walks the implicit tree rooted at node k (one-based) in order, copying
+ * the items in sorted order to or from their place in the tree.
+ *
+ * @return the sorted index after the subtree
+ */
+static
+size_t eytzinger_walk
+(char *restrict tree, char *restrict sorted, size_t i, size_t k, size_t n, size_t blk, bool to_tree)
+{
+  if (k <= n)
+  {
+    i = eytzinger_walk(tree, sorted, i, 2 * k, n, blk, to_tree);
+    if (to_tree)
+    {
+      memcpy(tree + (k - 1) * blk, sorted + i * blk, blk);
+    }
+    else
+    {
+      memcpy(sorted + i * blk, tree + (k - 1) * blk, blk);
+    }
+    i = eytzinger_walk(tree, sorted, i + 1, 2 * k + 1, n, blk, to_tree);
+  }
+  return i;
+}
+
+static
+bool relayout
+(array_list *list, bool to_tree)
+{
+  size_t const len = list->len;
+  size_t const blk = list->blk;
+  if (len < 2)
+  {
+    return true;
+  }
+
+  char *tmp = huge_alloc(len * blk);
+  if (tmp == NULL)
+  {
+    return false;
+  }
+
+  char *mem = items_of(list);
+  memcpy(tmp, mem, len * blk);
+  if (to_tree)
+  {
+    eytzinger_walk(mem, tmp, 0, 1, len, blk, true);
+  }
+  else
+  {
+    eytzinger_walk(tmp, mem, 0, 1, len, blk, false);
+  }
+  huge_free(tmp, len * blk);
+  return true;
+}
+
+bool arrlist_to_eytzinger
+(array_list *list)
+{
+  return relayout(list, true);
+}
+
+bool arrlist_from_eytzinger
+(array_list *list)
+{
+  return relayout(list, false);
+}
+
+size_t arrlist_eytzinger_lower_bound
+(const array_list *restrict list, const void *restrict key, int (*cmp)(const void *, const void *))
+{
+  size_t const n = list->len;
+  size_t const blk = list->blk;
+  char const *mem = items_of(list);
+
+  /*
+   * the descendants some levels down are next to each other and span about
+   * a cache line, so both ends are fetched in case it is not aligned
+   */
+  size_t ahead = 2;
+  while (ahead * 2 * blk <= CACHE_LINE)
+  {
+    ahead *= 2;
+  }
+
+  size_t k = 1;
+  while (k <= n)
+  {
+    size_t const first = k * ahead - 1;
+    size_t const last = first + ahead - 1;
+    PREFETCH(mem + (first < n ? first : 0) * blk);
+    PREFETCH(mem + (last < n ? last : 0) * blk);
+    k = 2 * k + (cmp(mem + (k - 1) * blk, key) < 0);
+  }
+
+  /* the answer is where the path last went left: drop the right turns */
+#if defined(__GNUC__) || defined(__clang__)
+  k >>= __builtin_ctzll(~(unsigned long long) k) + 1;
+#else
+  while (k & 1)
+  {
+    k >>= 1;
+  }
+  k >>= 1;
+#endif
+  return k == 0 ? n : k - 1;
+}
+
 bool arrlist_add
 (array_list *restrict list, const void *restrict el)
 {
@@ -148,11 +593,17 @@ bool arrlist_add
     return false;
   }
 
-  memcpy(&list->mem[list->len * list->blk], el, list->blk);
+  memcpy(&items_of(list)[list->len * list->blk], el, list->blk);
   ++list->len;
   return true;
 }
 
+bool arrlist_add_all
+(array_list *restrict list, const void *restrict els, size_t count)
+{
+  return arrlist_insert_range(list, list->len, els, count);
+}
+
 bool arrlist_insert
 (array_list *restrict list, size_t index, const void *restrict el)
 {
@@ -174,19 +625,47 @@ bool arrlist_insert
   }
 
   /* shift the indicies after towards end */
-  char *offset = &list->mem[index * list->blk];
+  char *offset = &items_of(list)[index * list->blk];
   memmove(offset + list->blk, offset, (list->len - index) * list->blk);
   memcpy(offset, el, list->blk);
   ++list->len;
   return true;
 }
 
+bool arrlist_insert_range
+(array_list *restrict list, size_t index, const void *restrict els, size_t count)
+{
+  size_t len = list->len;
+  if (index > len || count > SIZE_MAX / list->blk - len)
+  {
+    /* out of bounds or the new size cannot be represented */
+    return false;
+  }
+
+  if (count == 0)
+  {
+    return true;
+  }
+
+  if (!arrlist_ensure_capacity(list, len + count))
+  {
+    return false;
+  }
+
+  /* shift the indicies after towards end, all at once */
+  char *offset = &items_of(list)[index * list->blk];
+  memmove(offset + count * list->blk, offset, (len - index) * list->blk);
+  memcpy(offset, els, count * list->blk);
+  list->len = len + count;
+  return true;
+}
+
 bool arrlist_set
 (array_list *restrict list, size_t index, const void *restrict el, void *restrict out)
 {
   if (index < list->len)
   {
-    char *offset = &list->mem[index * list->blk];
+    char *offset = &items_of(list)[index * list->blk];
     if (out != NULL)
     {
       memmove(out, offset, list->blk);
@@ -205,12 +684,12 @@ bool arrlist_remove
   if (index < list->len)
   {
     /* shift the indicies after towards head */
-    char *offset = &list->mem[index * list->blk];
+    char *offset = &items_of(list)[index * list->blk];
     if (out != NULL)
     {
       memmove(out, offset, list->blk);
     }
-    memmove(offset, offset + list->blk, (list->len - index + 1) * list->blk);
+    memmove(offset, offset + list->blk, (list->len - index - 1) * list->blk);
     --list->len;
     return true;
   }
@@ -219,21 +698,109 @@ bool arrlist_remove
   return false;
 }
 
+size_t arrlist_remove_range
+(array_list *list, size_t lo, size_t hi)
+{
+  size_t const len = list->len;
+  if (hi > len)
+  {
+    hi = len;
+  }
+
+  if (lo >= hi)
+  {
+    /* do nothing since range is [lo, hi) */
+    return 0;
+  }
+
+  char *offset = &items_of(list)[lo * list->blk];
+  memmove(offset, offset + (hi - lo) * list->blk, (len - hi) * list->blk);
+  list->len = len - (hi - lo);
+  return hi - lo;
+}
+
+static
+size_t filter_items
+(array_list *list, bool (*pred)(const void *), bool keep)
+{
+  size_t const len = list->len;
+  size_t const blk = list->blk;
+  char *mem = items_of(list);
+
+  /*
+   * kept items before kept are in place, the ones from run up to the
+   * current item still have to move there, which happens once an item
+   * being removed ends their run
+   */
+  size_t kept = 0;
+  size_t run = 0;
+  for (size_t i = 0; i < len; ++i)
+  {
+    if (pred(&mem[i * blk]) == keep)
+    {
+      continue;
+    }
+
+    if (kept != run)
+    {
+      memmove(&mem[kept * blk], &mem[run * blk], (i - run) * blk);
+    }
+    kept += i - run;
+    run = i + 1;
+  }
+
+  if (kept != run)
+  {
+    memmove(&mem[kept * blk], &mem[run * blk], (len - run) * blk);
+  }
+  kept += len - run;
+
+  list->len = kept;
+  return len - kept;
+}
+
+size_t arrlist_remove_if
+(array_list *list, bool (*pred)(const void *))
+{
+  return filter_items(list, pred, false);
+}
+
+size_t arrlist_retain_if
+(array_list *list, bool (*pred)(const void *))
+{
+  return filter_items(list, pred, true);
+}
+
 void arrlist_foreach
 (const array_list *list, void (*it)(const void *))
 {
+  char const *mem = items_of(list);
   for (size_t i = 0; i < list->len; ++i)
   {
-    it(&list->mem[i * list->blk]);
+    it(&mem[i * list->blk]);
   }
 }
 
+bool arrlist_foreach_ctx
+(const array_list *list, bool (*it)(const void *, void *), void *ctx)
+{
+  char const *mem = items_of(list);
+  for (size_t i = 0; i < list->len; ++i)
+  {
+    if (!it(&mem[i * list->blk], ctx))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
 void const *arrlist_get
 (const array_list *list, size_t index)
 {
   if (index < list->len)
   {
-    return &list->mem[index * list->blk];
+    return &items_of(list)[index * list->blk];
   }
 
   return NULL;
@@ -254,7 +821,7 @@ size_t arrlist_capacity
 void *arrlist_data
 (array_list *list)
 {
-  return list->mem;
+  return items_of(list);
 }
 
 bool arrlist_remove_first
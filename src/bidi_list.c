@@ -257,6 +257,32 @@ void list_reveach
   }
 }
 
+bool list_foreach_ctx
+(bidi_list const * const list, bool (* it)(void const *, void *), void * ctx)
+{
+  bidi_entry const * entry = list->first;
+  while (entry != NULL)
+  {
+    bidi_entry const * const next = entry->next;
+    if (!it(entry->data, ctx)) return false;
+    entry = next;
+  }
+  return true;
+}
+
+bool list_reveach_ctx
+(bidi_list const * const list, bool (* it)(void const *, void *), void * ctx)
+{
+  bidi_entry const * entry = list->last;
+  while (entry != NULL)
+  {
+    bidi_entry const * const next = entry->prev;
+    if (!it(entry->data, ctx)) return false;
+    entry = next;
+  }
+  return true;
+}
+
 size_t list_size
 (bidi_list const * const list)
 {
@@ -15,6 +15,7 @@
  */
 
 #include "bit_array.h"
+#include "huge_alloc.h"
 
 #define WORDSZ    (sizeof(unsigned int))
 #define WORDBITS  (WORDSZ * CHAR_BIT)
@@ -32,14 +33,16 @@ init_bitarr(bit_array *arr, size_t bits)
   if (bits == 0)
   {
     arr->c = 0;
+    arr->w = 0;
     arr->b = NULL;
     return true;
   }
 
   const size_t cap = compute_word_len(bits);
-  unsigned int * buf = calloc(cap, WORDSZ);
+  unsigned int * buf = huge_calloc(cap * WORDSZ);
   if (buf == NULL) return false;
   arr->c = bits;
+  arr->w = cap;
   arr->b = buf;
   return true;
 }
@@ -59,7 +62,8 @@ free_bitarr(bit_array *arr)
   arr->c = 0;
   if (arr->b != NULL)
   {
-    free(arr->b);
+    huge_free(arr->b, arr->w * WORDSZ);
+    arr->w = 0;
     arr->b = NULL;
   }
 }
@@ -68,9 +72,17 @@ void bitarr_compact
 (bit_array *arr)
 {
   size_t const len = compute_word_len(arr->c);
-  unsigned int * new_buf = realloc(arr->b, len * WORDSZ);
+  if (arr->w == len) return;
+  if (len == 0)
+  {
+    free_bitarr(arr);
+    return;
+  }
+
+  unsigned int * new_buf = huge_realloc(arr->b, arr->w * WORDSZ, len * WORDSZ);
   if (new_buf != NULL)
   {
+    arr->w = len;
     arr->b = new_buf;
   }
 
@@ -97,14 +109,27 @@ bool bitarr_resize
     {
       arr->b[i] = 0;
     }
+    if (new_bits % WORDBITS != 0)
+    {
+      /* so the bits come back unset if the array grows again */
+      arr->b[new_len - 1] &= (1u << (new_bits % WORDBITS)) - 1;
+    }
+    return true;
+  }
+
+  if (arr->w >= new_len)
+  {
+    /* a previous shrink kept the words, and they were cleared */
+    arr->c = new_bits;
     return true;
   }
 
   /* grow the underlying buffer */
-  unsigned int * new_buf = realloc(arr->b, new_len * WORDSZ);
+  unsigned int * new_buf = huge_realloc(arr->b, arr->w * WORDSZ, new_len * WORDSZ);
   if (new_buf == NULL) return false;
 
   arr->c = new_bits;
+  arr->w = new_len;
   arr->b = new_buf;
   for (size_t i = old_len; i < new_len; ++i)
   {
@@ -166,6 +191,17 @@ bitarr_foreach(bit_array const *arr, void (*vis)(bool))
   }
 }
 
+bool
+bitarr_foreach_ctx(bit_array const *arr, bool (*vis)(bool, void *), void *ctx)
+{
+  if (arr->c == 0 || arr->b == NULL) return true;
+  for (size_t i = 0; i < arr->c; ++i)
+  {
+    if (!vis(bitarr_get(arr, i), ctx)) return false;
+  }
+  return true;
+}
+
 void
 bitarr_and(bit_array *lhs, bit_array const *rhs)
 {
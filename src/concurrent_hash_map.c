@@ -0,0 +1,538 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "concurrent_hash_map.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Buckets are probed linearly. A bucket's pair is NULL until it is claimed,
+ * and a removed pair is replaced by TOMBSTONE so probing continues past it.
+ * Writers claim a bucket by swapping in CLAIMED, then fill in the hashcode
+ * and publish the pair, so readers never see a pair with a stale hashcode.
+ */
+
+static char const tombstone_marker;
+static char const claimed_marker;
+
+#define TOMBSTONE ((void const *) &tombstone_marker)
+#define CLAIMED   ((void const *) &claimed_marker)
+
+#define MIN_CAP 16
+#define DEFAULT_STRIPES 64
+
+typedef struct chmap_bucket
+{
+  _Atomic(unsigned long) hash;
+  _Atomic(void const *) pair;
+} chmap_bucket;
+
+typedef struct chmap_table
+{
+  size_t cap;
+  size_t shift;
+  struct chmap_table *retired; /* next retired table */
+  chmap_bucket mem[];
+} chmap_table;
+
+typedef union chmap_stripe
+{
+  pthread_mutex_t lock;
+  char pad[64]; /* keep stripes on separate cache lines */
+} chmap_stripe;
+
+struct concurrent_hash_map
+{
+  hash_func *hasher;
+  key_eq *key_equal;
+  _Atomic(chmap_table *) table;
+  chmap_table *retired; /* guarded by every stripe */
+  atomic_size_t len;
+  atomic_size_t used; /* buckets that are not NULL */
+  size_t stripe_mask;
+  chmap_stripe stripes[];
+};
+
+static
+chmap_table *alloc_table
+(size_t cap)
+{
+  chmap_table *table = malloc(sizeof(chmap_table) + cap * sizeof(chmap_bucket));
+  if (table == NULL)
+  {
+    return NULL;
+  }
+
+  table->cap = cap;
+  table->shift = 64;
+  for (size_t n = cap; n > 1; n >>= 1)
+  {
+    --table->shift;
+  }
+  table->retired = NULL;
+
+  for (size_t i = 0; i < cap; ++i)
+  {
+    atomic_init(&table->mem[i].hash, 0);
+    atomic_init(&table->mem[i].pair, NULL);
+  }
+  return table;
+}
+
+static inline
+size_t hash_home
+(chmap_table const * table, unsigned long hashcode)
+{
+  /* fibonacci hashing, same as hash_map */
+  uint64_t const spread = (uint64_t) hashcode * UINT64_C(0x9E3779B97F4A7C15);
+  return (size_t) (spread >> table->shift);
+}
+
+static inline
+pthread_mutex_t *stripe_of
+(concurrent_hash_map * map, unsigned long hashcode)
+{
+  return &map->stripes[hashcode & map->stripe_mask].lock;
+}
+
+/**
+ * @param map - this pointer
+ * @param table - buckets being probed
+ * @param pair - search by key
+ * @param hashcode - hashcode of pair
+ * @param out_pair - outputs the pair that matched
+ *
+ * @return bucket with the same key or NULL if no such bucket exists
+ */
+static
+chmap_bucket *find_bucket
+(concurrent_hash_map const * map, chmap_table * table, void const * pair, unsigned long hashcode,
+ void const ** out_pair)
+{
+  size_t const mask = table->cap - 1;
+  size_t slot = hash_home(table, hashcode);
+
+  for (size_t k = 0; k < table->cap; ++k)
+  {
+    chmap_bucket * bucket = &table->mem[slot];
+    void const * cur = atomic_load_explicit(&bucket->pair, memory_order_acquire);
+    if (cur == NULL)
+    {
+      /* end of the probe sequence */
+      break;
+    }
+
+    if (cur != TOMBSTONE && cur != CLAIMED
+      && atomic_load_explicit(&bucket->hash, memory_order_relaxed) == hashcode
+      && map->key_equal(cur, pair))
+    {
+      *out_pair = cur;
+      return bucket;
+    }
+
+    slot = (slot + 1) & mask;
+  }
+  return NULL;
+}
+
+/**
+ * Grows the buckets or purges removed pairs once more than half of the
+ * buckets are in use. Takes every stripe.
+ *
+ * @param map - this pointer
+ * @param seen - the buckets that were found to be too full
+ *
+ * @return false if new buckets could not be allocated
+ */
+static
+bool resize
+(concurrent_hash_map * map, chmap_table * seen)
+{
+  for (size_t i = 0; i <= map->stripe_mask; ++i)
+  {
+    pthread_mutex_lock(&map->stripes[i].lock);
+  }
+
+  bool ok = true;
+  chmap_table * old = atomic_load_explicit(&map->table, memory_order_relaxed);
+  if (old == seen)
+  {
+    /* size the new buckets so they are a quarter full */
+    size_t const len = atomic_load_explicit(&map->len, memory_order_relaxed);
+    size_t cap = MIN_CAP;
+    while (cap < len * 4)
+    {
+      cap *= 2;
+    }
+
+    chmap_table * table = alloc_table(cap);
+    if (table == NULL)
+    {
+      ok = false;
+    }
+    else
+    {
+      /* no writer is running, so there are no claimed buckets */
+      for (size_t i = 0; i < old->cap; ++i)
+      {
+        void const * pair = atomic_load_explicit(&old->mem[i].pair, memory_order_relaxed);
+        if (pair == NULL || pair == TOMBSTONE)
+        {
+          continue;
+        }
+
+        unsigned long const hashcode = atomic_load_explicit(&old->mem[i].hash, memory_order_relaxed);
+        size_t slot = hash_home(table, hashcode);
+        while (atomic_load_explicit(&table->mem[slot].pair, memory_order_relaxed) != NULL)
+        {
+          slot = (slot + 1) & (cap - 1);
+        }
+        atomic_store_explicit(&table->mem[slot].hash, hashcode, memory_order_relaxed);
+        atomic_store_explicit(&table->mem[slot].pair, pair, memory_order_relaxed);
+      }
+
+      atomic_store_explicit(&map->used, len, memory_order_relaxed);
+      atomic_store_explicit(&map->table, table, memory_order_release);
+
+      /* readers could still be probing the old buckets */
+      old->retired = map->retired;
+      map->retired = old;
+    }
+  }
+  /* else someone else already resized */
+
+  for (size_t i = map->stripe_mask + 1; i-- > 0; )
+  {
+    pthread_mutex_unlock(&map->stripes[i].lock);
+  }
+  return ok;
+}
+
+/**
+ * @param map - this pointer
+ * @param pair - pair being placed
+ * @param repl - outputs replaced pair, ignored if NULL
+ * @param overwrite - replace the pair with the same key
+ * @param must_exist - only replace, never insert
+ *
+ * @return true if pair was placed or replaced
+ */
+static
+bool put_pair
+(concurrent_hash_map * restrict map, void const * restrict pair, void const ** restrict repl,
+ bool overwrite, bool must_exist)
+{
+  unsigned long const hashcode = map->hasher(pair);
+  pthread_mutex_t * stripe = stripe_of(map, hashcode);
+
+  for (;;)
+  {
+    pthread_mutex_lock(stripe);
+
+    /* stable while any stripe is held */
+    chmap_table * table = atomic_load_explicit(&map->table, memory_order_acquire);
+    if (atomic_load_explicit(&map->used, memory_order_relaxed) * 2 >= table->cap)
+    {
+      pthread_mutex_unlock(stripe);
+      if (!resize(map, table))
+      {
+        return false;
+      }
+      continue;
+    }
+
+    size_t const mask = table->cap - 1;
+    size_t slot = hash_home(table, hashcode);
+    chmap_bucket * vacant = NULL;
+    void const * expected = NULL;
+
+    for (size_t k = 0; k < table->cap; ++k, slot = (slot + 1) & mask)
+    {
+      chmap_bucket * bucket = &table->mem[slot];
+      void const * cur = atomic_load_explicit(&bucket->pair, memory_order_acquire);
+      if (cur == NULL)
+      {
+        if (vacant == NULL)
+        {
+          vacant = bucket;
+        }
+        break;
+      }
+
+      if (cur == TOMBSTONE)
+      {
+        if (vacant == NULL)
+        {
+          vacant = bucket;
+          expected = TOMBSTONE;
+        }
+        continue;
+      }
+
+      /*
+       * claimed buckets belong to writers of other stripes, so they are
+       * never the same key
+       */
+      if (cur != CLAIMED
+        && atomic_load_explicit(&bucket->hash, memory_order_relaxed) == hashcode
+        && map->key_equal(cur, pair))
+      {
+        bool const placed = overwrite;
+        if (overwrite)
+        {
+          atomic_store_explicit(&bucket->pair, pair, memory_order_release);
+          if (repl != NULL)
+          {
+            *repl = cur;
+          }
+        }
+        pthread_mutex_unlock(stripe);
+        return placed;
+      }
+    }
+
+    if (must_exist)
+    {
+      pthread_mutex_unlock(stripe);
+      return false;
+    }
+
+    if (vacant == NULL
+      || !atomic_compare_exchange_strong_explicit(&vacant->pair, &expected, CLAIMED,
+                                                  memory_order_acquire, memory_order_relaxed))
+    {
+      /* table is full or another stripe took the bucket, try again */
+      pthread_mutex_unlock(stripe);
+      if (vacant == NULL && !resize(map, table))
+      {
+        return false;
+      }
+      continue;
+    }
+
+    atomic_store_explicit(&vacant->hash, hashcode, memory_order_relaxed);
+    atomic_store_explicit(&vacant->pair, pair, memory_order_release);
+    atomic_fetch_add_explicit(&map->len, 1, memory_order_relaxed);
+    if (expected == NULL)
+    {
+      atomic_fetch_add_explicit(&map->used, 1, memory_order_relaxed);
+    }
+
+    pthread_mutex_unlock(stripe);
+    return true;
+  }
+}
+
+static
+void destroy_stripes
+(concurrent_hash_map * map, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    pthread_mutex_destroy(&map->stripes[i].lock);
+  }
+}
+
+concurrent_hash_map *new_chmap
+(hash_func * hasher, key_eq * key_equal, size_t stripes)
+{
+  if (hasher == NULL || key_equal == NULL)
+  {
+    return NULL;
+  }
+
+  size_t count = 1;
+  while (count < (stripes == 0 ? DEFAULT_STRIPES : stripes))
+  {
+    count *= 2;
+  }
+
+  concurrent_hash_map * map = malloc(sizeof(concurrent_hash_map) + count * sizeof(chmap_stripe));
+  if (map == NULL)
+  {
+    return NULL;
+  }
+
+  chmap_table * table = alloc_table(MIN_CAP);
+  if (table == NULL)
+  {
+    free(map);
+    return NULL;
+  }
+
+  map->hasher = hasher;
+  map->key_equal = key_equal;
+  atomic_init(&map->table, table);
+  map->retired = NULL;
+  atomic_init(&map->len, 0);
+  atomic_init(&map->used, 0);
+  map->stripe_mask = count - 1;
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (pthread_mutex_init(&map->stripes[i].lock, NULL) != 0)
+    {
+      destroy_stripes(map, i);
+      free(table);
+      free(map);
+      return NULL;
+    }
+  }
+  return map;
+}
+
+void delete_chmap
+(concurrent_hash_map * map)
+{
+  if (map == NULL)
+  {
+    return;
+  }
+
+  chmap_reclaim(map);
+  free(atomic_load_explicit(&map->table, memory_order_relaxed));
+  destroy_stripes(map, map->stripe_mask + 1);
+  free(map);
+}
+
+void chmap_reclaim
+(concurrent_hash_map * map)
+{
+  for (size_t i = 0; i <= map->stripe_mask; ++i)
+  {
+    pthread_mutex_lock(&map->stripes[i].lock);
+  }
+
+  chmap_table * table = map->retired;
+  map->retired = NULL;
+
+  for (size_t i = map->stripe_mask + 1; i-- > 0; )
+  {
+    pthread_mutex_unlock(&map->stripes[i].lock);
+  }
+
+  while (table != NULL)
+  {
+    chmap_table * next = table->retired;
+    free(table);
+    table = next;
+  }
+}
+
+bool chmap_put
+(concurrent_hash_map * restrict map, void const * restrict pair, void const ** restrict repl)
+{
+  if (pair == NULL)
+  {
+    /* insert null pair does nothing */
+    return true;
+  }
+
+  return put_pair(map, pair, repl, true, false);
+}
+
+bool chmap_put_if_absent
+(concurrent_hash_map * restrict map, void const * restrict pair)
+{
+  if (pair == NULL)
+  {
+    /* insert null pair does nothing */
+    return true;
+  }
+
+  return put_pair(map, pair, NULL, false, false);
+}
+
+void const * chmap_replace
+(concurrent_hash_map * restrict map, void const * restrict pair)
+{
+  void const * old = NULL;
+  if (pair != NULL)
+  {
+    put_pair(map, pair, &old, true, true);
+  }
+  return old;
+}
+
+void const * chmap_remove
+(concurrent_hash_map * restrict map, void const * restrict pair)
+{
+  if (pair == NULL)
+  {
+    /* nothing is being removed */
+    return NULL;
+  }
+
+  unsigned long const hashcode = map->hasher(pair);
+  pthread_mutex_t * stripe = stripe_of(map, hashcode);
+  pthread_mutex_lock(stripe);
+
+  void const * old = NULL;
+  chmap_table * table = atomic_load_explicit(&map->table, memory_order_acquire);
+  chmap_bucket * bucket = find_bucket(map, table, pair, hashcode, &old);
+  if (bucket != NULL)
+  {
+    /* tombstone keeps the probe sequence intact */
+    old = atomic_exchange_explicit(&bucket->pair, TOMBSTONE, memory_order_release);
+    atomic_fetch_sub_explicit(&map->len, 1, memory_order_relaxed);
+  }
+
+  pthread_mutex_unlock(stripe);
+  return old;
+}
+
+bool chmap_has_key
+(concurrent_hash_map const * restrict map, void const * restrict pair)
+{
+  return chmap_get(map, pair) != NULL;
+}
+
+void const * chmap_get
+(concurrent_hash_map const * restrict map, void const * restrict pair)
+{
+  if (pair == NULL)
+  {
+    return NULL;
+  }
+
+  /* atomics are never read-only, even for a reader */
+  concurrent_hash_map * self = (concurrent_hash_map *) map;
+  unsigned long const hashcode = map->hasher(pair);
+  chmap_table * table = atomic_load_explicit(&self->table, memory_order_acquire);
+
+  void const * found = NULL;
+  find_bucket(map, table, pair, hashcode, &found);
+  return found;
+}
+
+void const * chmap_get_or_default
+(concurrent_hash_map const * restrict map, void const * restrict pair)
+{
+  void const * ptr = chmap_get(map, pair);
+  if (ptr == NULL)
+  {
+    return pair;
+  }
+  return ptr;
+}
+
+size_t chmap_size
+(concurrent_hash_map const * map)
+{
+  return atomic_load_explicit(&((concurrent_hash_map *) map)->len, memory_order_relaxed);
+}
\ No newline at end of file
@@ -0,0 +1,562 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "cuckoo_hash_map.h"
+#include "hmap_group.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* buckets visited by one breadth-first search, enough for paths of four moves */
+#define BFS_NODES 512
+
+#define MIN_BUCKETS 4
+
+#define CACHE_LINE 64
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(addr) __builtin_prefetch((addr))
+#else
+#define PREFETCH(addr) ((void) (addr))
+#endif
+
+typedef struct bfs_node
+{
+  size_t bucket;
+  size_t parent; /* index of the node this one was reached from */
+  size_t slot; /* slot of the parent bucket whose pair moves here */
+} bfs_node;
+
+static inline
+size_t first_bucket
+(unsigned long const hashcode, size_t const buckets)
+{
+  return hmap_home(hashcode, buckets);
+}
+
+/**
+ * Returns the bucket a pair in the given bucket can move to. The two buckets
+ * of a hashcode are an xor apart, so either one leads to the other without
+ * knowing which one the pair is in.
+ */
+static inline
+size_t other_bucket
+(size_t const bucket, unsigned long const hashcode, size_t const buckets)
+{
+  uint64_t const spread = (uint64_t) hashcode * UINT64_C(0xC2B2AE3D27D4EB4F);
+  size_t const delta = (size_t) (spread >> (64 - hmap_log2_cap(buckets)));
+  return bucket ^ (delta == 0 ? 1 : delta);
+}
+
+static inline
+size_t empty_slot
+(ckmap_bucket const * const bucket)
+{
+  for (size_t i = 0; i < CKMAP_SLOTS; ++i)
+  {
+    if (bucket->slots[i].pair == NULL)
+    {
+      return i;
+    }
+  }
+  return CKMAP_SLOTS;
+}
+
+static
+ckmap_bucket * alloc_buckets
+(size_t const buckets)
+{
+  void * mem;
+  if (posix_memalign(&mem, CACHE_LINE, buckets * sizeof(ckmap_bucket)) != 0)
+  {
+    return NULL;
+  }
+
+  memset(mem, 0, buckets * sizeof(ckmap_bucket));
+  return mem;
+}
+
+/**
+ * @param nodes - search so far
+ * @param node - index of a node
+ * @param bucket - bucket being checked
+ *
+ * @return true if bucket is on the path from the root to node
+ */
+static
+bool on_path
+(bfs_node const * const nodes, size_t node, size_t const bucket)
+{
+  for (; node != HMAP_NPOS; node = nodes[node].parent)
+  {
+    if (nodes[node].bucket == bucket)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Places a pair without checking for duplicate keys or load. If both of its
+ * buckets are full, searches breadth-first for the shortest chain of pairs
+ * that can each move to their other bucket, ending at a bucket with an
+ * empty slot, then moves them starting from the end.
+ *
+ * @param mem - buckets
+ * @param buckets - number of buckets
+ * @param hashcode - hashcode of pair
+ * @param pair - pair being placed
+ *
+ * @return true if pair was placed, false if no chain was found
+ */
+static
+bool insert_entry
+(ckmap_bucket * const mem, size_t const buckets, unsigned long const hashcode,
+ void const * pair)
+{
+  bfs_node nodes[BFS_NODES];
+  size_t len = 0;
+
+  size_t const b1 = first_bucket(hashcode, buckets);
+  size_t const b2 = other_bucket(b1, hashcode, buckets);
+  nodes[len++] = (bfs_node) { b1, HMAP_NPOS, 0 };
+  nodes[len++] = (bfs_node) { b2, HMAP_NPOS, 0 };
+
+  for (size_t i = 0; i < len; ++i)
+  {
+    size_t bucket = nodes[i].bucket;
+    size_t slot = empty_slot(&mem[bucket]);
+    if (slot == CKMAP_SLOTS)
+    {
+      /* queue the buckets the pairs of this one could move to */
+      for (size_t s = 0; s < CKMAP_SLOTS && len < BFS_NODES; ++s)
+      {
+        size_t const alt = other_bucket(bucket, mem[bucket].slots[s].hash, buckets);
+        if (!on_path(nodes, i, alt))
+        {
+          nodes[len++] = (bfs_node) { alt, i, s };
+        }
+      }
+      continue;
+    }
+
+    /* move every pair on the path one step, freeing a slot at the root */
+    for (size_t node = i; nodes[node].parent != HMAP_NPOS; node = nodes[node].parent)
+    {
+      size_t const from = nodes[nodes[node].parent].bucket;
+      mem[bucket].slots[slot] = mem[from].slots[nodes[node].slot];
+      bucket = from;
+      slot = nodes[node].slot;
+    }
+
+    mem[bucket].slots[slot].hash = hashcode;
+    mem[bucket].slots[slot].pair = pair;
+    return true;
+  }
+  return false;
+}
+
+static
+bool stash_push
+(map_entry ** restrict stash, size_t * restrict len, size_t * restrict cap, map_entry const entry)
+{
+  if (*len == *cap)
+  {
+    size_t const new_cap = *cap < 4 ? 4 : *cap * 2;
+    map_entry * grown = realloc(*stash, new_cap * sizeof(map_entry));
+    if (grown == NULL)
+    {
+      return false;
+    }
+    *stash = grown;
+    *cap = new_cap;
+  }
+
+  (*stash)[(*len)++] = entry;
+  return true;
+}
+
+/**
+ * Replaces the buckets with a new set of buckets, giving the stashed pairs
+ * another chance
+ *
+ * @param map - this pointer
+ * @param new_buckets - new number of buckets, a power of two
+ *
+ * @return true if buckets were able to be allocated successfully
+ */
+static
+bool resize_buckets
+(cuckoo_hash_map * const map, size_t const new_buckets)
+{
+  ckmap_bucket * new_mem = alloc_buckets(new_buckets);
+  if (new_mem == NULL)
+  {
+    return false;
+  }
+
+  map_entry * stash = NULL;
+  size_t stash_len = 0;
+  size_t stash_cap = 0;
+  for (size_t i = 0; i < map->buckets * CKMAP_SLOTS + map->stash_len; ++i)
+  {
+    map_entry const ent = i < map->buckets * CKMAP_SLOTS
+      ? map->mem[i / CKMAP_SLOTS].slots[i % CKMAP_SLOTS]
+      : map->stash[i - map->buckets * CKMAP_SLOTS];
+    if (ent.pair != NULL
+      && !insert_entry(new_mem, new_buckets, ent.hash, ent.pair)
+      && !stash_push(&stash, &stash_len, &stash_cap, ent))
+    {
+      free(new_mem);
+      free(stash);
+      return false;
+    }
+  }
+
+  free(map->mem);
+  free(map->stash);
+  map->mem = new_mem;
+  map->buckets = new_buckets;
+  map->grow_at = (size_t) (new_buckets * CKMAP_SLOTS * CKMAP_MAX_LOAD);
+  map->stash = stash;
+  map->stash_len = stash_len;
+  map->stash_cap = stash_cap;
+  return true;
+}
+
+/**
+ * @param map - this pointer
+ * @param pair - pair being placed, must not have the same key as any
+ *               existing pair
+ * @param hashcode - hashcode of pair
+ *
+ * @return true if pair was placed, false if map needed to grow but failed
+ */
+static
+bool place_pair
+(cuckoo_hash_map * restrict const map, void const * restrict pair, unsigned long const hashcode)
+{
+  while (!insert_entry(map->mem, map->buckets, hashcode, pair))
+  {
+    if (map->len < map->buckets * CKMAP_SLOTS / 2)
+    {
+      /* growing a half empty map will not help, the hashcodes collide */
+      if (!stash_push(&map->stash, &map->stash_len, &map->stash_cap,
+                      (map_entry) { hashcode, pair }))
+      {
+        return false;
+      }
+      break;
+    }
+
+    if (!resize_buckets(map, map->buckets * 2))
+    {
+      return false;
+    }
+  }
+
+  ++map->len;
+  return true;
+}
+
+/**
+ * @param map - this pointer
+ * @param pair - search by key
+ * @param hashcode - hashcode of pair
+ *
+ * @return slot or stash entry with the same key or NULL if no such slot exists
+ */
+static
+map_entry * find_entry
+(cuckoo_hash_map const * restrict const map, void const * restrict pair,
+ unsigned long const hashcode)
+{
+  if (map->len < 1)
+  {
+    return NULL;
+  }
+
+  size_t const b1 = first_bucket(hashcode, map->buckets);
+  size_t const b2 = other_bucket(b1, hashcode, map->buckets);
+
+  /* both cache lines are requested before either is needed */
+  PREFETCH(&map->mem[b2]);
+
+  ckmap_bucket * const candidates[2] = { &map->mem[b1], &map->mem[b2] };
+  for (size_t b = 0; b < 2; ++b)
+  {
+    for (size_t i = 0; i < CKMAP_SLOTS; ++i)
+    {
+      map_entry * ent = &candidates[b]->slots[i];
+      if (ent->hash == hashcode && ent->pair != NULL && map->key_equal(ent->pair, pair))
+      {
+        return ent;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < map->stash_len; ++i)
+  {
+    map_entry * ent = &map->stash[i];
+    if (ent->hash == hashcode && map->key_equal(ent->pair, pair))
+    {
+      return ent;
+    }
+  }
+  return NULL;
+}
+
+bool init_ckmap
+(cuckoo_hash_map * const map, hash_func * hasher, key_eq * key_equal)
+{
+  if (hasher == NULL || key_equal == NULL)
+  {
+    return false;
+  }
+
+  map->len = 0;
+  map->buckets = 0;
+  map->mem = NULL;
+  map->hasher = hasher;
+  map->key_equal = key_equal;
+  map->grow_at = 0;
+  map->stash = NULL;
+  map->stash_len = 0;
+  map->stash_cap = 0;
+  return true;
+}
+
+void free_ckmap
+(cuckoo_hash_map * const map)
+{
+  free(map->mem);
+  free(map->stash);
+
+  map->len = 0;
+  map->buckets = 0;
+  map->mem = NULL;
+  map->hasher = NULL;
+  map->grow_at = 0;
+  map->stash = NULL;
+  map->stash_len = 0;
+  map->stash_cap = 0;
+}
+
+void ckmap_clear
+(cuckoo_hash_map * const map)
+{
+  map->len = 0;
+  map->stash_len = 0;
+  if (map->buckets > 0)
+  {
+    memset(map->mem, 0, map->buckets * sizeof(ckmap_bucket));
+  }
+}
+
+bool ckmap_ensure_capacity
+(cuckoo_hash_map * const map, size_t n)
+{
+  if (map->grow_at >= n)
+  {
+    /* n pairs already fit */
+    return true;
+  }
+
+  size_t buckets = MIN_BUCKETS;
+  while (buckets * CKMAP_SLOTS * CKMAP_MAX_LOAD < HMAP_GROW(n))
+  {
+    buckets *= 2;
+  }
+  return buckets <= map->buckets || resize_buckets(map, buckets);
+}
+
+bool ckmap_put
+(cuckoo_hash_map * restrict const map, void const * restrict pair, void const ** restrict repl)
+{
+  if (pair == NULL)
+  {
+    /* insert null pair does nothing */
+    return true;
+  }
+
+  unsigned long const hashcode = map->hasher(pair);
+  map_entry * ent = find_entry(map, pair, hashcode);
+  if (ent == NULL)
+  {
+    return ckmap_ensure_capacity(map, map->len + 1) && place_pair(map, pair, hashcode);
+  }
+
+  if (repl != NULL)
+  {
+    *repl = ent->pair;
+  }
+  ent->pair = pair;
+  return true;
+}
+
+bool ckmap_put_if_absent
+(cuckoo_hash_map * restrict const map, void const * restrict pair)
+{
+  if (pair == NULL)
+  {
+    /* insert null pair does nothing */
+    return true;
+  }
+
+  unsigned long const hashcode = map->hasher(pair);
+  if (find_entry(map, pair, hashcode) != NULL)
+  {
+    return false;
+  }
+  return ckmap_ensure_capacity(map, map->len + 1) && place_pair(map, pair, hashcode);
+}
+
+void const * ckmap_replace
+(cuckoo_hash_map * restrict const map, void const * restrict pair)
+{
+  if (pair == NULL)
+  {
+    return NULL;
+  }
+
+  map_entry * ent = find_entry(map, pair, map->hasher(pair));
+  if (ent == NULL)
+  {
+    /* does not exist, nothing to replace */
+    return NULL;
+  }
+
+  void const * old = ent->pair;
+  ent->pair = pair;
+  return old;
+}
+
+void const * ckmap_remove
+(cuckoo_hash_map * restrict const map, void const * restrict pair)
+{
+  if (pair == NULL)
+  {
+    return NULL;
+  }
+
+  map_entry * ent = find_entry(map, pair, map->hasher(pair));
+  if (ent == NULL)
+  {
+    /* does not exist, nothing to remove */
+    return NULL;
+  }
+
+  void const * old = ent->pair;
+  if (ent >= map->stash && ent < map->stash + map->stash_len)
+  {
+    *ent = map->stash[--map->stash_len];
+  }
+  else
+  {
+    ent->pair = NULL;
+  }
+  --map->len;
+  return old;
+}
+
+bool ckmap_has_key
+(cuckoo_hash_map const * restrict const map, void const * restrict pair)
+{
+  return ckmap_get(map, pair) != NULL;
+}
+
+void const * ckmap_get
+(cuckoo_hash_map const * restrict const map, void const * restrict pair)
+{
+  if (pair == NULL || map->len < 1)
+  {
+    return NULL;
+  }
+
+  map_entry const * ent = find_entry(map, pair, map->hasher(pair));
+  return ent == NULL ? NULL : ent->pair;
+}
+
+void const * ckmap_get_or_default
+(cuckoo_hash_map const * restrict const map, void const * restrict pair)
+{
+  void const * ptr = ckmap_get(map, pair);
+  if (ptr == NULL)
+  {
+    return pair;
+  }
+  return ptr;
+}
+
+void ckmap_foreach
+(cuckoo_hash_map const * const map, void (* it)(void const *))
+{
+  for (size_t i = 0; i < map->buckets; ++i)
+  {
+    for (size_t j = 0; j < CKMAP_SLOTS; ++j)
+    {
+      if (map->mem[i].slots[j].pair != NULL)
+      {
+        it(map->mem[i].slots[j].pair);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < map->stash_len; ++i)
+  {
+    it(map->stash[i].pair);
+  }
+}
+
+bool ckmap_foreach_ctx
+(cuckoo_hash_map const * const map, bool (* it)(void const *, void *), void * ctx)
+{
+  for (size_t i = 0; i < map->buckets; ++i)
+  {
+    for (size_t j = 0; j < CKMAP_SLOTS; ++j)
+    {
+      if (map->mem[i].slots[j].pair != NULL && !it(map->mem[i].slots[j].pair, ctx))
+      {
+        return false;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < map->stash_len; ++i)
+  {
+    if (!it(map->stash[i].pair, ctx))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t ckmap_size
+(cuckoo_hash_map const * const map)
+{
+  return map->len;
+}
+
+size_t ckmap_capacity
+(cuckoo_hash_map const * const map)
+{
+  return map->buckets * CKMAP_SLOTS;
+}
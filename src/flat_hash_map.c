@@ -0,0 +1,412 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flat_hash_map.h"
+#include "block_align.h"
+#include "hmap_group.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each bucket is laid out as the hashcode followed by the key and the value,
+ * each aligned for whatever type has its size.
+ */
+
+static inline
+char * bucket_at
+(flat_hash_map const * const map, char * mem, size_t slot)
+{
+  return mem + slot * map->stride;
+}
+
+static inline
+unsigned long bucket_hash
+(char const * bucket)
+{
+  unsigned long hashcode;
+  memcpy(&hashcode, bucket, sizeof(hashcode));
+  return hashcode;
+}
+
+/**
+ * @param cap - bucket count, must be a power of two and at least HMAP_GROUP_WIDTH
+ * @param out_ctrl - outputs the control bytes of the new buckets
+ *
+ * @return buckets with all control bytes empty or NULL if allocation failed
+ */
+static
+char * alloc_buckets
+(flat_hash_map const * const map, size_t cap, unsigned char ** out_ctrl)
+{
+  char * mem = malloc(cap * map->stride + cap + HMAP_GROUP_WIDTH);
+  if (mem == NULL)
+  {
+    return NULL;
+  }
+
+  *out_ctrl = (unsigned char *) (mem + cap * map->stride);
+  memset(*out_ctrl, HMAP_CTRL_EMPTY, cap + HMAP_GROUP_WIDTH);
+  return mem;
+}
+
+/**
+ * @param ctrl - control bytes being probed
+ * @param cap - capacity of ctrl
+ * @param hashcode - hashcode of the key being placed
+ *
+ * @return empty or deleted slot or HMAP_NPOS if every slot is full
+ */
+static
+size_t probe_vacant
+(unsigned char const * ctrl, size_t const cap, unsigned long const hashcode)
+{
+  size_t const home = hmap_home(hashcode, cap);
+  for (size_t k = 0; k < cap; k += HMAP_GROUP_WIDTH)
+  {
+    size_t const offset = HMAP_PROBE(home, k) & (cap - 1);
+    hmap_group_mask const mask = hmap_group_match_vacant(&ctrl[offset]);
+    if (mask != 0)
+    {
+      return (offset + hmap_mask_first(mask)) & (cap - 1);
+    }
+  }
+  return HMAP_NPOS;
+}
+
+static
+size_t find_bucket
+(flat_hash_map const * restrict const map, void const * restrict key, unsigned long const hashcode)
+{
+  size_t const cap = map->cap;
+  unsigned char const tag = hmap_tag(hashcode);
+  size_t const home = hmap_home(hashcode, cap);
+
+  for (size_t k = 0; k < cap; k += HMAP_GROUP_WIDTH)
+  {
+    size_t const offset = HMAP_PROBE(home, k) & (cap - 1);
+    unsigned char const * group = &map->ctrl[offset];
+
+    /* only look at slots with the same tag */
+    for (hmap_group_mask mask = hmap_group_match(group, tag); mask != 0; mask &= mask - 1)
+    {
+      size_t const slot = (offset + hmap_mask_first(mask)) & (cap - 1);
+      char const * bucket = bucket_at(map, map->mem, slot);
+      if (bucket_hash(bucket) == hashcode && map->key_equal(bucket + map->key_off, key))
+      {
+        return slot;
+      }
+    }
+
+    /* an empty slot ends the probe sequence */
+    if (hmap_group_match_empty(group) != 0)
+    {
+      break;
+    }
+  }
+  return HMAP_NPOS;
+}
+
+static
+size_t buckets_for
+(size_t const n)
+{
+  size_t cap = HMAP_GROUP_WIDTH;
+  while (cap * HMAP_MAX_LOAD < n)
+  {
+    cap *= 2;
+  }
+  return cap;
+}
+
+static
+bool resize_buckets
+(flat_hash_map * const map, size_t const new_cap)
+{
+  unsigned char * new_ctrl;
+  char * new_mem = alloc_buckets(map, new_cap, &new_ctrl);
+  if (new_mem == NULL)
+  {
+    return false;
+  }
+
+  /* hashcodes are stored, so moving buckets never calls the hasher */
+  for (size_t i = 0; i < map->cap; ++i)
+  {
+    if (!(map->ctrl[i] & 0x80))
+    {
+      char const * bucket = bucket_at(map, map->mem, i);
+      unsigned long const hashcode = bucket_hash(bucket);
+      size_t const slot = probe_vacant(new_ctrl, new_cap, hashcode);
+      memcpy(bucket_at(map, new_mem, slot), bucket, map->stride);
+      hmap_set_ctrl(new_ctrl, new_cap, slot, hmap_tag(hashcode));
+    }
+  }
+
+  free(map->mem);
+  map->mem = new_mem;
+  map->ctrl = new_ctrl;
+  map->cap = new_cap;
+  map->dead = 0;
+  map->grow_at = (size_t) (new_cap * HMAP_MAX_LOAD);
+  return true;
+}
+
+static
+bool reserve_one
+(flat_hash_map * const map)
+{
+  if (map->len + 1 > map->grow_at)
+  {
+    return fmap_ensure_capacity(map, map->len + 1);
+  }
+
+  if (map->len + map->dead + 1 > map->grow_at)
+  {
+    /* deleted markers count as load, rebuild without them */
+    return resize_buckets(map, map->cap);
+  }
+
+  return true;
+}
+
+static
+void place_entry
+(flat_hash_map * restrict const map, void const * restrict key, void const * restrict value,
+ unsigned long const hashcode)
+{
+  size_t const slot = probe_vacant(map->ctrl, map->cap, hashcode);
+  if (map->ctrl[slot] == HMAP_CTRL_DELETED)
+  {
+    --map->dead;
+  }
+
+  char * bucket = bucket_at(map, map->mem, slot);
+  memcpy(bucket, &hashcode, sizeof(hashcode));
+  memcpy(bucket + map->key_off, key, map->key_blk);
+  if (map->value_blk > 0)
+  {
+    memcpy(bucket + map->value_off, value, map->value_blk);
+  }
+
+  hmap_set_ctrl(map->ctrl, map->cap, slot, hmap_tag(hashcode));
+  ++map->len;
+}
+
+bool init_fmap
+(flat_hash_map * const map, hash_func * hasher, key_eq * key_equal, size_t key_size, size_t value_size)
+{
+  if (hasher == NULL || key_equal == NULL || key_size == 0)
+  {
+    return false;
+  }
+
+  size_t const key_align = block_align(key_size);
+  size_t const value_align = block_align(value_size);
+  size_t align = block_align(sizeof(unsigned long));
+  if (key_align > align) align = key_align;
+  if (value_align > align) align = value_align;
+
+  map->len = 0;
+  map->cap = 0;
+  map->key_blk = key_size;
+  map->value_blk = value_size;
+  map->key_off = block_round_up(sizeof(unsigned long), key_align);
+  map->value_off = block_round_up(map->key_off + key_size, value_align);
+  map->stride = block_round_up(map->value_off + value_size, align);
+  map->mem = NULL;
+  map->ctrl = NULL;
+  map->hasher = hasher;
+  map->key_equal = key_equal;
+  map->dead = 0;
+  map->grow_at = 0;
+  return true;
+}
+
+void free_fmap
+(flat_hash_map * const map)
+{
+  if (map->cap > 0)
+  {
+    free(map->mem);
+
+    map->len = 0;
+    map->cap = 0;
+    map->mem = NULL;
+    map->ctrl = NULL;
+    map->dead = 0;
+    map->grow_at = 0;
+  }
+}
+
+void fmap_clear
+(flat_hash_map * const map)
+{
+  map->len = 0;
+  map->dead = 0;
+  if (map->cap > 0)
+  {
+    memset(map->ctrl, HMAP_CTRL_EMPTY, map->cap + HMAP_GROUP_WIDTH);
+  }
+}
+
+bool fmap_ensure_capacity
+(flat_hash_map * const map, size_t n)
+{
+  if (map->grow_at >= n)
+  {
+    /* n entries already fit */
+    return true;
+  }
+
+  return resize_buckets(map, buckets_for(HMAP_GROW(n)));
+}
+
+bool fmap_put
+(flat_hash_map * restrict const map, void const * restrict key, void const * restrict value)
+{
+  if (!reserve_one(map))
+  {
+    return false;
+  }
+
+  unsigned long const hashcode = map->hasher(key);
+  size_t const slot = find_bucket(map, key, hashcode);
+  if (slot == HMAP_NPOS)
+  {
+    place_entry(map, key, value, hashcode);
+    return true;
+  }
+
+  /* key already exists, need to update the value */
+  if (map->value_blk > 0)
+  {
+    memcpy(bucket_at(map, map->mem, slot) + map->value_off, value, map->value_blk);
+  }
+  return true;
+}
+
+bool fmap_put_if_absent
+(flat_hash_map * restrict const map, void const * restrict key, void const * restrict value)
+{
+  if (!reserve_one(map))
+  {
+    return false;
+  }
+
+  unsigned long const hashcode = map->hasher(key);
+  if (find_bucket(map, key, hashcode) != HMAP_NPOS)
+  {
+    return false;
+  }
+
+  place_entry(map, key, value, hashcode);
+  return true;
+}
+
+bool fmap_remove
+(flat_hash_map * restrict const map, void const * restrict key)
+{
+  if (map->len < 1)
+  {
+    return false;
+  }
+
+  size_t const slot = find_bucket(map, key, map->hasher(key));
+  if (slot == HMAP_NPOS)
+  {
+    return false;
+  }
+
+  /* mark the slot as deleted so probing continues past it */
+  --map->len;
+  ++map->dead;
+  hmap_set_ctrl(map->ctrl, map->cap, slot, HMAP_CTRL_DELETED);
+  return true;
+}
+
+bool fmap_has_key
+(flat_hash_map const * restrict const map, void const * restrict key)
+{
+  return fmap_get(map, key) != NULL;
+}
+
+void * fmap_get
+(flat_hash_map const * restrict const map, void const * restrict key)
+{
+  if (map->len < 1)
+  {
+    return NULL;
+  }
+
+  size_t const slot = find_bucket(map, key, map->hasher(key));
+  if (slot == HMAP_NPOS)
+  {
+    return NULL;
+  }
+
+  /* with zero sized values, this still points inside the bucket */
+  return bucket_at(map, map->mem, slot) + map->value_off;
+}
+
+void const * fmap_get_or_default
+(flat_hash_map const * restrict const map, void const * key, void const * default_value)
+{
+  void const * ptr = fmap_get(map, key);
+  return ptr == NULL ? default_value : ptr;
+}
+
+void fmap_foreach
+(flat_hash_map const * const map, fmap_it * it)
+{
+  for (size_t i = 0; i < map->cap; ++i)
+  {
+    if (!(map->ctrl[i] & 0x80))
+    {
+      char const * bucket = bucket_at(map, map->mem, i);
+      it(bucket + map->key_off, bucket + map->value_off);
+    }
+  }
+}
+
+bool fmap_foreach_ctx
+(flat_hash_map const * const map, fmap_ctx_it * it, void * ctx)
+{
+  for (size_t i = 0; i < map->cap; ++i)
+  {
+    if (!(map->ctrl[i] & 0x80))
+    {
+      char * bucket = bucket_at(map, map->mem, i);
+      if (!it(bucket + map->key_off, bucket + map->value_off, ctx))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+size_t fmap_size
+(flat_hash_map const * const map)
+{
+  return map->len;
+}
+
+size_t fmap_capacity
+(flat_hash_map const * const map)
+{
+  return map->cap;
+}
@@ -168,6 +168,19 @@ void fwdlist_foreach
   }
 }
 
+bool fwdlist_foreach_ctx
+(forward_list const * const list, bool (* it)(void const *, void *), void * ctx)
+{
+  forward_entry const * entry = list->mem;
+  while (entry != NULL)
+  {
+    forward_entry const * const next = entry->next;
+    if (!it(entry->data, ctx)) return false;
+    entry = next;
+  }
+  return true;
+}
+
 size_t fwdlist_size
 (forward_list const * const list)
 {
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frozen_hash_map.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* average number of keys per bucket, more makes pilots harder to find */
+#define KEYS_PER_BUCKET 4
+
+/* new seeds tried before giving up */
+#define MAX_ATTEMPTS 8
+
+typedef struct fz_key
+{
+  uint64_t hash; /* the map's hashcode mixed with the seed */
+  const void *pair;
+} fz_key;
+
+static inline
+uint64_t mix
+(uint64_t x)
+{
+  x ^= x >> 33;
+  x *= UINT64_C(0xFF51AFD7ED558CCD);
+  x ^= x >> 33;
+  x *= UINT64_C(0xC4CEB9FE1A85EC53);
+  x ^= x >> 33;
+  return x;
+}
+
+/* maps x onto [0, n) using the high bits instead of a division */
+static inline
+size_t reduce
+(uint64_t const x, size_t const n)
+{
+  if (n <= UINT32_MAX)
+  {
+    return (size_t) (((x >> 32) * n) >> 32);
+  }
+  return (size_t) (x % n);
+}
+
+static inline
+size_t slot_of
+(uint64_t const hash, uint32_t const pilot, size_t const len)
+{
+  return reduce(mix(hash ^ (pilot * UINT64_C(0x9E3779B97F4A7C15))), len);
+}
+
+static
+size_t collect_keys
+(hash_map const * restrict const map, fz_key * restrict keys)
+{
+  size_t n = 0;
+  for (size_t i = 0; i < map->cap; ++i)
+  {
+    if (!(map->ctrl[i] & 0x80))
+    {
+      keys[n++] = (fz_key) { map->mem[i].hash, map->mem[i].pair };
+    }
+  }
+  for (size_t i = map->old_pos; i < map->old_cap; ++i)
+  {
+    if (!(map->old_ctrl[i] & 0x80) && map->old_mem[i].pair != NULL)
+    {
+      keys[n++] = (fz_key) { map->old_mem[i].hash, map->old_mem[i].pair };
+    }
+  }
+  return n;
+}
+
+typedef enum place_result
+{
+  PLACED,
+  RESEED, /* a pilot was not found, another seed might work */
+  FAILED /* two keys have the same hashcode or out of memory */
+} place_result;
+
+/**
+ * Finds a pilot for every bucket, largest buckets first while most slots
+ * are still free.
+ *
+ * @param keys - Keys grouped by bucket
+ * @param start - Offset of every bucket in keys, plus the end
+ * @param order - Buckets sorted by decreasing size
+ * @param taken - One flag per slot, all false
+ */
+static
+place_result place_buckets
+(frozen_hash_map * restrict const frozen, fz_key const * restrict keys,
+ size_t const * restrict start, size_t const * restrict order,
+ unsigned char * restrict taken)
+{
+  size_t const len = frozen->len;
+  /* the last keys placed need about len tries, a bit more is bad luck */
+  uint64_t limit = len * UINT64_C(16);
+  limit = limit < (UINT64_C(1) << 20) ? (UINT64_C(1) << 20) : limit;
+  limit = limit > UINT32_MAX ? UINT32_MAX : limit;
+
+  for (size_t i = 0; i < frozen->buckets; ++i)
+  {
+    size_t const b = order[i];
+    size_t const lo = start[b];
+    size_t const hi = start[b + 1];
+    if (lo == hi)
+    {
+      /* buckets are sorted by size, so only empty ones are left */
+      break;
+    }
+
+    for (size_t j = lo; j < hi; ++j)
+    {
+      for (size_t k = lo; k < j; ++k)
+      {
+        if (keys[j].hash == keys[k].hash)
+        {
+          return FAILED;
+        }
+      }
+    }
+
+    uint64_t pilot = 0;
+    for (; pilot < limit; ++pilot)
+    {
+      size_t j = lo;
+      for (; j < hi; ++j)
+      {
+        size_t const slot = slot_of(keys[j].hash, (uint32_t) pilot, len);
+        if (taken[slot])
+        {
+          break;
+        }
+        /* claimed now so the bucket's other keys cannot share it */
+        taken[slot] = 1;
+      }
+      if (j == hi)
+      {
+        break;
+      }
+
+      while (j-- > lo)
+      {
+        taken[slot_of(keys[j].hash, (uint32_t) pilot, len)] = 0;
+      }
+    }
+    if (pilot == limit)
+    {
+      return RESEED;
+    }
+
+    frozen->pilots[b] = (uint32_t) pilot;
+    for (size_t j = lo; j < hi; ++j)
+    {
+      frozen->pairs[slot_of(keys[j].hash, (uint32_t) pilot, len)] = keys[j].pair;
+    }
+  }
+  return PLACED;
+}
+
+/**
+ * Groups the keys by bucket for the current seed and tries to place them.
+ */
+static
+place_result build
+(frozen_hash_map * restrict const frozen, fz_key const * restrict raw,
+ fz_key * restrict keys, size_t * restrict start, size_t * restrict order,
+ unsigned char * restrict taken)
+{
+  size_t const len = frozen->len;
+  size_t const buckets = frozen->buckets;
+
+  memset(start, 0, (buckets + 1) * sizeof(size_t));
+  for (size_t i = 0; i < len; ++i)
+  {
+    ++start[reduce(mix(raw[i].hash ^ frozen->seed), buckets) + 1];
+  }
+
+  size_t max_size = 0;
+  for (size_t b = 0; b < buckets; ++b)
+  {
+    max_size = start[b + 1] > max_size ? start[b + 1] : max_size;
+    start[b + 1] += start[b];
+  }
+
+  /* counting sort by bucket, start[b] is used as a cursor and restored */
+  for (size_t i = 0; i < len; ++i)
+  {
+    uint64_t const hash = mix(raw[i].hash ^ frozen->seed);
+    size_t const b = reduce(hash, buckets);
+    keys[start[b]++] = (fz_key) { hash, raw[i].pair };
+  }
+  memmove(start + 1, start, buckets * sizeof(size_t));
+  start[0] = 0;
+
+  /* counting sort of the buckets by decreasing size */
+  size_t * const by_size = calloc(max_size + 2, sizeof(size_t));
+  if (by_size == NULL)
+  {
+    return FAILED;
+  }
+  for (size_t b = 0; b < buckets; ++b)
+  {
+    ++by_size[max_size - (start[b + 1] - start[b]) + 1];
+  }
+  for (size_t s = 0; s <= max_size; ++s)
+  {
+    by_size[s + 1] += by_size[s];
+  }
+  for (size_t b = 0; b < buckets; ++b)
+  {
+    order[by_size[max_size - (start[b + 1] - start[b])]++] = b;
+  }
+  free(by_size);
+
+  memset(taken, 0, len);
+  return place_buckets(frozen, keys, start, order, taken);
+}
+
+bool hmap_freeze
+(hash_map const * restrict const map, frozen_hash_map * restrict const frozen)
+{
+  size_t const len = map->len;
+  size_t const buckets = len / KEYS_PER_BUCKET + 1;
+
+  frozen->len = len;
+  frozen->buckets = buckets;
+  frozen->seed = UINT64_C(0x2545F4914F6CDD1D);
+  frozen->hasher = map->hasher;
+  frozen->key_equal = map->key_equal;
+  frozen->pairs = malloc(len * sizeof(void *) + buckets * sizeof(uint32_t));
+  if (frozen->pairs == NULL)
+  {
+    return false;
+  }
+  frozen->pilots = (uint32_t *) (frozen->pairs + len);
+  memset(frozen->pilots, 0, buckets * sizeof(uint32_t));
+
+  fz_key * const raw = malloc(len * sizeof(fz_key));
+  fz_key * const keys = malloc(len * sizeof(fz_key));
+  size_t * const start = malloc((buckets + 1) * sizeof(size_t));
+  size_t * const order = malloc(buckets * sizeof(size_t));
+  unsigned char * const taken = malloc(len + 1);
+
+  place_result result = FAILED;
+  if (raw != NULL && keys != NULL && start != NULL && order != NULL && taken != NULL)
+  {
+    collect_keys(map, raw);
+    result = build(frozen, raw, keys, start, order, taken);
+    for (int i = 1; result == RESEED && i < MAX_ATTEMPTS; ++i)
+    {
+      frozen->seed = mix(frozen->seed + i);
+      result = build(frozen, raw, keys, start, order, taken);
+    }
+  }
+
+  free(raw);
+  free(keys);
+  free(start);
+  free(order);
+  free(taken);
+
+  if (result != PLACED)
+  {
+    free_fzmap(frozen);
+    return false;
+  }
+  return true;
+}
+
+void free_fzmap
+(frozen_hash_map * const frozen)
+{
+  free(frozen->pairs);
+
+  frozen->len = 0;
+  frozen->buckets = 0;
+  frozen->pilots = NULL;
+  frozen->pairs = NULL;
+}
+
+void const * fzmap_get
+(frozen_hash_map const * restrict const frozen, void const * restrict key)
+{
+  if (frozen->len < 1)
+  {
+    return NULL;
+  }
+
+  uint64_t const hash = mix(frozen->hasher(key) ^ frozen->seed);
+  uint32_t const pilot = frozen->pilots[reduce(hash, frozen->buckets)];
+  void const * pair = frozen->pairs[slot_of(hash, pilot, frozen->len)];
+  return frozen->key_equal(pair, key) ? pair : NULL;
+}
+
+bool fzmap_has_key
+(frozen_hash_map const * restrict const frozen, void const * restrict key)
+{
+  return fzmap_get(frozen, key) != NULL;
+}
+
+void fzmap_foreach
+(frozen_hash_map const * const frozen, void (* it)(void const *))
+{
+  for (size_t i = 0; i < frozen->len; ++i)
+  {
+    it(frozen->pairs[i]);
+  }
+}
+
+bool fzmap_foreach_ctx
+(frozen_hash_map const * const frozen, bool (* it)(void const *, void *), void * ctx)
+{
+  for (size_t i = 0; i < frozen->len; ++i)
+  {
+    if (!it(frozen->pairs[i], ctx))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t fzmap_size
+(frozen_hash_map const * const frozen)
+{
+  return frozen->len;
+}
@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hash.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+/*
+ * Blocks up to LONG_LEN bytes are hashed like wyhash: 16 bytes (48 once
+ * there are enough) are folded into the state per 64x64->128 multiply.
+ *
+ * Longer blocks are hashed like xxh3: eight 64 bit lanes each accumulate
+ * the 32x32->64 product of the input xored with a secret, one 64 byte stripe
+ * at a time, which maps directly onto SSE2 and AVX2. The lanes are scrambled
+ * after every block of stripes and merged at the end.
+ */
+
+#define LONG_LEN 256
+
+#define ACC_LANES 8
+#define STRIPE_LEN 64
+#define STRIPES_PER_BLOCK 16
+#define BLOCK_LEN (STRIPE_LEN * STRIPES_PER_BLOCK)
+
+/* where the parts of the long hash take their secret words from */
+#define SCRAMBLE_KEY 16
+#define LAST_STRIPE_KEY 7
+#define MERGE_KEY 24
+#define SECRET_WORDS 32
+
+#define PRIME32_1 UINT32_C(0x9E3779B1)
+#define PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+
+static uint64_t const wy_secret[4] =
+{
+  UINT64_C(0x2D358DCCAA6C78A5), UINT64_C(0x8BB84B93962EACC9),
+  UINT64_C(0x4B33A62ED433D4A3), UINT64_C(0x4D5A2DA51DE1AA47),
+};
+
+static uint64_t const long_secret[SECRET_WORDS] =
+{
+  UINT64_C(0x2CB0F69F4ABEA221), UINT64_C(0x9417034723148989),
+  UINT64_C(0xDD555950609DFE03), UINT64_C(0xDBAFB150DEB12800),
+  UINT64_C(0x7E789B2E6C442CB6), UINT64_C(0xF41E5636C7E4F8C4),
+  UINT64_C(0x0959D150F8FBA7E4), UINT64_C(0xA97316F13CDB9EEA),
+  UINT64_C(0x74CD8258F9520068), UINT64_C(0x55C74A62E116868B),
+  UINT64_C(0xD2F4C799A2023CBD), UINT64_C(0xDF98CB79A37B51B9),
+  UINT64_C(0x396F5885524F3905), UINT64_C(0xAF1D56386CA3B276),
+  UINT64_C(0xA9FFBE6B5104E85A), UINT64_C(0x6BD0C51B9FD533B3),
+  UINT64_C(0x980CE91C50AB4B56), UINT64_C(0x28AC395780FE62C5),
+  UINT64_C(0x768912E3A6BCEDC7), UINT64_C(0x50B3E8C9332C7C88),
+  UINT64_C(0xCE3BBFE520BD47DA), UINT64_C(0xCBA6C8E8E0BB7C4F),
+  UINT64_C(0xBF194DB8434A346D), UINT64_C(0x7D8F2A7B60416D7F),
+  UINT64_C(0x0849D1F6E0E10A5E), UINT64_C(0x7654B590D064E22F),
+  UINT64_C(0x16D1DA9507DF3AF2), UINT64_C(0xF63AEF1089EA30E4),
+  UINT64_C(0x9ADE6673CC6C522B), UINT64_C(0x4C75BC274E37087C),
+  UINT64_C(0xD35E12B49F51F27B), UINT64_C(0x22DDF2FFCEE481EA),
+};
+
+/* zero means not picked yet */
+static _Atomic(uint64_t) process_seed;
+
+static inline
+uint64_t read64
+(unsigned char const * p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline
+uint64_t read32
+(unsigned char const * p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline
+uint64_t read_small
+(unsigned char const * p, size_t len)
+{
+  /* 1 to 3 bytes: first, middle and last */
+  return ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+}
+
+static inline
+void mum
+(uint64_t * restrict a, uint64_t * restrict b)
+{
+#if defined(__SIZEOF_INT128__)
+  __uint128_t const r = (__uint128_t) *a * *b;
+  *a = (uint64_t) r;
+  *b = (uint64_t) (r >> 64);
+#else
+  uint64_t const ha = *a >> 32, hb = *b >> 32;
+  uint64_t const la = (uint32_t) *a, lb = (uint32_t) *b;
+  uint64_t const rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t const t = rl + (rm0 << 32);
+  uint64_t carry = t < rl;
+  uint64_t const lo = t + (rm1 << 32);
+  carry += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+static inline
+uint64_t mix
+(uint64_t a, uint64_t b)
+{
+  mum(&a, &b);
+  return a ^ b;
+}
+
+static inline
+uint64_t avalanche
+(uint64_t h)
+{
+  h ^= h >> 37;
+  h *= UINT64_C(0x165667919E3779F9);
+  return h ^ (h >> 32);
+}
+
+static
+uint64_t hash_short
+(unsigned char const * p, size_t const len, uint64_t seed)
+{
+  uint64_t const * s = wy_secret;
+  uint64_t a, b;
+
+  seed ^= mix(seed ^ s[0], s[1]);
+  if (len <= 16)
+  {
+    if (len >= 4)
+    {
+      /* two overlapping reads from each end */
+      size_t const mid = (len >> 3) << 2;
+      a = (read32(p) << 32) | read32(p + mid);
+      b = (read32(p + len - 4) << 32) | read32(p + len - 4 - mid);
+    }
+    else if (len > 0)
+    {
+      a = read_small(p, len);
+      b = 0;
+    }
+    else
+    {
+      a = b = 0;
+    }
+  }
+  else
+  {
+    size_t i = len;
+    if (i > 48)
+    {
+      uint64_t see1 = seed, see2 = seed;
+      do
+      {
+        seed = mix(read64(p) ^ s[1], read64(p + 8) ^ seed);
+        see1 = mix(read64(p + 16) ^ s[2], read64(p + 24) ^ see1);
+        see2 = mix(read64(p + 32) ^ s[3], read64(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      }
+      while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+
+    while (i > 16)
+    {
+      seed = mix(read64(p) ^ s[1], read64(p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+
+    /* last 16 bytes, may overlap with the ones already mixed */
+    a = read64(p + i - 16);
+    b = read64(p + i - 8);
+  }
+
+  a ^= s[1];
+  b ^= seed;
+  mum(&a, &b);
+  return mix(a ^ s[0] ^ len, b ^ s[1]);
+}
+
+#if defined(__AVX2__)
+
+static
+void accumulate
+(uint64_t * restrict acc, unsigned char const * restrict p, size_t const stripes,
+ uint64_t const * restrict key)
+{
+  __m256i a0 = _mm256_loadu_si256((__m256i const *) acc);
+  __m256i a1 = _mm256_loadu_si256((__m256i const *) acc + 1);
+  for (size_t s = 0; s < stripes; ++s, p += STRIPE_LEN)
+  {
+    __m256i * const lanes[2] = { &a0, &a1 };
+    for (size_t i = 0; i < 2; ++i)
+    {
+      __m256i const data = _mm256_loadu_si256((__m256i const *) p + i);
+      __m256i const k = _mm256_loadu_si256((__m256i const *) (key + s) + i);
+      __m256i const data_key = _mm256_xor_si256(data, k);
+      __m256i const data_key_hi = _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+      __m256i const product = _mm256_mul_epu32(data_key, data_key_hi);
+      __m256i const swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+      *lanes[i] = _mm256_add_epi64(*lanes[i], _mm256_add_epi64(product, swapped));
+    }
+  }
+  _mm256_storeu_si256((__m256i *) acc, a0);
+  _mm256_storeu_si256((__m256i *) acc + 1, a1);
+}
+
+static
+void scramble
+(uint64_t * restrict acc, uint64_t const * restrict key)
+{
+  __m256i const prime = _mm256_set1_epi32((int) PRIME32_1);
+  for (size_t i = 0; i < 2; ++i)
+  {
+    __m256i a = _mm256_loadu_si256((__m256i const *) acc + i);
+    a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+    a = _mm256_xor_si256(a, _mm256_loadu_si256((__m256i const *) key + i));
+
+    __m256i const lo = _mm256_mul_epu32(a, prime);
+    __m256i const hi = _mm256_mul_epu32(_mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+    _mm256_storeu_si256((__m256i *) acc + i, _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+  }
+}
+
+#elif defined(USE_SSE2)
+
+static
+void accumulate
+(uint64_t * restrict acc, unsigned char const * restrict p, size_t const stripes,
+ uint64_t const * restrict key)
+{
+  __m128i a[ACC_LANES / 2];
+  for (size_t i = 0; i < ACC_LANES / 2; ++i)
+  {
+    a[i] = _mm_loadu_si128((__m128i const *) acc + i);
+  }
+
+  for (size_t s = 0; s < stripes; ++s, p += STRIPE_LEN)
+  {
+    for (size_t i = 0; i < ACC_LANES / 2; ++i)
+    {
+      __m128i const data = _mm_loadu_si128((__m128i const *) p + i);
+      __m128i const k = _mm_loadu_si128((__m128i const *) (key + s) + i);
+      __m128i const data_key = _mm_xor_si128(data, k);
+      __m128i const data_key_hi = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+      __m128i const product = _mm_mul_epu32(data_key, data_key_hi);
+      __m128i const swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+      a[i] = _mm_add_epi64(a[i], _mm_add_epi64(product, swapped));
+    }
+  }
+
+  for (size_t i = 0; i < ACC_LANES / 2; ++i)
+  {
+    _mm_storeu_si128((__m128i *) acc + i, a[i]);
+  }
+}
+
+static
+void scramble
+(uint64_t * restrict acc, uint64_t const * restrict key)
+{
+  __m128i const prime = _mm_set1_epi32((int) PRIME32_1);
+  for (size_t i = 0; i < ACC_LANES / 2; ++i)
+  {
+    __m128i a = _mm_loadu_si128((__m128i const *) acc + i);
+    a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+    a = _mm_xor_si128(a, _mm_loadu_si128((__m128i const *) key + i));
+
+    __m128i const lo = _mm_mul_epu32(a, prime);
+    __m128i const hi = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+    _mm_storeu_si128((__m128i *) acc + i, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+  }
+}
+
+#else
+
+static
+void accumulate
+(uint64_t * restrict acc, unsigned char const * restrict p, size_t const stripes,
+ uint64_t const * restrict key)
+{
+  for (size_t s = 0; s < stripes; ++s, p += STRIPE_LEN)
+  {
+    for (size_t i = 0; i < ACC_LANES; ++i)
+    {
+      uint64_t const data = read64(p + 8 * i);
+      uint64_t const data_key = data ^ key[s + i];
+      acc[i ^ 1] += data;
+      acc[i] += (data_key & UINT32_MAX) * (data_key >> 32);
+    }
+  }
+}
+
+static
+void scramble
+(uint64_t * restrict acc, uint64_t const * restrict key)
+{
+  for (size_t i = 0; i < ACC_LANES; ++i)
+  {
+    uint64_t a = acc[i];
+    a ^= a >> 47;
+    a ^= key[i];
+    acc[i] = a * PRIME32_1;
+  }
+}
+
+#endif
+
+static
+uint64_t hash_long
+(unsigned char const * p, size_t const len, uint64_t const seed)
+{
+  uint64_t key[SECRET_WORDS];
+  for (size_t i = 0; i < SECRET_WORDS; ++i)
+  {
+    key[i] = i & 1 ? long_secret[i] - seed : long_secret[i] + seed;
+  }
+
+  uint64_t acc[ACC_LANES] =
+  {
+    PRIME32_1, PRIME64_1, UINT64_C(0xC2B2AE3D27D4EB4F), UINT64_C(0x165667B19E3779F9),
+    UINT64_C(0x85EBCA77C2B2AE63), UINT32_C(0x85EBCA77), UINT64_C(0x27D4EB2F165667C5), UINT32_C(0xC2B2AE3D),
+  };
+
+  /* the last stripe is always handled separately, even if it is complete */
+  size_t const blocks = (len - 1) / BLOCK_LEN;
+  for (size_t b = 0; b < blocks; ++b)
+  {
+    accumulate(acc, p + b * BLOCK_LEN, STRIPES_PER_BLOCK, key);
+    scramble(acc, key + SCRAMBLE_KEY);
+  }
+
+  size_t const stripes = (len - 1 - blocks * BLOCK_LEN) / STRIPE_LEN;
+  accumulate(acc, p + blocks * BLOCK_LEN, stripes, key);
+  accumulate(acc, p + len - STRIPE_LEN, 1, key + LAST_STRIPE_KEY);
+
+  uint64_t h = len * PRIME64_1;
+  for (size_t i = 0; i < ACC_LANES; i += 2)
+  {
+    h += mix(acc[i] ^ key[MERGE_KEY + i], acc[i + 1] ^ key[MERGE_KEY + i + 1]);
+  }
+  return avalanche(h);
+}
+
+static
+uint64_t random_seed
+(void)
+{
+  uint64_t seed = 0;
+  FILE * f = fopen("/dev/urandom", "rb");
+  if (f != NULL)
+  {
+    if (fread(&seed, sizeof(seed), 1, f) != 1)
+    {
+      seed = 0;
+    }
+    fclose(f);
+  }
+
+  if (seed == 0)
+  {
+    /* no random device, the clocks and the address space layout will do */
+    int local;
+    seed = mix((uint64_t) time(NULL) ^ wy_secret[0], (uint64_t) clock() ^ wy_secret[1]);
+    seed = mix(seed ^ (uint64_t) (uintptr_t) &local, (uint64_t) (uintptr_t) &process_seed ^ wy_secret[2]);
+  }
+
+  return seed == 0 ? PRIME64_1 : seed;
+}
+
+uint64_t hash_seed
+(void)
+{
+  uint64_t seed = atomic_load_explicit(&process_seed, memory_order_relaxed);
+  if (seed != 0)
+  {
+    return seed;
+  }
+
+  /* if another thread got there first, use its seed */
+  uint64_t expected = 0;
+  seed = random_seed();
+  if (!atomic_compare_exchange_strong(&process_seed, &expected, seed))
+  {
+    return expected;
+  }
+  return seed;
+}
+
+bool hash_set_seed
+(uint64_t seed)
+{
+  if (seed == 0)
+  {
+    return false;
+  }
+
+  atomic_store(&process_seed, seed);
+  return true;
+}
+
+uint64_t hash_u32
+(uint32_t value)
+{
+  return hash_u64(value);
+}
+
+uint64_t hash_u64
+(uint64_t value)
+{
+  uint64_t h = value ^ hash_seed();
+  h ^= h >> 32;
+  h *= UINT64_C(0xD6E8FEB86659FD93);
+  h ^= h >> 32;
+  h *= UINT64_C(0xD6E8FEB86659FD93);
+  return h ^ (h >> 32);
+}
+
+uint64_t hash_bytes
+(void const * data, size_t len)
+{
+  return hash_bytes_seeded(data, len, hash_seed());
+}
+
+uint64_t hash_bytes_seeded
+(void const * data, size_t len, uint64_t seed)
+{
+  return len <= LONG_LEN ? hash_short(data, len, seed) : hash_long(data, len, seed);
+}
+
+uint64_t hash_str
+(char const * str)
+{
+  return hash_bytes(str, strlen(str));
+}
+
+unsigned long hash_key_u32
+(void const * key)
+{
+  return hash_u32(*(uint32_t const *) key);
+}
+
+bool equal_key_u32
+(void const * a, void const * b)
+{
+  return *(uint32_t const *) a == *(uint32_t const *) b;
+}
+
+unsigned long hash_key_u64
+(void const * key)
+{
+  return hash_u64(*(uint64_t const *) key);
+}
+
+bool equal_key_u64
+(void const * a, void const * b)
+{
+  return *(uint64_t const *) a == *(uint64_t const *) b;
+}
+
+unsigned long hash_key_ptr
+(void const * key)
+{
+  return hash_u64((uintptr_t) *(void const * const *) key);
+}
+
+bool equal_key_ptr
+(void const * a, void const * b)
+{
+  return *(void const * const *) a == *(void const * const *) b;
+}
+
+unsigned long hash_key_str
+(void const * key)
+{
+  return hash_str(*(char const * const *) key);
+}
+
+bool equal_key_str
+(void const * a, void const * b)
+{
+  return strcmp(*(char const * const *) a, *(char const * const *) b) == 0;
+}
+
+unsigned long hash_cstr
+(void const * str)
+{
+  return hash_str(str);
+}
+
+bool equal_cstr
+(void const * a, void const * b)
+{
+  return strcmp(a, b) == 0;
+}
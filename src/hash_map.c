@@ -15,323 +15,1345 @@
  */
 
 #include "hash_map.h"
+#include "hmap_group.h"
+#include "hmap_internal.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* probes resolved together by the batched lookups */
+#define BATCH_SIZE 16
+
+/* below this many buckets, the table is assumed to stay in cache */
+#define BATCH_MIN_CAP 262144
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(addr) __builtin_prefetch((addr))
+#else
+#define PREFETCH(addr) ((void) (addr))
+#endif
+
+static inline
+size_t rh_distance
+(map_entry const * mem, unsigned char const * ctrl, size_t cap, size_t slot)
+{
+  if (ctrl[slot] < HMAP_CTRL_FAR)
+  {
+    return ctrl[slot];
+  }
+
+  /* saturated, recompute from the hashcode */
+  return (slot + cap - hmap_home(mem[slot].hash, cap)) & (cap - 1);
+}
+
+/**
+ * Locates where a pair would be placed by robin hood insertion: the first
+ * slot with a pair closer to its home than the new pair would be.
+ *
+ * @param mem - buckets being probed, must have at least one empty slot
+ * @param ctrl - control bytes of mem
+ * @param cap - capacity of mem
+ * @param hashcode - hashcode of the pair being placed
+ * @param out_slot - outputs the slot
+ * @param out_dist - outputs the probe distance of the new pair
+ *
+ * @return longest probe distance among the pairs moved by the insertion
+ */
+static
+size_t rh_locate
+(map_entry const * restrict mem, unsigned char const * restrict ctrl, size_t const cap,
+ unsigned long const hashcode, size_t * restrict out_slot, size_t * restrict out_dist)
+{
+  size_t slot = hmap_home(hashcode, cap);
+  size_t dist = 0;
+  while (ctrl[slot] != HMAP_CTRL_EMPTY && rh_distance(mem, ctrl, cap, slot) >= dist)
+  {
+    slot = (slot + 1) & (cap - 1);
+    ++dist;
+  }
+
+  *out_slot = slot;
+  *out_dist = dist;
+
+  /* everything up to the next empty slot is pushed back by one */
+  size_t longest = dist;
+  for (; ctrl[slot] != HMAP_CTRL_EMPTY; slot = (slot + 1) & (cap - 1))
+  {
+    size_t const moved = rh_distance(mem, ctrl, cap, slot) + 1;
+    if (moved > longest)
+    {
+      longest = moved;
+    }
+  }
+  return longest;
+}
+
+/**
+ * Places a pair at the slot found by rh_locate, shifting the following pairs
+ * back by one.
+ */
+static
+void rh_shift_in
+(map_entry * restrict mem, unsigned char * restrict ctrl, size_t const cap,
+ size_t slot, size_t dist, unsigned long const hashcode, void const * pair)
+{
+  map_entry carry = { hashcode, pair };
+  while (ctrl[slot] != HMAP_CTRL_EMPTY)
+  {
+    size_t const next_dist = rh_distance(mem, ctrl, cap, slot) + 1;
+    map_entry const tmp = mem[slot];
+    mem[slot] = carry;
+    hmap_set_ctrl(ctrl, cap, slot, hmap_rh_ctrl(dist));
+
+    carry = tmp;
+    dist = next_dist;
+    slot = (slot + 1) & (cap - 1);
+  }
+
+  mem[slot] = carry;
+  hmap_set_ctrl(ctrl, cap, slot, hmap_rh_ctrl(dist));
+}
+
+map_entry * hmap_alloc_buckets
+(size_t cap, unsigned char ** out_ctrl)
+{
+  map_entry * mem = malloc(cap * sizeof(map_entry) + cap + HMAP_GROUP_WIDTH);
+  if (mem == NULL)
+  {
+    return NULL;
+  }
+
+  *out_ctrl = (unsigned char *) (mem + cap);
+  memset(*out_ctrl, HMAP_CTRL_EMPTY, cap + HMAP_GROUP_WIDTH);
+  return mem;
+}
+
+/**
+ * @param ctrl - control bytes being probed
+ * @param cap - capacity of ctrl
+ * @param hashcode - hashcode of the pair being placed
+ *
+ * @return empty or deleted slot or HMAP_NPOS if every slot is full
+ */
+static
+size_t probe_vacant
+(unsigned char const * ctrl, size_t const cap, unsigned long const hashcode)
+{
+  size_t const home = hmap_home(hashcode, cap);
+  for (size_t k = 0; k < cap; k += HMAP_GROUP_WIDTH)
+  {
+    size_t const offset = HMAP_PROBE(home, k) & (cap - 1);
+    hmap_group_mask const mask = hmap_group_match_vacant(&ctrl[offset]);
+    if (mask != 0)
+    {
+      return (offset + hmap_mask_first(mask)) & (cap - 1);
+    }
+  }
+  return HMAP_NPOS;
+}
+
+/**
+ * Places a pair without checking for duplicate keys or load
+ *
+ * @param mem - bucket destination
+ * @param ctrl - control bytes of mem
+ * @param cap - capacity of mem
+ * @param flags - flags of the map, decides how pairs are placed
+ * @param hashcode - hashcode of pair
+ * @param pair - pair being placed
+ *
+ * @return true if a slot marked as deleted was reused
+ */
+static
+bool insert_entry
+(map_entry * restrict mem, unsigned char * restrict ctrl, size_t const cap,
+ unsigned const flags, unsigned long const hashcode, void const * pair)
+{
+  if (flags & HMAP_ROBIN_HOOD)
+  {
+    size_t slot, dist;
+    rh_locate(mem, ctrl, cap, hashcode, &slot, &dist);
+    rh_shift_in(mem, ctrl, cap, slot, dist, hashcode, pair);
+    return false;
+  }
+
+  size_t const slot = probe_vacant(ctrl, cap, hashcode);
+  bool const reused = ctrl[slot] == HMAP_CTRL_DELETED;
+
+  mem[slot].hash = hashcode;
+  mem[slot].pair = pair;
+  hmap_set_ctrl(ctrl, cap, slot, hmap_tag(hashcode));
+  return reused;
+}
+
+/**
+ * @param dst - bucket destination
+ * @param dst_ctrl - control bytes of dst
+ * @param dst_cap - capacity of dst
+ * @param src - bucket source
+ * @param src_ctrl - control bytes of src
+ * @param src_cap - capacity of src
+ * @param hasher - hash function, use old hashcode if NULL
+ * @param flags - flags of the map, decides how pairs are placed
+ *
+ * @return number of pairs moved
+ */
+static
+size_t rehash_move
+(map_entry * restrict dst, unsigned char * restrict dst_ctrl, size_t const dst_cap,
+ map_entry const * restrict src, unsigned char const * restrict src_ctrl, size_t const src_cap,
+ hash_func * const hasher, unsigned const flags)
+{
+  if (dst_cap < 1) return 0;
+
+  size_t moved = 0;
+  for (size_t i = 0; i < src_cap; ++i)
+  {
+    if (src_ctrl[i] & 0x80)
+    {
+      /* slot is vacant */
+      continue;
+    }
+
+    void const * pair = src[i].pair;
+    unsigned long const hashcode = hasher == NULL ? src[i].hash : hasher(pair);
+    insert_entry(dst, dst_ctrl, dst_cap, flags, hashcode, pair);
+    ++moved;
+  }
+  return moved;
+}
+
+/*
+ * The find functions also work on buckets being migrated by an incremental
+ * resize: migrated slots keep their control byte but have a NULL pair, so
+ * probe sequences running through them stay intact.
+ */
+
+static
+size_t group_find
+(hash_map const * map, map_entry const * mem, unsigned char const * ctrl, size_t const cap,
+ void const * restrict pair, unsigned long const hashcode)
+{
+  unsigned char const tag = hmap_tag(hashcode);
+  size_t const home = hmap_home(hashcode, cap);
+
+  for (size_t k = 0; k < cap; k += HMAP_GROUP_WIDTH)
+  {
+    size_t const offset = HMAP_PROBE(home, k) & (cap - 1);
+    unsigned char const * group = &ctrl[offset];
+
+    /* only look at slots with the same tag */
+    for (hmap_group_mask mask = hmap_group_match(group, tag); mask != 0; mask &= mask - 1)
+    {
+      size_t const slot = (offset + hmap_mask_first(mask)) & (cap - 1);
+      map_entry const * ent = &mem[slot];
+      if (ent->hash == hashcode && ent->pair != NULL)
+      {
+        HMAP_STAT_ADD(map, key_equal_calls, 1);
+        if (map->key_equal(ent->pair, pair))
+        {
+          return slot;
+        }
+      }
+    }
+
+    /* an empty slot ends the probe sequence */
+    if (hmap_group_match_empty(group) != 0)
+    {
+      break;
+    }
+  }
+  return HMAP_NPOS;
+}
+
+static
+size_t rh_find
+(hash_map const * map, map_entry const * mem, unsigned char const * ctrl, size_t const cap,
+ void const * restrict pair, unsigned long const hashcode)
+{
+  size_t slot = hmap_home(hashcode, cap);
+
+  for (size_t dist = 0; dist < cap; ++dist)
+  {
+    /*
+     * stop at an empty slot or at a pair closer to its home than the key
+     * would be: insertion would have placed the key before it
+     */
+    if (ctrl[slot] == HMAP_CTRL_EMPTY || rh_distance(mem, ctrl, cap, slot) < dist)
+    {
+      break;
+    }
+
+    map_entry const * ent = &mem[slot];
+    if (ent->hash == hashcode && ent->pair != NULL)
+    {
+      HMAP_STAT_ADD(map, key_equal_calls, 1);
+      if (map->key_equal(ent->pair, pair))
+      {
+        return slot;
+      }
+    }
+
+    slot = (slot + 1) & (cap - 1);
+  }
+  return HMAP_NPOS;
+}
+
+/**
+ * @param map - this pointer
+ * @param pair - search by key
+ * @param hashcode - hashcode of pair
+ *
+ * @return slot with the same key or HMAP_NPOS if no such slot exists
+ */
+static inline
+size_t find_bucket
+(hash_map const * restrict const map, void const * restrict pair, unsigned long const hashcode)
+{
+  if (map->flags & HMAP_ROBIN_HOOD)
+  {
+    return rh_find(map, map->mem, map->ctrl, map->cap, pair, hashcode);
+  }
+  return group_find(map, map->mem, map->ctrl, map->cap, pair, hashcode);
+}
+
+/**
+ * Same as find_bucket but searches the buckets being migrated
+ *
+ * @return slot in old_mem with the same key or HMAP_NPOS if no such slot exists
+ */
+static inline
+size_t find_old_bucket
+(hash_map const * restrict const map, void const * restrict pair, unsigned long const hashcode)
+{
+  if (map->old_mem == NULL)
+  {
+    return HMAP_NPOS;
+  }
+
+  if (map->flags & HMAP_ROBIN_HOOD)
+  {
+    return rh_find(map, map->old_mem, map->old_ctrl, map->old_cap, pair, hashcode);
+  }
+  return group_find(map, map->old_mem, map->old_ctrl, map->old_cap, pair, hashcode);
+}
+
+size_t hmap_buckets_for
+(hash_map const * const map, size_t const n)
+{
+  size_t cap = HMAP_GROUP_WIDTH;
+  while (cap * map->policy.max_load < n)
+  {
+    cap *= 2;
+  }
+  return cap;
+}
+
+static
+void update_thresholds
+(hash_map * const map)
+{
+  map->grow_at = (size_t) (map->cap * map->policy.max_load);
+  map->shrink_at = (size_t) (map->cap * map->policy.min_load);
+}
+
+/**
+ * Moves pairs from the buckets being migrated into the current buckets
+ *
+ * @param map - this pointer
+ * @param n - maximum number of buckets to migrate
+ */
+static
+void migrate_step
+(hash_map * const map, size_t const n)
+{
+  if (map->old_mem == NULL)
+  {
+    return;
+  }
+
+  size_t const end = map->old_cap - map->old_pos > n ? map->old_pos + n : map->old_cap;
+  for (size_t i = map->old_pos; i < end; ++i)
+  {
+    map_entry * ent = &map->old_mem[i];
+    if (!(map->old_ctrl[i] & 0x80) && ent->pair != NULL)
+    {
+      if (insert_entry(map->mem, map->ctrl, map->cap, map->flags, ent->hash, ent->pair))
+      {
+        --map->dead;
+      }
+
+      /* control byte stays so lookups can still probe past it */
+      ent->pair = NULL;
+      HMAP_STAT_ADD(map, bytes_moved, sizeof(map_entry));
+    }
+  }
+  map->old_pos = end;
+
+  if (end == map->old_cap)
+  {
+    /* every pair has been moved */
+    free(map->old_mem);
+    map->old_mem = NULL;
+    map->old_ctrl = NULL;
+    map->old_cap = 0;
+    map->old_pos = 0;
+  }
+}
+
+/**
+ * Replaces the buckets with a new set of buckets, dropping deleted markers.
+ * Incremental maps keep the current buckets around and migrate them bit by
+ * bit unless a new hash function is being applied.
+ *
+ * @param map - this pointer
+ * @param new_cap - new capacity, must be a power of two and at least
+ *                  HMAP_GROUP_WIDTH
+ * @param hasher - hash function, use old hashcode if NULL
+ *
+ * @return true if buckets were able to be allocated successfully
+ */
+static
+bool resize_buckets
+(hash_map * const map, size_t const new_cap, hash_func * const hasher)
+{
+  unsigned char * new_ctrl;
+  map_entry * new_mem = hmap_alloc_buckets(new_cap, &new_ctrl);
+  if (new_mem == NULL)
+  {
+    return false;
+  }
+
+  /* only one migration at a time */
+  migrate_step(map, map->old_cap);
+  HMAP_STAT_ADD(map, resizes, 1);
+
+  if ((map->flags & HMAP_INCREMENTAL) && hasher == NULL && map->len > 0)
+  {
+    map->old_mem = map->mem;
+    map->old_ctrl = map->ctrl;
+    map->old_cap = map->cap;
+    map->old_pos = 0;
+  }
+  else
+  {
+    size_t const moved = rehash_move(new_mem, new_ctrl, new_cap, map->mem, map->ctrl, map->cap,
+                                     hasher, map->flags);
+    free(map->mem);
+    HMAP_STAT_ADD(map, bytes_moved, moved * sizeof(map_entry));
+    HMAP_STAT_ADD(map, hasher_calls, hasher == NULL ? 0 : moved);
+  }
+
+  map->cap = new_cap;
+  map->mem = new_mem;
+  map->ctrl = new_ctrl;
+  map->dead = 0;
+  update_thresholds(map);
+  return true;
+}
+
+/**
+ * Makes sure one more pair can be placed into the map
+ *
+ * @param map - this pointer
+ *
+ * @return true if there is room for one more pair
+ */
+static
+bool reserve_one
+(hash_map * const map)
+{
+  if (map->len + 1 > map->grow_at)
+  {
+    return hmap_ensure_capacity(map, map->len + 1);
+  }
+
+  if (map->len + map->dead + 1 > map->grow_at)
+  {
+    /* deleted markers count as load, rebuild without them */
+    return resize_buckets(map, map->cap, NULL);
+  }
+
+  return true;
+}
+
+/**
+ * Shrinks the buckets if the size dropped under the minimum load factor
+ *
+ * @param map - this pointer
+ */
+static
+void maybe_shrink
+(hash_map * const map)
+{
+  if (map->len < map->shrink_at)
+  {
+    size_t const new_cap = hmap_buckets_for(map, map->len);
+    if (new_cap < map->cap)
+    {
+      /* if this fails, the current buckets are still usable */
+      resize_buckets(map, new_cap, NULL);
+    }
+  }
+}
+
+/**
+ * @param map - this pointer
+ * @param pair - pair being placed, must not have the same key as any
+ *               existing pair
+ * @param hashcode - hashcode of pair
+ *
+ * @return true if pair was placed, false if map needed to grow but failed
+ */
+static
+bool place_pair
+(hash_map * restrict const map, void const * restrict pair, unsigned long const hashcode)
+{
+  if (map->flags & HMAP_ROBIN_HOOD)
+  {
+    size_t slot, dist;
+    size_t const longest = rh_locate(map->mem, map->ctrl, map->cap, hashcode, &slot, &dist);
+    if (longest > HMAP_MAX_PROBE && map->len >= map->cap / 8)
+    {
+      /* probe sequences are getting too long, spread the pairs out */
+      if (!resize_buckets(map, map->cap * 2, NULL))
+      {
+        return false;
+      }
+      rh_locate(map->mem, map->ctrl, map->cap, hashcode, &slot, &dist);
+    }
+
+    rh_shift_in(map->mem, map->ctrl, map->cap, slot, dist, hashcode, pair);
+    ++map->len;
+    return true;
+  }
+
+  if (insert_entry(map->mem, map->ctrl, map->cap, map->flags, hashcode, pair))
+  {
+    --map->dead;
+  }
+  ++map->len;
+  return true;
+}
+
+bool hmap_put_hashed
+(hash_map * restrict const map, void const * restrict pair, unsigned long const hashcode)
+{
+  size_t const slot = find_bucket(map, pair, hashcode);
+  if (slot != HMAP_NPOS)
+  {
+    map->mem[slot].pair = pair;
+    return true;
+  }
+  return place_pair(map, pair, hashcode);
+}
+
+void hmap_adopt_buckets
+(hash_map * const map, map_entry * const mem, unsigned char * const ctrl, size_t const cap,
+ size_t const len)
+{
+  free(map->mem);
+  map->mem = mem;
+  map->ctrl = ctrl;
+  map->cap = cap;
+  map->len = len;
+  map->dead = 0;
+  update_thresholds(map);
+}
+
+/**
+ * @param map - this pointer
+ * @param slot - full slot being vacated
+ */
+static
+void vacate_slot
+(hash_map * const map, size_t slot)
+{
+  size_t const cap = map->cap;
+  --map->len;
+
+  if (!(map->flags & HMAP_ROBIN_HOOD))
+  {
+    /* mark the slot as deleted so probing continues past it */
+    map->mem[slot].pair = NULL;
+    hmap_set_ctrl(map->ctrl, cap, slot, HMAP_CTRL_DELETED);
+    ++map->dead;
+    return;
+  }
+
+  /* shift the following pairs towards their home until one is at home */
+  size_t next = (slot + 1) & (cap - 1);
+  while (map->ctrl[next] != HMAP_CTRL_EMPTY)
+  {
+    size_t const dist = rh_distance(map->mem, map->ctrl, cap, next);
+    if (dist == 0)
+    {
+      break;
+    }
+
+    map->mem[slot] = map->mem[next];
+    hmap_set_ctrl(map->ctrl, cap, slot, hmap_rh_ctrl(dist - 1));
+    slot = next;
+    next = (next + 1) & (cap - 1);
+  }
+
+  map->mem[slot].pair = NULL;
+  hmap_set_ctrl(map->ctrl, cap, slot, HMAP_CTRL_EMPTY);
+}
+
+bool init_hmap
+(hash_map * const map, hash_func * hasher, key_eq * key_equal)
+{
+  return init_hmap_flags(map, hasher, key_equal, 0);
+}
+
+bool init_hmap_flags
+(hash_map * const map, hash_func * hasher, key_eq * key_equal, unsigned flags)
+{
+  if (hasher == NULL || key_equal == NULL)
+  {
+    return false;
+  }
+
+  map->len = 0;
+  map->cap = 0;
+  map->mem = NULL;
+  map->hasher = hasher;
+  map->key_equal = key_equal;
+  map->dead = 0;
+  map->ctrl = NULL;
+  map->flags = flags;
+  map->grow_at = 0;
+  map->shrink_at = 0;
+  map->policy.max_load = HMAP_MAX_LOAD;
+  map->policy.min_load = HMAP_MIN_LOAD;
+  map->old_mem = NULL;
+  map->old_ctrl = NULL;
+  map->old_cap = 0;
+  map->old_pos = 0;
+  memset(&map->counters, 0, sizeof(map->counters));
+  return true;
+}
+
+void free_hmap
+(hash_map * const map)
+{
+  if (map->cap > 0)
+  {
+    free(map->mem);
+    free(map->old_mem);
+
+    map->len = 0;
+    map->cap = 0;
+    map->mem = NULL;
+    map->hasher = NULL;
+    map->dead = 0;
+    map->ctrl = NULL;
+    map->grow_at = 0;
+    map->shrink_at = 0;
+    map->old_mem = NULL;
+    map->old_ctrl = NULL;
+    map->old_cap = 0;
+    map->old_pos = 0;
+  }
+}
+
+void hmap_clear
+(hash_map * const map)
+{
+  map->len = 0;
+  map->dead = 0;
+  if (map->cap > 0)
+  {
+    memset(map->ctrl, HMAP_CTRL_EMPTY, map->cap + HMAP_GROUP_WIDTH);
+  }
+
+  /* nothing left to migrate */
+  free(map->old_mem);
+  map->old_mem = NULL;
+  map->old_ctrl = NULL;
+  map->old_cap = 0;
+  map->old_pos = 0;
+}
+
+bool hmap_ensure_capacity
+(hash_map * const map, size_t n)
+{
+  if (map->grow_at >= n)
+  {
+    /* n pairs already fit */
+    return true;
+  }
+
+  return resize_buckets(map, hmap_buckets_for(map, HMAP_GROW(n)), NULL);
+}
+
+bool hmap_set_policy
+(hash_map * restrict const map, hmap_policy const * restrict policy)
+{
+  hmap_policy const fallback = { HMAP_MAX_LOAD, HMAP_MIN_LOAD };
+  if (policy == NULL)
+  {
+    policy = &fallback;
+  }
+
+  /* shrinking must not leave the map right on the growth threshold */
+  if (!(policy->max_load > 0 && policy->max_load <= 1)
+    || !(policy->min_load >= 0 && policy->min_load < policy->max_load / 2))
+  {
+    return false;
+  }
+
+  map->policy = *policy;
+  if (map->cap > 0)
+  {
+    update_thresholds(map);
+  }
+  return true;
+}
+
+bool hmap_put
+(hash_map * restrict const map, void const * restrict pair, void const ** restrict repl)
+{
+  if (pair == NULL)
+  {
+    /* insert null pair does nothing */
+    return true;
+  }
+
+  migrate_step(map, HMAP_MIGRATE_STEP);
+  if (!reserve_one(map))
+  {
+    return false;
+  }
+
+  unsigned long const hashcode = map->hasher(pair);
+  HMAP_STAT_ADD(map, hasher_calls, 1);
+  map_entry * ent;
+
+  size_t slot = find_bucket(map, pair, hashcode);
+  if (slot != HMAP_NPOS)
+  {
+    ent = &map->mem[slot];
+  }
+  else if ((slot = find_old_bucket(map, pair, hashcode)) != HMAP_NPOS)
+  {
+    /* replace it where it is, it will be migrated later */
+    ent = &map->old_mem[slot];
+  }
+  else
+  {
+    /* one less empty slot */
+    return place_pair(map, pair, hashcode);
+  }
+
+  if (repl != NULL)
+  {
+    /*
+     * slot was occupied with the same key.
+     * save overwrite if repl != NULL
+     */
+    *repl = ent->pair;
+  }
+
+  ent->pair = pair;
+  return true;
+}
+
+bool hmap_put_if_absent
+(hash_map * restrict const map, void const * restrict pair)
+{
+  if (pair == NULL)
+  {
+    /* insert null pair does nothing */
+    return true;
+  }
+
+  migrate_step(map, HMAP_MIGRATE_STEP);
+  if (!reserve_one(map))
+  {
+    return false;
+  }
+
+  unsigned long const hashcode = map->hasher(pair);
+  HMAP_STAT_ADD(map, hasher_calls, 1);
+  if (find_bucket(map, pair, hashcode) == HMAP_NPOS
+    && find_old_bucket(map, pair, hashcode) == HMAP_NPOS)
+  {
+    /* place pair into empty slot */
+    return place_pair(map, pair, hashcode);
+  }
+
+  return false;
+}
+
+void const * hmap_remove
+(hash_map * restrict const map, void const * restrict pair)
+{
+  if (pair == NULL || map->len < 1)
+  {
+    /* nothing is being removed */
+    return NULL;
+  }
+
+  migrate_step(map, HMAP_MIGRATE_STEP);
+
+  unsigned long const hashcode = map->hasher(pair);
+  HMAP_STAT_ADD(map, hasher_calls, 1);
+  void const * old = NULL;
+
+  size_t slot = find_bucket(map, pair, hashcode);
+  if (slot != HMAP_NPOS)
+  {
+    /* key exists, remove the slot */
+    old = map->mem[slot].pair;
+    vacate_slot(map, slot);
+  }
+  else if ((slot = find_old_bucket(map, pair, hashcode)) != HMAP_NPOS)
+  {
+    /* not migrated yet, it will be skipped by the migration */
+    old = map->old_mem[slot].pair;
+    map->old_mem[slot].pair = NULL;
+    --map->len;
+  }
+  else
+  {
+    /* does not exist, nothing to remove */
+    return NULL;
+  }
+
+  maybe_shrink(map);
+  return old;
+}
+
+void const * hmap_replace
+(hash_map * restrict const map, void const * restrict pair)
+{
+  if (pair == NULL || map->len < 1)
+  {
+    /* nothing is being replaced */
+    return NULL;
+  }
+
+  migrate_step(map, HMAP_MIGRATE_STEP);
+
+  unsigned long const hashcode = map->hasher(pair);
+  HMAP_STAT_ADD(map, hasher_calls, 1);
+  map_entry * ent;
+
+  size_t slot = find_bucket(map, pair, hashcode);
+  if (slot != HMAP_NPOS)
+  {
+    ent = &map->mem[slot];
+  }
+  else if ((slot = find_old_bucket(map, pair, hashcode)) != HMAP_NPOS)
+  {
+    ent = &map->old_mem[slot];
+  }
+  else
+  {
+    /* does not exist, nothing to replace */
+    return NULL;
+  }
+
+  /* key exists, replace the slot */
+  void const * old = ent->pair;
+  ent->pair = pair;
+  return old;
+}
+
+bool hmap_has_key
+(hash_map const * restrict const map, void const * restrict pair)
+{
+  return hmap_get(map, pair) != NULL;
+}
+
+void const * hmap_get
+(hash_map const * restrict const map, void const * restrict pair)
+{
+  if (pair == NULL || map->len < 1)
+  {
+    return NULL;
+  }
+
+  unsigned long const hashcode = map->hasher(pair);
+  HMAP_STAT_ADD(map, hasher_calls, 1);
+
+  size_t slot = find_bucket(map, pair, hashcode);
+  if (slot != HMAP_NPOS)
+  {
+    return map->mem[slot].pair;
+  }
+
+  /* could still be waiting to be migrated */
+  slot = find_old_bucket(map, pair, hashcode);
+  return slot == HMAP_NPOS ? NULL : map->old_mem[slot].pair;
+}
+
+void const * hmap_get_or_default
+(hash_map const * restrict const map, void const * restrict pair)
+{
+  void const * ptr = hmap_get(map, pair);
+  if (ptr == NULL)
+  {
+    return pair;
+  }
+  return ptr;
+}
+
+/**
+ * Looks at the home bucket of a hashcode for a pair that probably has the
+ * same key, without calling key_equal.
+ *
+ * @param map - this pointer
+ * @param hashcode - hashcode being looked up
+ *
+ * @return pair stored with the same hashcode or NULL
+ */
+static
+void const * likely_pair
+(hash_map const * const map, unsigned long const hashcode)
+{
+  size_t const home = hmap_home(hashcode, map->cap);
+  if (map->flags & HMAP_ROBIN_HOOD)
+  {
+    map_entry const * ent = &map->mem[home];
+    return map->ctrl[home] == 0 && ent->hash == hashcode ? ent->pair : NULL;
+  }
+
+  unsigned char const * group = &map->ctrl[home];
+  for (hmap_group_mask mask = hmap_group_match(group, hmap_tag(hashcode)); mask != 0; mask &= mask - 1)
+  {
+    map_entry const * ent = &map->mem[(home + hmap_mask_first(mask)) & (map->cap - 1)];
+    if (ent->hash == hashcode)
+    {
+      return ent->pair;
+    }
+  }
+  return NULL;
+}
+
 /**
- * @param dst - bucket destination
- * @param src - bucket source
- * @param dst_cap - capacity of dst
- * @param src_cap - capacity of src
- * @param hasher - hash function, use old hashcode if NULL
+ * Resolves a batch of probes in three passes so the cache misses of each
+ * pass overlap: the control bytes and buckets are prefetched first, then the
+ * pairs those buckets point to, and only then is key_equal called.
+ *
+ * @param map - this pointer
+ * @param pairs - probes, only keys are used
+ * @param count - number of probes, at most BATCH_SIZE
+ * @param out - outputs found pair or NULL for each probe
  */
 static
-void rehash_move
-(map_entry * restrict dst, map_entry const * restrict src,
- size_t const dst_cap, size_t const src_cap,
- hash_func * const hasher)
+void get_batch
+(hash_map const * restrict const map, void const * const * restrict pairs, size_t const count,
+ void const ** restrict out)
 {
-  if (dst_cap < 1) return;
+  unsigned long hashcodes[BATCH_SIZE];
 
-  for (size_t i = 0; i < dst_cap; ++i)
+  for (size_t i = 0; i < count; ++i)
   {
-    dst[i].pair = NULL;
+    hashcodes[i] = map->hasher(pairs[i]);
+    HMAP_STAT_ADD(map, hasher_calls, 1);
+
+    size_t const home = hmap_home(hashcodes[i], map->cap);
+    PREFETCH(&map->ctrl[home]);
+    PREFETCH(&map->mem[home]);
   }
 
-  for (size_t i = 0; i < src_cap; ++i)
+  for (size_t i = 0; i < count; ++i)
   {
-    void const * pair = src[i].pair;
-    unsigned long const hashcode = hasher == NULL ? src[i].hash : hasher(pair);
+    void const * candidate = likely_pair(map, hashcodes[i]);
+    if (candidate != NULL)
+    {
+      PREFETCH(candidate);
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    size_t slot = find_bucket(map, pairs[i], hashcodes[i]);
+    if (slot != HMAP_NPOS)
+    {
+      out[i] = map->mem[slot].pair;
+      continue;
+    }
+
+    /* could still be waiting to be migrated */
+    slot = find_old_bucket(map, pairs[i], hashcodes[i]);
+    out[i] = slot == HMAP_NPOS ? NULL : map->old_mem[slot].pair;
+  }
+}
 
-    for (size_t k = 0; ; ++k)
+void hmap_get_many
+(hash_map const * restrict const map, void const * const * restrict pairs, size_t count,
+ void const ** restrict out)
+{
+  for (size_t i = 0; i < count; i += BATCH_SIZE)
+  {
+    size_t const n = count - i < BATCH_SIZE ? count - i : BATCH_SIZE;
+    if (map->len < 1)
     {
-      size_t const offset = HMAP_PROBE(hashcode, k);
-      map_entry * slot = &dst[offset % dst_cap];
+      memset(&out[i], 0, n * sizeof(void const *));
+      continue;
+    }
 
-      if (slot->pair == NULL)
+    if (map->cap < BATCH_MIN_CAP)
+    {
+      for (size_t j = i; j < i + n; ++j)
       {
-        /* place pair into slot */
-        slot->hash = hashcode;
-        slot->pair = pair;
-        break;
+        out[j] = hmap_get(map, pairs[j]);
       }
+      continue;
     }
+
+    get_batch(map, &pairs[i], n, &out[i]);
   }
 }
 
-/**
- * @param map - this pointer
- * @param pair - search by key
- * @param out_hash - outputs calculated hashcode; ignore if NULL
- *
- * @return vacant slot or slot with the same key
- */
-static
-map_entry * find_bucket
-(hash_map const * restrict const map, void const * restrict pair, unsigned long * restrict out_hash)
+size_t hmap_has_key_many
+(hash_map const * restrict const map, void const * const * restrict pairs, size_t count,
+ bool * restrict out)
 {
-  unsigned long const hashcode = map->hasher(pair);
-  if (out_hash != NULL)
-  {
-    *out_hash = hashcode;
-  }
+  size_t found = 0;
+  void const * batch[BATCH_SIZE];
 
-  size_t const cap = map->cap;
-  for (size_t k = 0; ; ++k)
+  for (size_t i = 0; i < count; i += BATCH_SIZE)
   {
-    size_t const offset = HMAP_PROBE(hashcode, k);
-    map_entry * slot = &map->mem[offset % cap];
+    size_t const n = count - i < BATCH_SIZE ? count - i : BATCH_SIZE;
+    hmap_get_many(map, &pairs[i], n, batch);
 
-    /* if slot was vacant or if the slot has same key */
-    if ((slot->pair == NULL)
-      || (slot->hash == hashcode && map->key_equal(slot->pair, pair)))
+    for (size_t j = 0; j < n; ++j)
     {
-      return slot;
+      out[i + j] = batch[j] != NULL;
+      found += out[i + j];
     }
   }
-  return NULL;
+  return found;
 }
 
-bool init_hmap
-(hash_map * const map, hash_func * hasher, key_eq * key_equal)
+/**
+ * Runs body for every entry of the map, including the ones not migrated yet.
+ */
+#define FOR_EACH_ENTRY(map, ent, body) \
+  do \
+  { \
+    for (size_t i_ = 0; i_ < (map)->cap; ++i_) \
+    { \
+      if (!((map)->ctrl[i_] & 0x80)) \
+      { \
+        map_entry const * ent = &(map)->mem[i_]; \
+        body \
+      } \
+    } \
+    for (size_t i_ = (map)->old_pos; i_ < (map)->old_cap; ++i_) \
+    { \
+      if (!((map)->old_ctrl[i_] & 0x80) && (map)->old_mem[i_].pair != NULL) \
+      { \
+        map_entry const * ent = &(map)->old_mem[i_]; \
+        body \
+      } \
+    } \
+  } \
+  while (0)
+
+/**
+ * @param map - map the entry is looked up in
+ * @param from - map the entry is stored in
+ * @param ent - entry of from
+ *
+ * @return hashcode of the entry's pair under the hasher of map, which is the
+ * stored one if both maps use the same hasher
+ */
+static inline
+unsigned long hash_for
+(hash_map const * const map, hash_map const * const from, map_entry const * const ent)
 {
-  if (hasher == NULL || key_equal == NULL)
+  if (map->hasher == from->hasher)
   {
-    return false;
+    return ent->hash;
   }
 
-  map->len = 0;
-  map->cap = 0;
-  map->mem = NULL;
-  map->hasher = hasher;
-  map->key_equal = key_equal;
-  return true;
+  HMAP_STAT_ADD(map, hasher_calls, 1);
+  return map->hasher(ent->pair);
 }
 
-void free_hmap
-(hash_map * const map)
+/**
+ * @param map - this pointer
+ * @param pair - search by key
+ * @param hashcode - hashcode of pair
+ *
+ * @return entry with the same key, migrated or not, or NULL
+ */
+static
+map_entry * find_entry
+(hash_map const * restrict const map, void const * restrict pair, unsigned long const hashcode)
 {
-  if (map->cap > 0)
+  if (map->len < 1)
   {
-    free(map->mem);
-
-    map->len = 0;
-    map->cap = 0;
-    map->mem = NULL;
-    map->hasher = NULL;
+    return NULL;
   }
-}
 
-void hmap_clear
-(hash_map * const map)
-{
-  map->len = 0;
-  for (size_t i = 0; i < map->cap; ++i)
+  size_t slot = find_bucket(map, pair, hashcode);
+  if (slot != HMAP_NPOS)
   {
-    map->mem[i].pair = NULL;
+    return (map_entry *) &map->mem[slot];
   }
+
+  slot = find_old_bucket(map, pair, hashcode);
+  return slot == HMAP_NPOS ? NULL : (map_entry *) &map->old_mem[slot];
 }
 
-bool hmap_ensure_capacity
-(hash_map * const map, size_t n)
+/**
+ * Rebuilds the buckets with only the pairs that are in other (or that are
+ * not), instead of vacating the others one by one.
+ *
+ * @param map - this pointer, must not be migrating
+ * @param other - map whose keys decide which pairs stay
+ * @param keep_found - true keeps the pairs in other, false the ones that are not
+ * @param most - upper bound of the number of pairs staying
+ * @param drop - called with every pair that does not stay, may be NULL
+ *
+ * @return true if the new buckets were able to be allocated
+ */
+static
+bool filter_buckets
+(hash_map * restrict const map, hash_map const * restrict const other, bool const keep_found,
+ size_t const most, void (* drop)(void const *))
 {
-  size_t const old_cap = map->cap;
-  if (old_cap >= n)
+  size_t cap = hmap_buckets_for(map, HMAP_GROW(most));
+  if (cap > map->cap)
   {
-    /* capacity is already at least n */
-    return true;
+    cap = map->cap;
   }
 
-  size_t const new_cap = HMAP_GROW(n);
-  map_entry * new_mem = malloc(new_cap * sizeof(map_entry));
+  unsigned char * new_ctrl;
+  map_entry * new_mem = hmap_alloc_buckets(cap, &new_ctrl);
   if (new_mem == NULL)
   {
     return false;
   }
 
-  rehash_move(new_mem, map->mem, new_cap, map->cap, NULL);
-
-  map->cap = new_cap;
+  size_t kept = 0;
+  for (size_t i = 0; i < map->cap; ++i)
+  {
+    if (!(map->ctrl[i] & 0x80))
+    {
+      map_entry const * ent = &map->mem[i];
+      bool const found = find_entry(other, ent->pair, hash_for(other, map, ent)) != NULL;
+      if (found == keep_found)
+      {
+        insert_entry(new_mem, new_ctrl, cap, map->flags, ent->hash, ent->pair);
+        ++kept;
+      }
+      else if (drop != NULL)
+      {
+        drop(ent->pair);
+      }
+    }
+  }
 
   free(map->mem);
+  HMAP_STAT_ADD(map, bytes_moved, kept * sizeof(map_entry));
+  map->len = kept;
+  map->cap = cap;
   map->mem = new_mem;
-
+  map->ctrl = new_ctrl;
+  map->dead = 0;
+  update_thresholds(map);
   return true;
 }
 
-bool hmap_put
-(hash_map * restrict const map, void const * restrict pair, void const ** restrict repl)
+bool hmap_merge
+(hash_map * restrict const map, hash_map const * restrict const src, hmap_merge_func * resolve,
+ void * ctx)
 {
-  if (pair == NULL)
+  if (src->len < 1)
   {
-    /* insert null pair does nothing */
     return true;
   }
 
-  if (!hmap_ensure_capacity(map, map->len + 1))
+  /* finish any migration and size the buckets once for every pair */
+  migrate_step(map, map->old_cap);
+  if (map->len + map->dead + src->len > map->grow_at)
   {
-    return false;
+    size_t cap = hmap_buckets_for(map, HMAP_GROW(map->len + src->len));
+    if (cap < map->cap)
+    {
+      cap = map->cap;
+    }
+    if (!resize_buckets(map, cap, NULL))
+    {
+      return false;
+    }
+    migrate_step(map, map->old_cap);
   }
 
-  unsigned long hashcode;
-  map_entry * slot = find_bucket(map, pair, &hashcode);
-
-  if (slot->pair == NULL)
-  {
-    /* one less empty slot */
-    ++map->len;
-  }
-  else if (repl != NULL)
+  FOR_EACH_ENTRY(src, ent,
   {
-    /*
-     * else means slot was occupied with the same key.
-     * save overwrite if repl != NULL
-     */
-    *repl = slot->pair;
-  }
-
-  slot->hash = hashcode;
-  slot->pair = pair;
+    unsigned long const hashcode = hash_for(map, src, ent);
+    map_entry * found = find_entry(map, ent->pair, hashcode);
+    if (found != NULL)
+    {
+      found->pair = resolve == NULL ? ent->pair : resolve(found->pair, ent->pair, ctx);
+    }
+    else if (!place_pair(map, ent->pair, hashcode))
+    {
+      return false;
+    }
+  });
   return true;
 }
 
-bool hmap_put_if_absent
-(hash_map * restrict const map, void const * restrict pair)
+bool hmap_intersect
+(hash_map * restrict const map, hash_map const * restrict const other,
+ void (* drop)(void const *))
 {
-  if (pair == NULL)
+  if (map->len < 1)
   {
-    /* insert null pair does nothing */
     return true;
   }
 
-  if (!hmap_ensure_capacity(map, map->len + 1))
+  migrate_step(map, map->old_cap);
+  if (drop != NULL || map->len <= other->len)
   {
-    return false;
+    /* every dropped pair has to be visited anyway */
+    return filter_buckets(map, other, true, map->len < other->len ? map->len : other->len, drop);
   }
 
-  unsigned long hashcode;
-  map_entry * slot = find_bucket(map, pair, &hashcode);
-
-  if (slot->pair == NULL)
+  /* look up the keys of the smaller map and keep the pairs found */
+  size_t cap = hmap_buckets_for(map, HMAP_GROW(other->len));
+  if (cap > map->cap)
   {
-    /* place pair into empty slot */
-    slot->hash = hashcode;
-    slot->pair = pair;
-    ++map->len;
-    return true;
+    cap = map->cap;
   }
 
-  return false;
-}
-
-void const * hmap_remove
-(hash_map * restrict const map, void const * restrict pair)
-{
-  if (pair == NULL || map->len < 1)
+  unsigned char * new_ctrl;
+  map_entry * new_mem = hmap_alloc_buckets(cap, &new_ctrl);
+  if (new_mem == NULL)
   {
-    /* nothing is being removed */
-    return NULL;
+    return false;
   }
 
-  map_entry * slot = find_bucket(map, pair, NULL);
-
-  if (slot->pair != NULL)
+  size_t kept = 0;
+  FOR_EACH_ENTRY(other, ent,
   {
-    /* key exists, remove the slot */
-    void const * old = slot->pair;
-    slot->pair = NULL;
-    return old;
-  }
+    map_entry const * found = find_entry(map, ent->pair, hash_for(map, other, ent));
+    if (found != NULL)
+    {
+      insert_entry(new_mem, new_ctrl, cap, map->flags, found->hash, found->pair);
+      ++kept;
+    }
+  });
 
-  /* does not exist, nothing to remove */
-  return NULL;
+  free(map->mem);
+  HMAP_STAT_ADD(map, bytes_moved, kept * sizeof(map_entry));
+  map->len = kept;
+  map->cap = cap;
+  map->mem = new_mem;
+  map->ctrl = new_ctrl;
+  map->dead = 0;
+  update_thresholds(map);
+  return true;
 }
 
-void const * hmap_replace
-(hash_map * restrict const map, void const * restrict pair)
+bool hmap_difference
+(hash_map * restrict const map, hash_map const * restrict const other,
+ void (* drop)(void const *))
 {
-  if (pair == NULL || map->len < 1)
+  if (map->len < 1 || other->len < 1)
   {
-    /* nothing is being replaced */
-    return NULL;
+    return true;
   }
 
-  map_entry * slot = find_bucket(map, pair, NULL);
-
-  if (slot->pair != NULL)
+  migrate_step(map, map->old_cap);
+  if (map->len <= other->len)
   {
-    /* key exists, replace the slot */
-    void const * old = slot->pair;
-    slot->pair = pair;
-    return old;
+    if (!filter_buckets(map, other, false, map->len, drop))
+    {
+      return false;
+    }
+    maybe_shrink(map);
+    return true;
   }
 
-  /* does not exist, nothing to replace */
-  return NULL;
+  /* look up the keys of the smaller map and remove the pairs found */
+  FOR_EACH_ENTRY(other, ent,
+  {
+    size_t const slot = find_bucket(map, ent->pair, hash_for(map, other, ent));
+    if (slot != HMAP_NPOS)
+    {
+      void const * removed = map->mem[slot].pair;
+      vacate_slot(map, slot);
+      if (drop != NULL)
+      {
+        drop(removed);
+      }
+    }
+  });
+
+  maybe_shrink(map);
+  return true;
 }
 
-bool hmap_has_key
-(hash_map const * restrict const map, void const * restrict pair)
+bool hmap_migrate
+(hash_map * const map, size_t n)
 {
-  return hmap_get(map, pair) != NULL;
+  migrate_step(map, n);
+  return map->old_mem != NULL;
 }
 
-void const * hmap_get
-(hash_map const * restrict const map, void const * restrict pair)
+bool hmap_rehash
+(hash_map * const map, hash_func * hasher)
 {
-  if (pair == NULL || map->len < 1)
+  if (map->len > 0 && !resize_buckets(map, map->cap, hasher))
   {
-    return NULL;
+    return false;
   }
 
-  return find_bucket(map, pair, NULL)->pair;
+  map->hasher = hasher;
+  return true;
 }
 
-void const * hmap_get_or_default
-(hash_map const * restrict const map, void const * restrict pair)
+void hmap_foreach
+(hash_map const * const map, void (* it)(void const *))
 {
-  void const * ptr = hmap_get(map, pair);
-  if (ptr == NULL)
+  for (size_t i = 0; i < map->cap; ++i)
   {
-    return pair;
+    if (!(map->ctrl[i] & 0x80))
+    {
+      it(map->mem[i].pair);
+    }
   }
-  return ptr;
-}
 
-bool hmap_rehash
-(hash_map * const map, hash_func * hasher)
-{
-  if (map->len > 0)
+  for (size_t i = map->old_pos; i < map->old_cap; ++i)
   {
-    size_t const cap = map->cap;
-    map_entry * new_mem = malloc(cap * sizeof(map_entry));
-    if (new_mem == NULL)
+    if (!(map->old_ctrl[i] & 0x80) && map->old_mem[i].pair != NULL)
     {
-      return false;
+      it(map->old_mem[i].pair);
     }
-
-    rehash_move(new_mem, map->mem, cap, cap, hasher);
-
-    free(map->mem);
-    map->mem = new_mem;
   }
-
-  map->hasher = hasher;
-  return true;
 }
 
-void hmap_foreach
-(hash_map const * const map, void (* it)(void const *))
+bool hmap_foreach_ctx
+(hash_map const * const map, bool (* it)(void const *, void *), void * ctx)
 {
   for (size_t i = 0; i < map->cap; ++i)
   {
-    map_entry ent = map->mem[i];
-    if (ent.pair != NULL)
+    if (!(map->ctrl[i] & 0x80) && !it(map->mem[i].pair, ctx))
+    {
+      return false;
+    }
+  }
+
+  for (size_t i = map->old_pos; i < map->old_cap; ++i)
+  {
+    if (!(map->old_ctrl[i] & 0x80) && map->old_mem[i].pair != NULL && !it(map->old_mem[i].pair, ctx))
     {
-      it(ent.pair);
+      return false;
     }
   }
+  return true;
 }
 
 size_t hmap_size
@@ -344,4 +1366,97 @@ size_t hmap_capacity
 (hash_map const * const map)
 {
   return map->cap;
-}
\ No newline at end of file
+}
+
+/**
+ * @param map - this pointer
+ * @param mem - buckets of map, current or being migrated
+ * @param ctrl - control bytes of mem
+ * @param cap - capacity of mem
+ * @param slot - full slot
+ *
+ * @return number of slots probed before reaching slot, starting from the
+ * pair's home
+ */
+static
+size_t probe_distance
+(hash_map const * const map, map_entry const * mem, unsigned char const * ctrl, size_t const cap,
+ size_t const slot)
+{
+  if (map->flags & HMAP_ROBIN_HOOD)
+  {
+    return rh_distance(mem, ctrl, cap, slot);
+  }
+
+  size_t const home = hmap_home(mem[slot].hash, cap);
+  for (size_t k = 0; k < cap; k += HMAP_GROUP_WIDTH)
+  {
+    size_t const offset = HMAP_PROBE(home, k) & (cap - 1);
+    size_t const index = (slot - offset) & (cap - 1);
+    if (index < HMAP_GROUP_WIDTH)
+    {
+      return k + index;
+    }
+  }
+  return cap;
+}
+
+static
+void add_probes
+(hash_map const * restrict const map, map_entry const * mem, unsigned char const * ctrl,
+ size_t const cap, size_t const from, hmap_statistics * restrict stats, size_t * restrict total)
+{
+  for (size_t i = from; i < cap; ++i)
+  {
+    if ((ctrl[i] & 0x80) || mem[i].pair == NULL)
+    {
+      continue;
+    }
+
+    size_t const dist = probe_distance(map, mem, ctrl, cap, i);
+    size_t bin = 0;
+    while (bin < HMAP_STATS_BINS - 1 && dist >> bin != 0)
+    {
+      ++bin;
+    }
+    ++stats->probe_hist[bin];
+    stats->max_probe = dist > stats->max_probe ? dist : stats->max_probe;
+    *total += dist;
+  }
+}
+
+void hmap_stats
+(hash_map const * restrict const map, hmap_statistics * restrict stats)
+{
+  memset(stats, 0, sizeof(*stats));
+
+  size_t total = 0;
+  add_probes(map, map->mem, map->ctrl, map->cap, 0, stats, &total);
+  add_probes(map, map->old_mem, map->old_ctrl, map->old_cap, map->old_pos, stats, &total);
+  stats->mean_probe = map->len > 0 ? (double) total / map->len : 0;
+
+  /* a cluster may wrap around the end, so start after an empty slot */
+  size_t start = 0;
+  while (start < map->cap && map->ctrl[start] != HMAP_CTRL_EMPTY)
+  {
+    ++start;
+  }
+  if (start == map->cap)
+  {
+    stats->longest_cluster = map->cap;
+  }
+  else
+  {
+    size_t run = 0;
+    for (size_t i = 1; i <= map->cap; ++i)
+    {
+      run = map->ctrl[(start + i) & (map->cap - 1)] == HMAP_CTRL_EMPTY ? 0 : run + 1;
+      stats->longest_cluster = run > stats->longest_cluster ? run : stats->longest_cluster;
+    }
+  }
+
+  stats->hasher_calls = map->counters.hasher_calls;
+  stats->key_equal_calls = map->counters.key_equal_calls;
+  stats->resizes = map->counters.resizes;
+  stats->bytes_moved = map->counters.bytes_moved;
+}
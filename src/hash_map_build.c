@@ -0,0 +1,474 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "hash_map.h"
+#include "hmap_group.h"
+#include "hmap_internal.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* bulk builds smaller than this per thread are not worth the threads */
+#define BUILD_MIN_PER_THREAD 16384
+
+/* bucket ranges per worker thread, so uneven ranges balance out */
+#define BUILD_PARTS_PER_THREAD 8
+
+/* more threads than this are not used */
+#define BUILD_MAX_THREADS 64
+
+/*
+ * Bulk builds fill a fresh table in three parallel passes:
+ *
+ * 1. every thread hashes a contiguous chunk of the input and counts how
+ *    many pairs fall into each partition (a contiguous range of buckets,
+ *    picked by the top bits of the home bucket),
+ * 2. every thread scatters the indices of its chunk into the partitions,
+ *    which keeps the input order within each partition,
+ * 3. the partitions are dealt out to the threads in turn, which sort them
+ *    by home bucket and place them linearly. Placing pairs in home order is what
+ *    linear probing and robin hood insertion would have produced.
+ *
+ * Pairs that would probe past the end of their partition are left for the
+ * calling thread to insert afterwards, so no two threads ever touch the same
+ * bucket.
+ */
+
+typedef struct build_job
+{
+  hash_map const * map;
+  map_entry * mem;
+  unsigned char * ctrl;
+  size_t cap;
+
+  void const ** items; /* existing pairs first, then the new ones */
+  unsigned long * hashes;
+  size_t n;
+  size_t existing;
+
+  size_t workers;
+  size_t parts;
+  size_t part_shift; /* home >> part_shift is the partition */
+  size_t part_len;
+  size_t * counts; /* per worker and partition, then scatter offsets */
+  size_t * order; /* item indices grouped by partition */
+  size_t * part_start;
+  size_t * part_overflow; /* leftovers are at the start of the partition */
+  size_t largest_part;
+} build_job;
+
+typedef struct build_worker
+{
+  build_job * job;
+  size_t id;
+  int pass;
+  size_t * home_counts;
+  size_t * sorted;
+  size_t placed; /* by this worker's partitions */
+#ifdef HMAP_STATS
+  size_t compared; /* key_equal calls */
+#endif
+} build_worker;
+
+static
+void build_hash_chunk
+(build_worker * const w)
+{
+  build_job * const job = w->job;
+  size_t const lo = job->n * w->id / job->workers;
+  size_t const hi = job->n * (w->id + 1) / job->workers;
+  size_t * const counts = &job->counts[w->id * job->parts];
+
+  for (size_t i = lo; i < hi; ++i)
+  {
+    if (job->items[i] == NULL)
+    {
+      continue;
+    }
+
+    if (i >= job->existing)
+    {
+      job->hashes[i] = job->map->hasher(job->items[i]);
+    }
+    ++counts[hmap_home(job->hashes[i], job->cap) >> job->part_shift];
+  }
+}
+
+static
+void build_scatter_chunk
+(build_worker * const w)
+{
+  build_job * const job = w->job;
+  size_t const lo = job->n * w->id / job->workers;
+  size_t const hi = job->n * (w->id + 1) / job->workers;
+  size_t * const offsets = &job->counts[w->id * job->parts];
+
+  for (size_t i = lo; i < hi; ++i)
+  {
+    if (job->items[i] != NULL)
+    {
+      job->order[offsets[hmap_home(job->hashes[i], job->cap) >> job->part_shift]++] = i;
+    }
+  }
+}
+
+static
+void build_fill_part
+(build_worker * const w, size_t const part)
+{
+  build_job * const job = w->job;
+  size_t * const indices = &job->order[job->part_start[part]];
+  size_t const count = job->part_start[part + 1] - job->part_start[part];
+  size_t const range_lo = part * job->part_len;
+  size_t const range_hi = range_lo + job->part_len;
+
+  /* counting sort by home bucket, stable so duplicates keep input order */
+  memset(w->home_counts, 0, (job->part_len + 1) * sizeof(size_t));
+  for (size_t i = 0; i < count; ++i)
+  {
+    ++w->home_counts[hmap_home(job->hashes[indices[i]], job->cap) - range_lo + 1];
+  }
+  for (size_t i = 1; i <= job->part_len; ++i)
+  {
+    w->home_counts[i] += w->home_counts[i - 1];
+  }
+  for (size_t i = 0; i < count; ++i)
+  {
+    w->sorted[w->home_counts[hmap_home(job->hashes[indices[i]], job->cap) - range_lo]++] = indices[i];
+  }
+
+  size_t cursor = range_lo;
+  size_t placed = 0;
+  size_t overflow = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    size_t const idx = w->sorted[i];
+    unsigned long const hashcode = job->hashes[idx];
+    void const * pair = job->items[idx];
+    size_t const home = hmap_home(hashcode, job->cap);
+
+    /* buckets from home to cursor are full, one may have the same key */
+    size_t slot = home;
+    for (; slot < cursor; ++slot)
+    {
+      map_entry * ent = &job->mem[slot];
+      if (ent->hash != hashcode)
+      {
+        continue;
+      }
+#ifdef HMAP_STATS
+      ++w->compared;
+#endif
+      if (job->map->key_equal(ent->pair, pair))
+      {
+        ent->pair = pair;
+        break;
+      }
+    }
+    if (slot < cursor)
+    {
+      continue;
+    }
+
+    if (slot >= range_hi)
+    {
+      /* would spill into the next partition */
+      indices[overflow++] = idx;
+      continue;
+    }
+
+    job->mem[slot].hash = hashcode;
+    job->mem[slot].pair = pair;
+    hmap_set_ctrl(job->ctrl, job->cap, slot,
+                  job->map->flags & HMAP_ROBIN_HOOD ? hmap_rh_ctrl(slot - home) : hmap_tag(hashcode));
+    cursor = slot + 1;
+    ++placed;
+  }
+
+  job->part_overflow[part] = overflow;
+  w->placed += placed;
+}
+
+static
+void * build_run
+(void * arg)
+{
+  build_worker * const w = arg;
+  switch (w->pass)
+  {
+    case 1:
+      build_hash_chunk(w);
+      break;
+    case 2:
+      build_scatter_chunk(w);
+      break;
+    default:
+      /* neighbouring partitions go to different workers */
+      for (size_t part = w->id; part < w->job->parts; part += w->job->workers)
+      {
+        build_fill_part(w, part);
+      }
+      break;
+  }
+  return NULL;
+}
+
+/**
+ * Runs one pass on every worker, the calling thread being the first one.
+ * Workers that cannot get a thread run on the calling thread instead.
+ */
+static
+void build_pass
+(build_worker * const workers, size_t const n, int const pass)
+{
+  pthread_t threads[BUILD_MAX_THREADS];
+  bool started[BUILD_MAX_THREADS];
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    workers[i].pass = pass;
+    started[i] = i > 0 && pthread_create(&threads[i], NULL, &build_run, &workers[i]) == 0;
+  }
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    if (!started[i])
+    {
+      build_run(&workers[i]);
+    }
+  }
+
+  for (size_t i = 1; i < n; ++i)
+  {
+    if (started[i])
+    {
+      pthread_join(threads[i], NULL);
+    }
+  }
+}
+
+static
+size_t default_threads
+(void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+  long const n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > 0)
+  {
+    return (size_t) n;
+  }
+#endif
+  return 1;
+}
+
+/**
+ * Fills new buckets of capacity cap with the existing pairs and the new
+ * ones using the given number of threads.
+ */
+static
+bool build_parallel
+(hash_map * restrict const map, void const * const * restrict pairs, size_t const count,
+ size_t const cap, size_t threads)
+{
+  build_job job;
+  job.map = map;
+  job.cap = cap;
+  job.existing = map->len;
+  job.n = map->len + count;
+  job.workers = threads;
+
+  /* at least one group per partition keeps the leftovers rare */
+  size_t parts = 1;
+  while (parts < threads * BUILD_PARTS_PER_THREAD && cap / (parts * 2) >= HMAP_GROUP_WIDTH * 4)
+  {
+    parts *= 2;
+  }
+  job.parts = parts;
+  job.part_len = cap / parts;
+  job.part_shift = hmap_log2_cap(job.part_len);
+
+  job.items = malloc(job.n * sizeof(void const *));
+  job.hashes = malloc(job.n * sizeof(unsigned long));
+  job.order = malloc(job.n * sizeof(size_t));
+  job.counts = calloc(threads * parts, sizeof(size_t));
+  job.part_start = malloc((parts + 1) * sizeof(size_t));
+  job.part_overflow = malloc(parts * sizeof(size_t));
+  build_worker * workers = malloc(threads * sizeof(build_worker));
+  job.mem = hmap_alloc_buckets(cap, &job.ctrl);
+
+  bool ok = job.items != NULL && job.hashes != NULL && job.order != NULL && job.counts != NULL
+    && job.part_start != NULL && job.part_overflow != NULL && workers != NULL && job.mem != NULL;
+  if (ok)
+  {
+    size_t k = 0;
+    for (size_t i = 0; i < map->cap; ++i)
+    {
+      if (!(map->ctrl[i] & 0x80))
+      {
+        job.items[k] = map->mem[i].pair;
+        job.hashes[k++] = map->mem[i].hash;
+      }
+    }
+    memcpy(&job.items[k], pairs, count * sizeof(void const *));
+
+    for (size_t i = 0; i < threads; ++i)
+    {
+      workers[i].job = &job;
+      workers[i].id = i;
+      workers[i].home_counts = NULL;
+      workers[i].sorted = NULL;
+      workers[i].placed = 0;
+#ifdef HMAP_STATS
+      workers[i].compared = 0;
+#endif
+    }
+    build_pass(workers, threads, 1);
+
+    /* partitions in order, workers in input order within each partition */
+    size_t offset = 0;
+    job.largest_part = 0;
+    for (size_t p = 0; p < parts; ++p)
+    {
+      job.part_start[p] = offset;
+      for (size_t t = 0; t < threads; ++t)
+      {
+        size_t const c = job.counts[t * parts + p];
+        job.counts[t * parts + p] = offset;
+        offset += c;
+      }
+      if (offset - job.part_start[p] > job.largest_part)
+      {
+        job.largest_part = offset - job.part_start[p];
+      }
+    }
+    job.part_start[parts] = offset;
+    build_pass(workers, threads, 2);
+
+    /* offset is now the number of pairs, the existing ones kept their hashcode */
+    HMAP_STAT_ADD(map, hasher_calls, offset - job.existing);
+
+    for (size_t i = 0; i < threads && ok; ++i)
+    {
+      workers[i].home_counts = malloc((job.part_len + 1) * sizeof(size_t));
+      workers[i].sorted = malloc((job.largest_part + 1) * sizeof(size_t));
+      ok = workers[i].home_counts != NULL && workers[i].sorted != NULL;
+    }
+  }
+
+  if (ok)
+  {
+    build_pass(workers, threads, 3);
+
+    size_t placed = 0;
+    for (size_t i = 0; i < threads; ++i)
+    {
+      placed += workers[i].placed;
+#ifdef HMAP_STATS
+      map->counters.key_equal_calls += workers[i].compared;
+#endif
+    }
+    HMAP_STAT_ADD(map, resizes, 1);
+    HMAP_STAT_ADD(map, bytes_moved, job.existing * sizeof(map_entry));
+    hmap_adopt_buckets(map, job.mem, job.ctrl, cap, placed);
+
+    /* leftovers go through the usual insertion, partition order is fine */
+    for (size_t p = 0; p < parts && ok; ++p)
+    {
+      size_t const * leftovers = &job.order[job.part_start[p]];
+      for (size_t i = 0; i < job.part_overflow[p] && ok; ++i)
+      {
+        ok = hmap_put_hashed(map, job.items[leftovers[i]], job.hashes[leftovers[i]]);
+      }
+    }
+  }
+  else
+  {
+    free(job.mem);
+  }
+
+  if (workers != NULL)
+  {
+    for (size_t i = 0; i < threads; ++i)
+    {
+      free(workers[i].home_counts);
+      free(workers[i].sorted);
+    }
+  }
+  free(workers);
+  free(job.part_overflow);
+  free(job.part_start);
+  free(job.counts);
+  free(job.order);
+  free(job.hashes);
+  free(job.items);
+  return ok;
+}
+
+bool hmap_put_all
+(hash_map * restrict const map, void const * const * restrict pairs, size_t count, size_t threads)
+{
+  if (threads == 0)
+  {
+    threads = default_threads();
+  }
+  if (threads > BUILD_MAX_THREADS)
+  {
+    threads = BUILD_MAX_THREADS;
+  }
+  if (threads > count / BUILD_MIN_PER_THREAD)
+  {
+    threads = count / BUILD_MIN_PER_THREAD;
+  }
+
+  /* finish any migration, the buckets are rebuilt anyway */
+  hmap_migrate(map, map->old_cap);
+
+  size_t cap = hmap_buckets_for(map, HMAP_GROW(map->len + count));
+  if (cap < map->cap)
+  {
+    cap = map->cap;
+  }
+
+  if (threads > 0)
+  {
+    /* placing pairs in home order beats hmap_put even on one thread */
+    return build_parallel(map, pairs, count, cap, threads);
+  }
+
+  if (!hmap_ensure_capacity(map, map->len + count))
+  {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (!hmap_put(map, pairs[i], NULL))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool hmap_build_from
+(hash_map * restrict const map, hash_func * hasher, key_eq * key_equal,
+ void const * const * restrict pairs, size_t count, size_t threads)
+{
+  return init_hmap(map, hasher, key_equal) && hmap_put_all(map, pairs, count, threads);
+}
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hash_multimap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+typedef struct node_action
+{
+  hash_multimap const * map;
+  hmmap_it * it;
+} node_action;
+
+typedef struct node_ctx_action
+{
+  hash_multimap const * map;
+  hmmap_ctx_it * it;
+  void * ctx;
+} node_ctx_action;
+
+static inline
+hmmap_node * node_of
+(void const * key)
+{
+  /* the hash map stores pointers to the keys inside the nodes */
+  return (hmmap_node *) ((char *) key - offsetof(hmmap_node, data));
+}
+
+static inline
+char * payload
+(hmmap_node const * const node)
+{
+  return (char *) node->data;
+}
+
+static inline
+size_t calc_node_size
+(hash_multimap const * const map, size_t n)
+{
+  return sizeof(hmmap_node) + map->value_off + map->value_blk * n;
+}
+
+static
+hmmap_node * create_new_node
+(hash_multimap const * restrict const map, void const * restrict key, void const * restrict value)
+{
+  hmmap_node * new_node = malloc(calc_node_size(map, 1));
+  if (new_node == NULL) return NULL;
+
+  new_node->count = 1;
+  new_node->cap = 1;
+  memcpy(payload(new_node), key, map->key_blk);
+  memcpy(payload(new_node) + map->value_off, value, map->value_blk);
+  return new_node;
+}
+
+static
+void free_node
+(void const * key)
+{
+  free(node_of(key));
+}
+
+static
+bool call_node_action
+(void const * key, void * ctx)
+{
+  node_action const * action = ctx;
+  hmmap_node const * node = node_of(key);
+  action->it(key, node->count, payload(node) + action->map->value_off);
+  return true;
+}
+
+static
+bool call_node_ctx_action
+(void const * key, void * ctx)
+{
+  node_ctx_action const * action = ctx;
+  hmmap_node const * node = node_of(key);
+  return action->it(key, node->count, payload(node) + action->map->value_off, action->ctx);
+}
+
+static
+bool add_new_key
+(hash_multimap * restrict const map, void const * restrict key, void const * restrict value)
+{
+  hmmap_node * new_node = create_new_node(map, key, value);
+  if (new_node == NULL) return false;
+
+  if (!hmap_put(&map->map, payload(new_node), NULL))
+  {
+    free(new_node);
+    return false;
+  }
+
+  ++map->len;
+  return true;
+}
+
+bool init_hmmap
+(hash_multimap * const map, hash_func * hasher, key_eq * key_equal, size_t key_size,
+ size_t value_size)
+{
+  if (key_size == 0 || value_size == 0 || !init_hmap(&map->map, hasher, key_equal))
+  {
+    return false;
+  }
+
+  map->len = 0;
+  map->key_blk = key_size;
+  map->value_blk = value_size;
+  map->value_off = block_round_up(key_size, block_align(value_size));
+  hmmap_set_growth(map, NULL);
+  return true;
+}
+
+void free_hmmap
+(hash_multimap * const map)
+{
+  hmap_foreach(&map->map, &free_node);
+  free_hmap(&map->map);
+  map->len = 0;
+}
+
+bool hmmap_set_growth
+(hash_multimap * restrict const map, growth_policy const * restrict policy)
+{
+  growth_policy fallback = growth_default();
+  if (policy == NULL)
+  {
+    /* most keys have few values, do not preallocate many */
+    fallback.min_step = 1;
+    policy = &fallback;
+  }
+
+  if (!growth_valid(policy)) return false;
+
+  map->growth = *policy;
+  return true;
+}
+
+void hmmap_clear
+(hash_multimap * const map)
+{
+  hmap_foreach(&map->map, &free_node);
+  hmap_clear(&map->map);
+  map->len = 0;
+}
+
+bool hmmap_put
+(hash_multimap * restrict const map, void const * restrict key, void const * restrict value)
+{
+  void const * found = hmap_get(&map->map, key);
+  if (found == NULL)
+  {
+    return add_new_key(map, key, value);
+  }
+
+  hmmap_node * current = node_of(found);
+  if (current->cap == current->count)
+  {
+    /*
+     * the map compares against the old key while the new node replaces it,
+     * so the node is copied instead of reallocated
+     */
+    size_t const new_cap = growth_next(&map->growth, current->cap, current->count + 1);
+    hmmap_node * resized = malloc(calc_node_size(map, new_cap));
+    if (resized == NULL) return false;
+
+    memcpy(resized, current, calc_node_size(map, current->count));
+    resized->cap = new_cap;
+    hmap_replace(&map->map, payload(resized));
+    free(current);
+    current = resized;
+  }
+
+  memcpy(payload(current) + map->value_off + map->value_blk * current->count++, value, map->value_blk);
+  ++map->len;
+  return true;
+}
+
+bool hmmap_put_if_absent
+(hash_multimap * restrict const map, void const * restrict key, void const * restrict value)
+{
+  if (hmap_has_key(&map->map, key)) return false;
+
+  return add_new_key(map, key, value);
+}
+
+bool hmmap_remove
+(hash_multimap * restrict const map, void const * restrict key)
+{
+  void const * removed = hmap_remove(&map->map, key);
+  if (removed == NULL) return false;
+
+  hmmap_node * node = node_of(removed);
+  map->len -= node->count;
+  free(node);
+  return true;
+}
+
+size_t hmmap_remove_values
+(hash_multimap * restrict const map, void const * restrict key, size_t lo, size_t hi)
+{
+  if (lo >= hi) return 0; /* do nothing since range is [lo, hi) */
+
+  void const * found = hmap_get(&map->map, key);
+  if (found == NULL) return 0;
+
+  hmmap_node * current = node_of(found);
+  size_t const max_len = current->count;
+  size_t const max_idx = max_len < hi ? max_len : hi;
+  if (lo >= max_len) return 0;
+
+  if (max_idx == max_len && lo == 0)
+  {
+    /* removing all values, just remove the key */
+    hmmap_remove(map, key);
+    return max_len;
+  }
+
+  char * values = payload(current) + map->value_off;
+  memmove(
+    values + lo * map->value_blk,
+    values + max_idx * map->value_blk,
+    (max_len - max_idx) * map->value_blk);
+  size_t const delta = max_idx - lo;
+  current->count -= delta;
+  map->len -= delta;
+  return delta;
+}
+
+bool hmmap_has_key
+(hash_multimap const * restrict const map, void const * restrict key)
+{
+  return hmap_has_key(&map->map, key);
+}
+
+size_t hmmap_count_matches
+(hash_multimap const * restrict const map, void const * restrict key)
+{
+  void const * found = hmap_get(&map->map, key);
+  return found == NULL ? 0 : node_of(found)->count;
+}
+
+void const * hmmap_get
+(hash_multimap const * restrict const map, void const * restrict key, size_t * restrict matches)
+{
+  void const * found = hmap_get(&map->map, key);
+  if (found == NULL)
+  {
+    if (matches != NULL) *matches = 0;
+    return NULL;
+  }
+
+  hmmap_node const * node = node_of(found);
+  if (matches != NULL) *matches = node->count;
+  return payload(node) + map->value_off;
+}
+
+void const * hmmap_get_or_default
+(hash_multimap const * restrict const map, void const * key, void const * default_value)
+{
+  void const * values = hmmap_get(map, key, NULL);
+  return values == NULL ? default_value : values;
+}
+
+void hmmap_foreach
+(hash_multimap const * const map, hmmap_it * it)
+{
+  node_action action = { map, it };
+  hmap_foreach_ctx(&map->map, &call_node_action, &action);
+}
+
+bool hmmap_foreach_ctx
+(hash_multimap const * const map, hmmap_ctx_it * it, void * ctx)
+{
+  node_ctx_action action = { map, it, ctx };
+  return hmap_foreach_ctx(&map->map, &call_node_ctx_action, &action);
+}
+
+size_t hmmap_size
+(hash_multimap const * const map)
+{
+  return map->len;
+}
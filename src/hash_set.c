@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hash_set.h"
+
+typedef struct key_action
+{
+  void (* it)(void const *);
+} key_action;
+
+typedef struct key_ctx_action
+{
+  bool (* it)(void const *, void *);
+  void * ctx;
+} key_ctx_action;
+
+static
+bool call_key_action
+(void const * key, void * value, void * ctx)
+{
+  (void) value;
+  ((key_action const *) ctx)->it(key);
+  return true;
+}
+
+static
+bool call_key_ctx_action
+(void const * key, void * value, void * ctx)
+{
+  (void) value;
+  key_ctx_action const * action = ctx;
+  return action->it(key, action->ctx);
+}
+
+bool init_hset
+(hash_set * const set, hash_func * hasher, key_eq * key_equal, size_t key_size)
+{
+  return init_fmap(&set->map, hasher, key_equal, key_size, 0);
+}
+
+void free_hset
+(hash_set * const set)
+{
+  free_fmap(&set->map);
+}
+
+void hset_clear
+(hash_set * const set)
+{
+  fmap_clear(&set->map);
+}
+
+bool hset_ensure_capacity
+(hash_set * const set, size_t n)
+{
+  return fmap_ensure_capacity(&set->map, n);
+}
+
+bool hset_put
+(hash_set * restrict const set, void const * restrict key)
+{
+  return fmap_put(&set->map, key, NULL);
+}
+
+bool hset_put_if_absent
+(hash_set * restrict const set, void const * restrict key)
+{
+  return fmap_put_if_absent(&set->map, key, NULL);
+}
+
+bool hset_remove
+(hash_set * restrict const set, void const * restrict key)
+{
+  return fmap_remove(&set->map, key);
+}
+
+bool hset_has_key
+(hash_set const * restrict const set, void const * restrict key)
+{
+  return fmap_has_key(&set->map, key);
+}
+
+void hset_foreach
+(hash_set const * const set, void (* it)(void const *))
+{
+  key_action action = { it };
+  fmap_foreach_ctx(&set->map, &call_key_action, &action);
+}
+
+bool hset_foreach_ctx
+(hash_set const * const set, bool (* it)(void const *, void *), void * ctx)
+{
+  key_ctx_action action = { it, ctx };
+  return fmap_foreach_ctx(&set->map, &call_key_ctx_action, &action);
+}
+
+size_t hset_size
+(hash_set const * const set)
+{
+  return fmap_size(&set->map);
+}
+
+size_t hset_capacity
+(hash_set const * const set)
+{
+  return fmap_capacity(&set->map);
+}
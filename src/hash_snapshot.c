@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "hash_snapshot.h"
+#include "hmap_group.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * File layout, every part aligned to 8 bytes:
+ *
+ *   header
+ *   control bytes: cap + SNAP_MIRROR, the first SNAP_MIRROR mirrored
+ *   slots: cap times (hashcode, offset of the pair from the data)
+ *   data: the pairs
+ *
+ * The header also records the size of the smallest pair, so a reader can
+ * check that every pair lies within the data without knowing its type.
+ *
+ * The buckets are laid out fresh when writing, without deleted markers, so
+ * every pair is in the first vacant bucket from its home. That is what group
+ * probing finds with any group width, so the reader's instruction set does
+ * not need to match the writer's.
+ */
+
+#define SNAP_MAGIC "PCLHSNAP"
+#define SNAP_VERSION 2
+#define SNAP_BYTE_ORDER UINT32_C(0x01020304)
+
+/* the widest group any reader may load */
+#define SNAP_MIRROR 32
+
+typedef struct snap_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t hash_size;
+  uint32_t mirror;
+  uint64_t len;
+  uint64_t cap;
+  uint64_t ctrl_off;
+  uint64_t slots_off;
+  uint64_t data_off;
+  uint64_t data_size;
+  uint64_t min_pair;
+} snap_header;
+
+static inline
+uint64_t align8
+(uint64_t n)
+{
+  return (n + 7) & ~(uint64_t) 7;
+}
+
+static
+size_t pair_bytes
+(void const * pair, size_t const pair_size, hsnap_writer * const writer)
+{
+  return writer == NULL ? pair_size : writer(pair, NULL);
+}
+
+/**
+ * Places a pair in the first vacant bucket from its home.
+ */
+static
+void snap_place
+(unsigned char * restrict ctrl, uint64_t * restrict slots, size_t const cap,
+ unsigned long const hashcode, uint64_t const offset)
+{
+  size_t slot = hmap_home(hashcode, cap);
+  while (ctrl[slot] != HMAP_CTRL_EMPTY)
+  {
+    slot = (slot + 1) & (cap - 1);
+  }
+
+  ctrl[slot] = hmap_tag(hashcode);
+  if (slot < SNAP_MIRROR)
+  {
+    ctrl[cap + slot] = ctrl[slot];
+  }
+  slots[slot * 2] = hashcode;
+  slots[slot * 2 + 1] = offset;
+}
+
+/**
+ * Runs body for every pair of the map, including the ones not migrated yet.
+ */
+#define FOR_EACH_PAIR(map, pair, hashcode, body) \
+  do \
+  { \
+    for (size_t i_ = 0; i_ < (map)->cap; ++i_) \
+    { \
+      if (!((map)->ctrl[i_] & 0x80)) \
+      { \
+        void const * pair = (map)->mem[i_].pair; \
+        unsigned long const hashcode = (map)->mem[i_].hash; \
+        body \
+      } \
+    } \
+    for (size_t i_ = (map)->old_pos; i_ < (map)->old_cap; ++i_) \
+    { \
+      if (!((map)->old_ctrl[i_] & 0x80) && (map)->old_mem[i_].pair != NULL) \
+      { \
+        void const * pair = (map)->old_mem[i_].pair; \
+        unsigned long const hashcode = (map)->old_mem[i_].hash; \
+        body \
+      } \
+    } \
+  } \
+  while (0)
+
+static
+bool write_snapshot
+(FILE * restrict f, hash_map const * restrict const map, size_t const pair_size,
+ hsnap_writer * const writer)
+{
+  size_t cap = SNAP_MIRROR;
+  while (cap * HMAP_MAX_LOAD < map->len)
+  {
+    cap *= 2;
+  }
+
+  snap_header head;
+  memcpy(head.magic, SNAP_MAGIC, sizeof(head.magic));
+  head.version = SNAP_VERSION;
+  head.byte_order = SNAP_BYTE_ORDER;
+  head.hash_size = sizeof(unsigned long);
+  head.mirror = SNAP_MIRROR;
+  head.len = map->len;
+  head.cap = cap;
+  head.ctrl_off = align8(sizeof(snap_header));
+  head.slots_off = align8(head.ctrl_off + cap + SNAP_MIRROR);
+  head.data_off = head.slots_off + cap * 2 * sizeof(uint64_t);
+
+  unsigned char * ctrl = malloc(cap + SNAP_MIRROR);
+  uint64_t * slots = calloc(cap * 2, sizeof(uint64_t));
+  if (ctrl == NULL || slots == NULL)
+  {
+    free(ctrl);
+    free(slots);
+    return false;
+  }
+  memset(ctrl, HMAP_CTRL_EMPTY, cap + SNAP_MIRROR);
+
+  /* pairs are written in iteration order, so their offsets are known now */
+  uint64_t offset = 0;
+  uint64_t min_pair = UINT64_MAX;
+  FOR_EACH_PAIR(map, pair, hashcode,
+  {
+    size_t const size = pair_bytes(pair, pair_size, writer);
+    snap_place(ctrl, slots, cap, hashcode, offset);
+    offset += align8(size);
+    min_pair = size < min_pair ? size : min_pair;
+  });
+  head.data_size = offset;
+  head.min_pair = map->len == 0 ? 0 : min_pair;
+
+  static unsigned char const padding[8];
+  bool ok = fwrite(&head, sizeof(head), 1, f) == 1
+    && fwrite(padding, head.ctrl_off - sizeof(head), 1, f) <= 1
+    && fwrite(ctrl, cap + SNAP_MIRROR, 1, f) == 1
+    && fwrite(padding, head.slots_off - head.ctrl_off - cap - SNAP_MIRROR, 1, f) <= 1
+    && fwrite(slots, cap * 2 * sizeof(uint64_t), 1, f) == 1;
+  free(ctrl);
+  free(slots);
+
+  void * buf = NULL;
+  size_t buf_size = 0;
+  FOR_EACH_PAIR(map, pair, hashcode,
+  {
+    (void) hashcode;
+    size_t const size = pair_bytes(pair, pair_size, writer);
+    void const * bytes = pair;
+    if (ok && writer != NULL)
+    {
+      if (size > buf_size)
+      {
+        void * grown = realloc(buf, size);
+        ok = grown != NULL;
+        buf = ok ? grown : buf;
+        buf_size = ok ? size : buf_size;
+      }
+      if (ok)
+      {
+        writer(pair, buf);
+        bytes = buf;
+      }
+    }
+
+    ok = ok && fwrite(bytes, 1, size, f) == size
+      && fwrite(padding, 1, align8(size) - size, f) == align8(size) - size;
+  });
+  free(buf);
+  return ok;
+}
+
+bool hmap_write_snapshot
+(hash_map const * restrict const map, char const * restrict path, size_t pair_size,
+ hsnap_writer * writer)
+{
+  size_t const path_len = strlen(path);
+  char * tmp_path = malloc(path_len + sizeof(".tmp"));
+  if (tmp_path == NULL)
+  {
+    return false;
+  }
+  memcpy(tmp_path, path, path_len);
+  memcpy(tmp_path + path_len, ".tmp", sizeof(".tmp"));
+
+  bool ok = false;
+  FILE * f = fopen(tmp_path, "wb");
+  if (f != NULL)
+  {
+    ok = write_snapshot(f, map, pair_size, writer);
+    ok = fclose(f) == 0 && ok;
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok)
+    {
+      remove(tmp_path);
+    }
+  }
+
+  free(tmp_path);
+  return ok;
+}
+
+/**
+ * Checks that the header describes parts that follow each other within the
+ * file. Every sum is compared against what is left of the file first, so
+ * none of them can wrap around.
+ */
+static
+bool valid_layout
+(snap_header const * const head, uint64_t const size)
+{
+  return memcmp(head->magic, SNAP_MAGIC, sizeof(head->magic)) == 0
+    && head->version == SNAP_VERSION
+    && head->byte_order == SNAP_BYTE_ORDER
+    && head->hash_size == sizeof(unsigned long)
+    && head->mirror == SNAP_MIRROR
+    && head->cap >= SNAP_MIRROR && (head->cap & (head->cap - 1)) == 0
+    && head->len <= head->cap
+    && head->ctrl_off >= sizeof(snap_header) && head->ctrl_off <= size - SNAP_MIRROR
+    && head->cap <= size - SNAP_MIRROR - head->ctrl_off
+    && head->slots_off % 8 == 0 && head->slots_off <= size
+    && head->ctrl_off + head->cap + SNAP_MIRROR <= head->slots_off
+    && head->cap <= (size - head->slots_off) / (2 * sizeof(uint64_t))
+    && head->data_off % 8 == 0 && head->data_off <= size
+    && head->slots_off + head->cap * 2 * sizeof(uint64_t) <= head->data_off
+    && head->data_size <= size - head->data_off
+    && head->min_pair <= head->data_size;
+}
+
+/**
+ * Checks that as many buckets as pairs are full and that each of their
+ * pairs lies within the data, so lookups never leave the mapping.
+ */
+static
+bool valid_slots
+(unsigned char const * const base, snap_header const * const head)
+{
+  unsigned char const * ctrl = base + head->ctrl_off;
+  uint64_t const * slots = (uint64_t const *) (base + head->slots_off);
+  uint64_t const last = head->data_size - head->min_pair;
+  uint64_t full = 0;
+  for (uint64_t i = 0; i < head->cap; ++i)
+  {
+    if (ctrl[i] & 0x80)
+    {
+      continue;
+    }
+
+    uint64_t const offset = slots[i * 2 + 1];
+    if (offset % 8 != 0 || offset > last)
+    {
+      return false;
+    }
+    ++full;
+  }
+  return full == head->len;
+}
+
+bool init_hsnap
+(hash_snapshot * restrict const snap, char const * restrict path, hash_func * hasher,
+ key_eq * key_equal)
+{
+  if (hasher == NULL || key_equal == NULL)
+  {
+    return false;
+  }
+
+  int const fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat st;
+  void * base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(snap_header))
+  {
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  /* the mapping stays valid after closing */
+  close(fd);
+  if (base == MAP_FAILED)
+  {
+    return false;
+  }
+
+  size_t const size = st.st_size;
+  snap_header head;
+  memcpy(&head, base, sizeof(head));
+
+  if (!valid_layout(&head, size) || !valid_slots(base, &head))
+  {
+    munmap(base, size);
+    return false;
+  }
+
+  /* lookups jump around the buckets, read-ahead would be wasted */
+  posix_madvise(base, size, POSIX_MADV_RANDOM);
+
+  unsigned char const * bytes = base;
+  snap->len = head.len;
+  snap->cap = head.cap;
+  snap->ctrl = bytes + head.ctrl_off;
+  snap->slots = (uint64_t const *) (bytes + head.slots_off);
+  snap->data = bytes + head.data_off;
+  snap->hasher = hasher;
+  snap->key_equal = key_equal;
+  snap->base = base;
+  snap->size = size;
+  return true;
+}
+
+void free_hsnap
+(hash_snapshot * const snap)
+{
+  if (snap->base != NULL)
+  {
+    munmap(snap->base, snap->size);
+
+    snap->len = 0;
+    snap->cap = 0;
+    snap->ctrl = NULL;
+    snap->slots = NULL;
+    snap->data = NULL;
+    snap->base = NULL;
+    snap->size = 0;
+  }
+}
+
+void const * hsnap_get
+(hash_snapshot const * restrict const snap, void const * restrict key)
+{
+  size_t const cap = snap->cap;
+  unsigned long const hashcode = snap->hasher(key);
+  unsigned char const tag = hmap_tag(hashcode);
+  size_t const home = hmap_home(hashcode, cap);
+
+  for (size_t k = 0; k < cap; k += HMAP_GROUP_WIDTH)
+  {
+    size_t const offset = HMAP_PROBE(home, k) & (cap - 1);
+    unsigned char const * group = &snap->ctrl[offset];
+
+    /* only look at slots with the same tag */
+    for (hmap_group_mask mask = hmap_group_match(group, tag); mask != 0; mask &= mask - 1)
+    {
+      size_t const slot = (offset + hmap_mask_first(mask)) & (cap - 1);
+      if (snap->slots[slot * 2] == (uint64_t) hashcode)
+      {
+        void const * pair = snap->data + snap->slots[slot * 2 + 1];
+        if (snap->key_equal(pair, key))
+        {
+          return pair;
+        }
+      }
+    }
+
+    /* an empty slot ends the probe sequence */
+    if (hmap_group_match_empty(group) != 0)
+    {
+      break;
+    }
+  }
+  return NULL;
+}
+
+bool hsnap_has_key
+(hash_snapshot const * restrict const snap, void const * restrict key)
+{
+  return hsnap_get(snap, key) != NULL;
+}
+
+bool hsnap_foreach_ctx
+(hash_snapshot const * const snap, bool (* it)(void const *, void *), void * ctx)
+{
+  for (size_t i = 0; i < snap->cap; ++i)
+  {
+    if (!(snap->ctrl[i] & 0x80) && !it(snap->data + snap->slots[i * 2 + 1], ctx))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t hsnap_size
+(hash_snapshot const * const snap)
+{
+  return snap->len;
+}
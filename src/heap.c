@@ -56,6 +56,32 @@ void make_max_heap
   heapify(gptr, count, size, cmp, swap_buf);
 }
 
+/**
+ * Moves the element at i down until it is not less than its children
+ */
+static
+void sift_down
+(char *ptr, size_t i, size_t count, size_t size, int (*cmp)(const void *, const void *),
+ char *swap_buf)
+{
+  for (size_t child; (child = 2 * i + 1) < count; i = child)
+  {
+    /* pick the greater child */
+    if (child + 1 < count && cmp(&ptr[size * child], &ptr[size * (child + 1)]) < 0)
+    {
+      ++child;
+    }
+    if (cmp(&ptr[size * i], &ptr[size * child]) >= 0)
+    {
+      break;
+    }
+
+    memcpy(swap_buf, &ptr[size * i], size);
+    memcpy(&ptr[size * i], &ptr[size * child], size);
+    memcpy(&ptr[size * child], swap_buf, size);
+  }
+}
+
 void heapsort
 (void *gptr, size_t count, size_t size, int (*cmp)(const void *, const void *))
 {
@@ -66,7 +92,7 @@ void heapsort
   char *ptr = gptr;
   char swap_buf[size];
 
-  for (size_t i = count; i > 0; )
+  for (size_t i = count; i > 1; )
   {
     char *slot = &ptr[--i * size];
 
@@ -74,6 +100,7 @@ void heapsort
     memmove(slot, ptr, size);
     memcpy(ptr, swap_buf, size);
 
-    heapify(gptr, i, size, cmp, swap_buf);
+    /* only the new root can be out of place */
+    sift_down(ptr, 0, i, size, cmp, swap_buf);
   }
 }
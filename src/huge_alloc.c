@@ -0,0 +1,212 @@
+/* 
+ * Copyright (c) 2019 Paul Teng
+ * 
+ * PCLIB is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU Lesser General Public License as   
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include "huge_alloc.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define HAS_MREMAP 1
+#endif
+
+#ifdef HAS_MREMAP
+
+static
+size_t page_round
+(size_t size)
+{
+  long const queried = sysconf(_SC_PAGESIZE);
+  size_t const page_size = queried > 0 ? (size_t) queried : 4096;
+  return (size + page_size - 1) / page_size * page_size;
+}
+
+static inline
+bool is_mapped
+(size_t size)
+{
+  return size >= HUGE_ALLOC_THRESHOLD;
+}
+
+static
+void *map_pages
+(size_t size)
+{
+  void *ptr = mmap(NULL, page_round(size), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+#ifdef MADV_HUGEPAGE
+  /* only a hint, the block works the same with small pages */
+  madvise(ptr, page_round(size), MADV_HUGEPAGE);
+#endif
+  return ptr;
+}
+
+void *huge_alloc
+(size_t size)
+{
+  return is_mapped(size) ? map_pages(size) : malloc(size);
+}
+
+void *huge_calloc
+(size_t size)
+{
+  /* fresh anonymous pages are already zero */
+  return is_mapped(size) ? map_pages(size) : calloc(1, size);
+}
+
+void *huge_realloc
+(void *ptr, size_t old_size, size_t new_size)
+{
+  if (ptr == NULL)
+  {
+    return huge_alloc(new_size);
+  }
+
+  if (!is_mapped(new_size))
+  {
+    if (!is_mapped(old_size))
+    {
+      return realloc(ptr, new_size);
+    }
+
+    /* shrinking below the threshold, back to malloc */
+    void *new_ptr = malloc(new_size);
+    if (new_ptr != NULL)
+    {
+      memcpy(new_ptr, ptr, new_size);
+      munmap(ptr, page_round(old_size));
+    }
+    return new_ptr;
+  }
+
+  if (!is_mapped(old_size))
+  {
+    /* the last copy this block will need */
+    void *new_ptr = map_pages(new_size);
+    if (new_ptr != NULL)
+    {
+      memcpy(new_ptr, ptr, old_size);
+      free(ptr);
+    }
+    return new_ptr;
+  }
+
+  size_t const old_pages = page_round(old_size);
+  size_t const new_pages = page_round(new_size);
+  if (old_pages == new_pages)
+  {
+    return ptr;
+  }
+
+  /* the kernel moves the page table entries, not the bytes */
+  void *new_ptr = mremap(ptr, old_pages, new_pages, MREMAP_MAYMOVE);
+  if (new_ptr == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (new_pages > old_pages)
+  {
+    madvise(new_ptr, new_pages, MADV_HUGEPAGE);
+  }
+#endif
+  return new_ptr;
+}
+
+void huge_free
+(void *ptr, size_t size)
+{
+  if (ptr == NULL)
+  {
+    return;
+  }
+
+  if (is_mapped(size))
+  {
+    munmap(ptr, page_round(size));
+  }
+  else
+  {
+    free(ptr);
+  }
+}
+
+void *huge_to_malloc
+(void *ptr, size_t size)
+{
+  if (!is_mapped(size))
+  {
+    return ptr;
+  }
+
+  void *new_ptr = malloc(size);
+  if (new_ptr != NULL)
+  {
+    memcpy(new_ptr, ptr, size);
+    munmap(ptr, page_round(size));
+  }
+  return new_ptr;
+}
+
+#else
+
+void *huge_alloc
+(size_t size)
+{
+  return malloc(size);
+}
+
+void *huge_calloc
+(size_t size)
+{
+  return calloc(1, size);
+}
+
+void *huge_realloc
+(void *ptr, size_t old_size, size_t new_size)
+{
+  (void) old_size;
+  return realloc(ptr, new_size);
+}
+
+void huge_free
+(void *ptr, size_t size)
+{
+  (void) size;
+  free(ptr);
+}
+
+void *huge_to_malloc
+(void *ptr, size_t size)
+{
+  (void) size;
+  return ptr;
+}
+
+#endif
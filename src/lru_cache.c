@@ -0,0 +1,484 @@
+/*
+ * Copyright (c) 2019 Paul Teng
+ *
+ * PCLIB is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * PCLIB is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lru_cache.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define DEFAULT_SHARDS 16
+
+typedef struct lru_shard
+{
+  pthread_mutex_t lock;
+  lru_cache cache;
+} lru_shard;
+
+struct sharded_lru
+{
+  size_t shard_mask;
+  lru_shard shards[];
+};
+
+static inline
+lru_node * node_of
+(void const * key)
+{
+  /* the hash map stores pointers to the keys inside the nodes */
+  return (lru_node *) ((char *) key - offsetof(lru_node, data));
+}
+
+static inline
+char * payload
+(lru_node const * const node)
+{
+  return (char *) node->data;
+}
+
+static inline
+size_t calc_node_size
+(lru_cache const * const cache)
+{
+  return sizeof(lru_node) + cache->value_off + cache->value_blk;
+}
+
+static
+void unlink_node
+(lru_cache * restrict const cache, lru_node * restrict const node)
+{
+  if (node->prev == NULL) cache->first = node->next;
+  else node->prev->next = node->next;
+
+  if (node->next == NULL) cache->last = node->prev;
+  else node->next->prev = node->prev;
+}
+
+static
+void link_first
+(lru_cache * restrict const cache, lru_node * restrict const node)
+{
+  node->prev = NULL;
+  node->next = cache->first;
+  if (cache->first == NULL) cache->last = node;
+  else cache->first->prev = node;
+  cache->first = node;
+}
+
+static
+void move_first
+(lru_cache * restrict const cache, lru_node * restrict const node)
+{
+  if (cache->first != node)
+  {
+    unlink_node(cache, node);
+    link_first(cache, node);
+  }
+}
+
+/**
+ * Frees a node already taken out of the map and the list, keeping one around
+ * so a full cache does not allocate on every insertion.
+ */
+static
+void release_node
+(lru_cache * restrict const cache, lru_node * restrict const node)
+{
+  --cache->len;
+  cache->bytes -= node->weight;
+  if (cache->spare == NULL) cache->spare = node;
+  else free(node);
+}
+
+static
+void evict_last
+(lru_cache * const cache)
+{
+  lru_node * const node = cache->last;
+  hmap_remove(&cache->map, payload(node));
+  unlink_node(cache, node);
+  if (cache->on_evict != NULL)
+  {
+    cache->on_evict(payload(node), payload(node) + cache->value_off, cache->evict_ctx);
+  }
+  release_node(cache, node);
+}
+
+static inline
+bool over_bounds
+(lru_cache const * const cache, size_t const extra_entries, size_t const extra_bytes)
+{
+  return (cache->max_entries > 0 && cache->len + extra_entries > cache->max_entries)
+    || (cache->max_bytes > 0 && cache->bytes + extra_bytes > cache->max_bytes);
+}
+
+bool init_lru
+(lru_cache * const cache, hash_func * hasher, key_eq * key_equal, size_t key_size,
+ size_t value_size, size_t max_entries)
+{
+  if (key_size == 0 || !init_hmap(&cache->map, hasher, key_equal))
+  {
+    return false;
+  }
+
+  cache->len = 0;
+  cache->key_blk = key_size;
+  cache->value_blk = value_size;
+  cache->value_off = block_round_up(key_size, block_align(value_size));
+  cache->max_entries = max_entries;
+  cache->max_bytes = 0;
+  cache->bytes = 0;
+  cache->first = NULL;
+  cache->last = NULL;
+  cache->spare = NULL;
+  cache->on_evict = NULL;
+  cache->evict_ctx = NULL;
+  return true;
+}
+
+void free_lru
+(lru_cache * const cache)
+{
+  lru_clear(cache);
+  free(cache->spare);
+  cache->spare = NULL;
+  free_hmap(&cache->map);
+}
+
+void lru_clear
+(lru_cache * const cache)
+{
+  lru_node * node = cache->first;
+  while (node != NULL)
+  {
+    lru_node * const next = node->next;
+    if (cache->on_evict != NULL)
+    {
+      cache->on_evict(payload(node), payload(node) + cache->value_off, cache->evict_ctx);
+    }
+    free(node);
+    node = next;
+  }
+
+  hmap_clear(&cache->map);
+  cache->len = 0;
+  cache->bytes = 0;
+  cache->first = NULL;
+  cache->last = NULL;
+}
+
+void lru_set_bounds
+(lru_cache * const cache, size_t max_entries, size_t max_bytes)
+{
+  cache->max_entries = max_entries;
+  cache->max_bytes = max_bytes;
+  while (cache->len > 0 && over_bounds(cache, 0, 0))
+  {
+    evict_last(cache);
+  }
+}
+
+void lru_set_evict
+(lru_cache * const cache, lru_evict_func * on_evict, void * ctx)
+{
+  cache->on_evict = on_evict;
+  cache->evict_ctx = ctx;
+}
+
+bool lru_put
+(lru_cache * restrict const cache, void const * restrict key, void const * restrict value)
+{
+  return lru_put_weighted(cache, key, value, calc_node_size(cache));
+}
+
+bool lru_put_weighted
+(lru_cache * restrict const cache, void const * restrict key, void const * restrict value,
+ size_t weight)
+{
+  if (cache->max_bytes > 0 && weight > cache->max_bytes)
+  {
+    return false;
+  }
+
+  void const * found = hmap_get(&cache->map, key);
+  if (found != NULL)
+  {
+    lru_node * const node = node_of(found);
+    if (cache->on_evict != NULL)
+    {
+      cache->on_evict(payload(node), payload(node) + cache->value_off, cache->evict_ctx);
+    }
+    memcpy(payload(node) + cache->value_off, value, cache->value_blk);
+    cache->bytes = cache->bytes - node->weight + weight;
+    node->weight = weight;
+    move_first(cache, node);
+
+    /* a heavier value might push others out, never itself */
+    while (cache->last != node && over_bounds(cache, 0, 0))
+    {
+      evict_last(cache);
+    }
+    return true;
+  }
+
+  while (cache->len > 0 && over_bounds(cache, 1, weight))
+  {
+    evict_last(cache);
+  }
+
+  lru_node * node = cache->spare;
+  if (node != NULL) cache->spare = NULL;
+  else node = malloc(calc_node_size(cache));
+  if (node == NULL) return false;
+
+  memcpy(payload(node), key, cache->key_blk);
+  memcpy(payload(node) + cache->value_off, value, cache->value_blk);
+  if (!hmap_put(&cache->map, payload(node), NULL))
+  {
+    cache->spare = node;
+    return false;
+  }
+
+  node->weight = weight;
+  link_first(cache, node);
+  ++cache->len;
+  cache->bytes += weight;
+  return true;
+}
+
+void const * lru_get
+(lru_cache * restrict const cache, void const * restrict key)
+{
+  void const * found = hmap_get(&cache->map, key);
+  if (found == NULL) return NULL;
+
+  lru_node * const node = node_of(found);
+  move_first(cache, node);
+  return payload(node) + cache->value_off;
+}
+
+void const * lru_peek
+(lru_cache const * restrict const cache, void const * restrict key)
+{
+  void const * found = hmap_get(&cache->map, key);
+  return found == NULL ? NULL : payload(node_of(found)) + cache->value_off;
+}
+
+bool lru_has_key
+(lru_cache const * restrict const cache, void const * restrict key)
+{
+  return hmap_has_key(&cache->map, key);
+}
+
+bool lru_remove
+(lru_cache * restrict const cache, void const * restrict key, void * restrict value)
+{
+  void const * removed = hmap_remove(&cache->map, key);
+  if (removed == NULL) return false;
+
+  lru_node * const node = node_of(removed);
+  if (value != NULL)
+  {
+    memcpy(value, payload(node) + cache->value_off, cache->value_blk);
+  }
+  unlink_node(cache, node);
+  release_node(cache, node);
+  return true;
+}
+
+bool lru_evict
+(lru_cache * const cache)
+{
+  if (cache->len < 1) return false;
+
+  evict_last(cache);
+  return true;
+}
+
+bool lru_foreach_ctx
+(lru_cache const * const cache, bool (* it)(void const *, void const *, void *), void * ctx)
+{
+  for (lru_node const * node = cache->first; node != NULL; node = node->next)
+  {
+    if (!it(payload(node), payload(node) + cache->value_off, ctx))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t lru_size
+(lru_cache const * const cache)
+{
+  return cache->len;
+}
+
+size_t lru_bytes
+(lru_cache const * const cache)
+{
+  return cache->bytes;
+}
+
+static inline
+lru_shard * shard_of
+(sharded_lru * restrict const cache, void const * restrict key)
+{
+  /* the shards' maps use the high bits of the hashcode */
+  unsigned long const hashcode = cache->shards[0].cache.map.hasher(key);
+  return &cache->shards[(hashcode ^ (hashcode >> 16)) & cache->shard_mask];
+}
+
+static
+void free_shards
+(sharded_lru * const cache, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    free_lru(&cache->shards[i].cache);
+    pthread_mutex_destroy(&cache->shards[i].lock);
+  }
+  free(cache);
+}
+
+sharded_lru * new_slru
+(hash_func * hasher, key_eq * key_equal, size_t key_size, size_t value_size,
+ size_t max_entries, size_t max_bytes, size_t shards)
+{
+  if (hasher == NULL || key_equal == NULL || key_size == 0)
+  {
+    return NULL;
+  }
+
+  size_t count = 1;
+  while (count < (shards == 0 ? DEFAULT_SHARDS : shards))
+  {
+    count *= 2;
+  }
+
+  /* a bounded shard needs a bound of at least one, since 0 means unbounded */
+  while (count > 1 && ((max_entries != 0 && count > max_entries)
+                       || (max_bytes != 0 && count > max_bytes)))
+  {
+    count /= 2;
+  }
+
+  sharded_lru * cache = malloc(sizeof(sharded_lru) + count * sizeof(lru_shard));
+  if (cache == NULL)
+  {
+    return NULL;
+  }
+
+  cache->shard_mask = count - 1;
+  for (size_t i = 0; i < count; ++i)
+  {
+    lru_shard * const shard = &cache->shards[i];
+    if (pthread_mutex_init(&shard->lock, NULL) != 0)
+    {
+      free_shards(cache, i);
+      return NULL;
+    }
+
+    if (!init_lru(&shard->cache, hasher, key_equal, key_size, value_size, 0))
+    {
+      pthread_mutex_destroy(&shard->lock);
+      free_shards(cache, i);
+      return NULL;
+    }
+
+    /* split the bounds exactly, the first shards take the remainder */
+    shard->cache.max_entries = max_entries / count + (i < max_entries % count);
+    shard->cache.max_bytes = max_bytes / count + (i < max_bytes % count);
+  }
+  return cache;
+}
+
+void delete_slru
+(sharded_lru * const cache)
+{
+  if (cache != NULL)
+  {
+    free_shards(cache, cache->shard_mask + 1);
+  }
+}
+
+void slru_set_evict
+(sharded_lru * const cache, lru_evict_func * on_evict, void * ctx)
+{
+  for (size_t i = 0; i <= cache->shard_mask; ++i)
+  {
+    lru_set_evict(&cache->shards[i].cache, on_evict, ctx);
+  }
+}
+
+bool slru_put
+(sharded_lru * restrict const cache, void const * restrict key, void const * restrict value)
+{
+  lru_shard * const shard = shard_of(cache, key);
+  pthread_mutex_lock(&shard->lock);
+  bool const ok = lru_put(&shard->cache, key, value);
+  pthread_mutex_unlock(&shard->lock);
+  return ok;
+}
+
+bool slru_put_weighted
+(sharded_lru * restrict const cache, void const * restrict key, void const * restrict value,
+ size_t weight)
+{
+  lru_shard * const shard = shard_of(cache, key);
+  pthread_mutex_lock(&shard->lock);
+  bool const ok = lru_put_weighted(&shard->cache, key, value, weight);
+  pthread_mutex_unlock(&shard->lock);
+  return ok;
+}
+
+bool slru_get
+(sharded_lru * restrict const cache, void const * restrict key, void * restrict value)
+{
+  lru_shard * const shard = shard_of(cache, key);
+  pthread_mutex_lock(&shard->lock);
+  void const * found = lru_get(&shard->cache, key);
+  if (found != NULL)
+  {
+    memcpy(value, found, shard->cache.value_blk);
+  }
+  pthread_mutex_unlock(&shard->lock);
+  return found != NULL;
+}
+
+bool slru_remove
+(sharded_lru * restrict const cache, void const * restrict key, void * restrict value)
+{
+  lru_shard * const shard = shard_of(cache, key);
+  pthread_mutex_lock(&shard->lock);
+  bool const ok = lru_remove(&shard->cache, key, value);
+  pthread_mutex_unlock(&shard->lock);
+  return ok;
+}
+
+size_t slru_size
+(sharded_lru * const cache)
+{
+  size_t len = 0;
+  for (size_t i = 0; i <= cache->shard_mask; ++i)
+  {
+    pthread_mutex_lock(&cache->shards[i].lock);
+    len += cache->shards[i].cache.len;
+    pthread_mutex_unlock(&cache->shards[i].lock);
+  }
+  return len;
+}
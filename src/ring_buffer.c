@@ -117,4 +117,16 @@ void ringbuf_foreach
     it(i);
     if ((i += buf->blk) >= buf->end) i = buf->start;
   }
-}
\ No newline at end of file
+}
+
+bool ringbuf_foreach_ctx
+(const ring_buffer * buf, bool (*it)(const void *, void *), void *ctx)
+{
+  char *i = buf->lo;
+  while (i != buf->hi)
+  {
+    if (!it(i, ctx)) return false;
+    if ((i += buf->blk) >= buf->end) i = buf->start;
+  }
+  return true;
+}
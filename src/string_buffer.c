@@ -15,29 +15,46 @@
  */
 
 #include "string_buffer.h"
+#include "huge_alloc.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+static inline
+bool is_inline
+(const string_buffer *buffer)
+{
+  /* heap capacities are always past what fits inline */
+  return buffer->cap < STRBUF_INLINE;
+}
+
+static inline
+char *chars_of
+(const string_buffer *buffer)
+{
+  return is_inline(buffer) ? (char *) buffer->mem.local : buffer->mem.heap;
+}
+
 void init_strbuf
 (string_buffer *buffer)
 {
   buffer->len = 0;
-  buffer->cap = 0;
-  buffer->mem = NULL;
+  buffer->cap = STRBUF_INLINE - 1;
+  buffer->mem.local[0] = '\0';
+  buffer->growth = growth_default();
 }
 
 void free_strbuf
 (string_buffer *buffer)
 {
-  if (buffer->cap > 0)
+  if (!is_inline(buffer))
   {
-    free(buffer->mem);
-
-    buffer->len = 0;
-    buffer->cap = 0;
-    buffer->mem = NULL;
+    huge_free(buffer->mem.heap, buffer->cap + 1);
   }
+
+  buffer->len = 0;
+  buffer->cap = STRBUF_INLINE - 1;
+  buffer->mem.local[0] = '\0';
 }
 
 char *strbuf_copy
@@ -45,60 +62,72 @@ char *strbuf_copy
 {
   size_t length = buffer->len;
   char *cpy = malloc(length + 1);
-  memcpy(cpy, buffer->mem, length);
-  cpy[length + 1] = '\0';
+  if (cpy != NULL)
+  {
+    memcpy(cpy, chars_of(buffer), length + 1);
+  }
   return cpy;
 }
 
 char *cpy_free_strbuf
 (string_buffer *buffer)
 {
-  size_t length = buffer->len;
-  if (length == 0)
+  if (is_inline(buffer))
   {
-    /* allocate an empty string */
-    char *cpy = calloc(1, sizeof(char));
-    free_strbuf(buffer);
+    /* the string lives in the buffer, so it must be copied out */
+    char *cpy = strbuf_copy(buffer);
+    if (cpy != NULL)
+    {
+      free_strbuf(buffer);
+    }
     return cpy;
   }
 
-  /* internal buffer is well formed, so just return that */
-  char *ptr = buffer->mem;
+  /* internal buffer is well formed, so just return that unless mapped */
+  char *ptr = huge_to_malloc(buffer->mem.heap, buffer->cap + 1);
+  if (ptr == NULL)
+  {
+    return NULL;
+  }
+
   buffer->len = 0;
-  buffer->cap = 0;
-  buffer->mem = NULL;
+  buffer->cap = STRBUF_INLINE - 1;
+  buffer->mem.local[0] = '\0';
   return ptr;
 }
 
 void strbuf_clear
 (string_buffer *buffer)
 {
-  buffer->mem[buffer->len = 0] = '\0';
+  chars_of(buffer)[buffer->len = 0] = '\0';
 }
 
 void strbuf_compact
 (string_buffer *buffer)
 {
   size_t len = buffer->len;
-  if (buffer->cap == len)
+  if (buffer->cap == len || is_inline(buffer))
   {
-    /* length already equals to capacity */
+    /* length already equals to capacity, or nothing to release */
     return;
   }
 
-  if (len == 0)
+  if (len < STRBUF_INLINE)
   {
-    /* equivalent operation as free_strbuf */
-    free_strbuf(buffer);
+    /* move the string back into the buffer */
+    char *old_mem = buffer->mem.heap;
+    memcpy(buffer->mem.local, old_mem, len + 1);
+    huge_free(old_mem, buffer->cap + 1);
+    buffer->cap = STRBUF_INLINE - 1;
     return;
   }
 
-  char *new_mem = realloc(buffer->mem, len + 1);
+  char *new_mem = huge_realloc(buffer->mem.heap, buffer->cap + 1, len + 1);
   if (new_mem != NULL)
   {
     /* update cap if memory is resized */
     buffer->cap = len;
-    buffer->mem = new_mem;
+    buffer->mem.heap = new_mem;
   }
 
   /* if realloc failed, continue using the original buffer */
@@ -113,15 +142,47 @@ bool strbuf_ensure_capacity
   }
 
   /* resize buffer to at least n + 1 (null byte) */
-  size_t new_cap = STRBUF_GROW(n + 1);
-  char *new_mem = realloc(buffer->mem, new_cap);
+  size_t new_cap = growth_next(&buffer->growth, buffer->cap, n);
+  char *new_mem;
+  if (is_inline(buffer))
+  {
+    /* first time on the heap, the inline string is copied over */
+    new_mem = huge_alloc(new_cap + 1);
+    if (new_mem != NULL)
+    {
+      memcpy(new_mem, buffer->mem.local, buffer->len + 1);
+    }
+  }
+  else
+  {
+    new_mem = huge_realloc(buffer->mem.heap, buffer->cap + 1, new_cap + 1);
+  }
+
   if (new_mem == NULL)
   {
     return false;
   }
 
   buffer->cap = new_cap;
-  buffer->mem = new_mem;
+  buffer->mem.heap = new_mem;
+  return true;
+}
+
+bool strbuf_set_growth
+(string_buffer *restrict buffer, const growth_policy *restrict policy)
+{
+  growth_policy const fallback = growth_default();
+  if (policy == NULL)
+  {
+    policy = &fallback;
+  }
+
+  if (!growth_valid(policy))
+  {
+    return false;
+  }
+
+  buffer->growth = *policy;
   return true;
 }
 
@@ -133,8 +194,9 @@ bool strbuf_append_ch
     return false;
   }
 
-  buffer->mem[buffer->len++] = ch;
-  buffer->mem[buffer->len] = '\0';
+  char *mem = chars_of(buffer);
+  mem[buffer->len++] = ch;
+  mem[buffer->len] = '\0';
   return true;
 }
 
@@ -146,8 +208,9 @@ bool strbuf_append_nstr
     return false;
   }
 
-  memcpy(&buffer->mem[buffer->len], str, count);
-  buffer->mem[buffer->len += count] = '\0';
+  char *mem = chars_of(buffer);
+  memcpy(&mem[buffer->len], str, count);
+  mem[buffer->len += count] = '\0';
   return true;
 }
 
@@ -172,5 +235,5 @@ size_t strbuf_capacity
 char * strbuf_data
 (const string_buffer *buffer)
 {
-  return buffer->mem == NULL ? "" : buffer->mem;
+  return chars_of(buffer);
 }
\ No newline at end of file
@@ -38,7 +38,7 @@ tmmap_node *create_new_node
 (tree_multimap const * restrict const tree, void const * restrict key, void const * restrict value)
 {
   /* create a blank node */
-  size_t const alloc_cap = TMMAP_GROW(1);
+  size_t const alloc_cap = 1;
   tmmap_node *new_node = malloc(calc_node_size(tree, alloc_cap));
   if (new_node == NULL) return NULL;
 
@@ -102,6 +102,42 @@ void traversal_inorder_lt
   traversal_inorder_lt(tree, node->rhs, key, it);
 }
 
+/**
+ * In-order traversal that stops as soon as it returns false. Only visits the
+ * keys greater than key if dir > 0, lesser than key if dir < 0 and all of
+ * them if dir == 0.
+ *
+ * @return false if the traversal was stopped
+ */
+static
+bool traversal_inorder_ctx
+(tree_multimap const * restrict const tree, tmmap_node const * node, void const * const restrict key, int const dir,
+ tmmap_ctx_it * it, void * ctx)
+{
+  while (node != NULL)
+  {
+    int const cmp = dir == 0 ? 0 : tree->key_compare(key, node->data);
+
+    /* the skipped side is entirely out of range */
+    if (dir > 0 && cmp >= 0)
+    {
+      node = node->rhs;
+      continue;
+    }
+    if (dir < 0 && cmp <= 0)
+    {
+      node = node->lhs;
+      continue;
+    }
+
+    /* visit lhs, data then rhs */
+    if (!traversal_inorder_ctx(tree, node->lhs, key, dir, it, ctx)) return false;
+    if (!it(node->data, node->count, node->data + calc_value_offset(tree, 0), ctx)) return false;
+    node = node->rhs;
+  }
+  return true;
+}
+
 static
 tmmap_node ** find_tree_node
 (tree_multimap const * restrict const tree, void const * restrict const key)
@@ -133,6 +169,7 @@ bool init_tmmap
   tree->value_blk = value_size;
   tree->root = NULL;
   tree->key_compare = key_compare;
+  tmmap_set_growth(tree, NULL);
   return true;
 }
 
@@ -142,6 +179,23 @@ void free_tmmap
   tmmap_clear(tree);
 }
 
+bool tmmap_set_growth
+(tree_multimap * restrict const tree, growth_policy const * restrict policy)
+{
+  growth_policy fallback = growth_default();
+  if (policy == NULL)
+  {
+    /* most keys have few values, do not preallocate many */
+    fallback.min_step = 1;
+    policy = &fallback;
+  }
+
+  if (!growth_valid(policy)) return false;
+
+  tree->growth = *policy;
+  return true;
+}
+
 void tmmap_clear
 (tree_multimap * const tree)
 {
@@ -173,7 +227,7 @@ bool tmmap_put
   size_t const new_size = current->count + 1;
   if (current->cap < new_size)
   {
-    size_t const new_cap = TMMAP_GROW(new_size);
+    size_t const new_cap = growth_next(&tree->growth, current->cap, new_size);
     tmmap_node * resized = realloc(current, calc_node_size(tree, new_cap));
     if (resized == NULL) return false;
     resized->cap = new_cap;
@@ -369,6 +423,24 @@ void tmmap_foreach_lt
   traversal_inorder_lt(tree, tree->root, key, it);
 }
 
+bool tmmap_foreach_ctx
+(tree_multimap const * const tree, tmmap_ctx_it * it, void * ctx)
+{
+  return traversal_inorder_ctx(tree, tree->root, NULL, 0, it, ctx);
+}
+
+bool tmmap_foreach_gt_ctx
+(tree_multimap const * restrict const tree, void const * restrict key, tmmap_ctx_it * it, void * ctx)
+{
+  return traversal_inorder_ctx(tree, tree->root, key, 1, it, ctx);
+}
+
+bool tmmap_foreach_lt_ctx
+(tree_multimap const * restrict const tree, void const * restrict key, tmmap_ctx_it * it, void * ctx)
+{
+  return traversal_inorder_ctx(tree, tree->root, key, -1, it, ctx);
+}
+
 size_t tmmap_size
 (tree_multimap const * const tree)
 {
@@ -84,6 +84,42 @@ void traversal_inorder_lt
   traversal_inorder_lt(tree, node->rhs, key, it);
 }
 
+/**
+ * In-order traversal that stops as soon as it returns false. Only visits the
+ * keys greater than key if dir > 0, lesser than key if dir < 0 and all of
+ * them if dir == 0.
+ *
+ * @return false if the traversal was stopped
+ */
+static
+bool traversal_inorder_ctx
+(tree_multiset const * restrict const tree, tmset_node const * node, void const * const restrict key, int const dir,
+ tmset_ctx_it * it, void * ctx)
+{
+  while (node != NULL)
+  {
+    int const cmp = dir == 0 ? 0 : tree->key_compare(key, node->data);
+
+    /* the skipped side is entirely out of range */
+    if (dir > 0 && cmp >= 0)
+    {
+      node = node->rhs;
+      continue;
+    }
+    if (dir < 0 && cmp <= 0)
+    {
+      node = node->lhs;
+      continue;
+    }
+
+    /* visit lhs, data then rhs */
+    if (!traversal_inorder_ctx(tree, node->lhs, key, dir, it, ctx)) return false;
+    if (!it(node->data, node->count, ctx)) return false;
+    node = node->rhs;
+  }
+  return true;
+}
+
 static
 tmset_node ** find_tree_node
 (tree_multiset const * restrict const tree, void const * restrict const key)
@@ -303,6 +339,24 @@ void tmset_foreach_lt
   traversal_inorder_lt(tree, tree->root, key, it);
 }
 
+bool tmset_foreach_ctx
+(tree_multiset const * const tree, tmset_ctx_it * it, void * ctx)
+{
+  return traversal_inorder_ctx(tree, tree->root, NULL, 0, it, ctx);
+}
+
+bool tmset_foreach_gt_ctx
+(tree_multiset const * restrict const tree, void const * restrict key, tmset_ctx_it * it, void * ctx)
+{
+  return traversal_inorder_ctx(tree, tree->root, key, 1, it, ctx);
+}
+
+bool tmset_foreach_lt_ctx
+(tree_multiset const * restrict const tree, void const * restrict key, tmset_ctx_it * it, void * ctx)
+{
+  return traversal_inorder_ctx(tree, tree->root, key, -1, it, ctx);
+}
+
 size_t tmset_size
 (tree_multiset const * const tree)
 {
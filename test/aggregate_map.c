@@ -0,0 +1,185 @@
+#include "aggregate_map.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define THREADS 4
+#define KEYS 5000
+#define ROUNDS 8
+
+static aggregate_map *counts;
+static aggregate_map *highest;
+
+static
+unsigned long key_hash
+(void const * ptr)
+{
+	int const * key = ptr;
+	return (unsigned long) *key * 2654435761UL;
+}
+
+static
+bool key_eql
+(void const * ptrA, void const * ptrB)
+{
+	return *(int const *) ptrA == *(int const *) ptrB;
+}
+
+static
+void *counter
+(void * arg)
+{
+	int const id = *(int const *) arg;
+	for (int r = 0; r < ROUNDS; ++r)
+	{
+		for (int i = 0; i < KEYS; ++i)
+		{
+			/* every thread walks the keys in a different order */
+			int const key = (i * 7 + id * 1231) % KEYS;
+			agmap_update(counts, &key, key % 3);
+			agmap_update(highest, &key, id * 100 + r);
+		}
+	}
+	return NULL;
+}
+
+int main
+(void)
+{
+	assert(("Keys cannot be empty", new_agmap(0, AGMAP_SUM, NULL, 0) == NULL));
+
+	/* start small so the threads have to grow it */
+	counts = new_agmap(sizeof(int), AGMAP_SUM, &key_hash, 0);
+	highest = new_agmap(sizeof(int), AGMAP_MAX, NULL, 0);
+	assert(("Construct aggregate maps", counts != NULL && highest != NULL));
+
+	int ids[THREADS];
+	pthread_t threads[THREADS];
+	for (int i = 0; i < THREADS; ++i)
+	{
+		ids[i] = i;
+		pthread_create(&threads[i], NULL, &counter, &ids[i]);
+	}
+	for (int i = 0; i < THREADS; ++i)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	for (int key = 0; key < KEYS; ++key)
+	{
+		int64_t value;
+		assert(("Every key was counted", agmap_get(counts, &key, &value)));
+		assert(("Counts add up", value == (int64_t) (key % 3) * THREADS * ROUNDS));
+		assert(("Every key has a maximum", agmap_get(highest, &key, &value)));
+		assert(("Maximum is kept", value == (THREADS - 1) * 100 + ROUNDS - 1));
+	}
+	int64_t value = 42;
+	int const missing = KEYS;
+	assert(("Missing key is not found", !agmap_get(counts, &missing, &value) && value == 42));
+
+	aggregate_map * lowest = new_agmap(sizeof(int), AGMAP_MIN, NULL, 4);
+	int const key = 1;
+	agmap_update(lowest, &key, 5);
+	agmap_update(lowest, &key, -3);
+	agmap_update(lowest, &key, 7);
+	assert(("Minimum is kept", agmap_get(lowest, &key, &value) && value == -3));
+	delete_agmap(lowest);
+
+	/* drain into a list */
+	size_t const record_size = agmap_record_size(counts);
+	size_t const value_off = agmap_value_offset(counts);
+	array_list list;
+	init_arrlist(&list, sizeof(int));
+	assert(("Records must fit the list", !agmap_drain(counts, &list)));
+	free_arrlist(&list);
+
+	init_arrlist(&list, record_size);
+	assert(("Drain into list", agmap_drain(counts, &list)));
+	assert(("One record per key", arrlist_size(&list) == KEYS));
+	int64_t total = 0;
+	for (size_t i = 0; i < arrlist_size(&list); ++i)
+	{
+		unsigned char const * record = arrlist_get(&list, i);
+		int k;
+		int64_t v;
+		memcpy(&k, record, sizeof(int));
+		memcpy(&v, record + value_off, sizeof(int64_t));
+		assert(("Record holds the count", v == (int64_t) (k % 3) * THREADS * ROUNDS));
+		total += v;
+	}
+	printf("Total is %lld\n", (long long) total);
+	assert(("Drained map is empty", !agmap_get(counts, &key, &value)));
+
+	agmap_update(counts, &key, 10);
+	assert(("Drained map is usable", agmap_get(counts, &key, &value) && value == 10));
+	free_arrlist(&list);
+	delete_agmap(counts);
+
+	/* drain into a hash map */
+	hash_map map;
+	init_hmap(&map, &key_hash, &key_eql);
+	init_arrlist(&list, record_size);
+	assert(("Drain into hash map", agmap_drain_hmap(highest, &list, &map)));
+	assert(("One pair per key", hmap_size(&map) == KEYS));
+	int const probe = 17;
+	unsigned char const * record = hmap_get(&map, &probe);
+	assert(("Pair holds the maximum", record != NULL
+		&& memcmp(&(int64_t) { (THREADS - 1) * 100 + ROUNDS - 1 }, record + value_off, sizeof(int64_t)) == 0));
+	free_hmap(&map);
+	free_arrlist(&list);
+	delete_agmap(highest);
+
+	/* many doublings from the smallest capacity, values gather in the last table */
+	aggregate_map * const grown = new_agmap(sizeof(int), AGMAP_MAX, &key_hash, 0);
+	for (int r = 0; r < 3; ++r)
+	{
+		for (int i = 0; i < 100000; ++i)
+		{
+			agmap_update(grown, &i, i * 3 + r);
+		}
+	}
+	for (int i = 0; i < 100000; i += 7)
+	{
+		assert(("Maximum survives the moves", agmap_get(grown, &i, &value) && value == i * 3 + 2));
+	}
+	init_arrlist(&list, record_size);
+	assert(("Drain grown map", agmap_drain(grown, &list)));
+	assert(("One record per key after moves", arrlist_size(&list) == 100000));
+	free_arrlist(&list);
+	delete_agmap(grown);
+
+	/* drain twice into one hash map */
+	aggregate_map * const twice = new_agmap(sizeof(int), AGMAP_SUM, &key_hash, 0);
+	for (int i = 0; i < 100; ++i)
+	{
+		agmap_update(twice, &i, i);
+	}
+	array_list more;
+	init_hmap(&map, &key_hash, &key_eql);
+	init_arrlist(&list, record_size);
+	init_arrlist(&more, record_size);
+	assert(("First drain", agmap_drain_hmap(twice, &list, &map)));
+	for (int i = 100; i < 1000; ++i)
+	{
+		agmap_update(twice, &i, i);
+	}
+	assert(("Records in use cannot grow", !agmap_drain_hmap(twice, &list, &map)));
+	assert(("Refused drain leaves the map", agmap_get(twice, &(int) { 999 }, &value) && value == 999));
+	assert(("Second drain into a new list", agmap_drain_hmap(twice, &more, &map)));
+	assert(("Every key drained", hmap_size(&map) == 1000));
+	for (int i = 0; i < 1000; ++i)
+	{
+		record = hmap_get(&map, &i);
+		assert(("Pair holds the sum", record != NULL
+			&& memcmp(&(int64_t) { i }, record + value_off, sizeof(int64_t)) == 0));
+	}
+	free_hmap(&map);
+	free_arrlist(&more);
+	free_arrlist(&list);
+	delete_agmap(twice);
+
+	printf("\nDONE\n");
+	return 0;
+}
@@ -1,8 +1,10 @@
 #include "array_list.h"
+#include "huge_alloc.h"
 
 #include <assert.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <stdlib.h>
 
 static
 void default_walker
@@ -11,6 +13,54 @@ void default_walker
 	printf("%d ", *(int *) el);
 }
 
+static
+int cmp_int
+(const void * a, const void * b)
+{
+	int const x = *(int const *) a;
+	int const y = *(int const *) b;
+	return (x > y) - (x < y);
+}
+
+typedef struct rec
+{
+	int key;
+	int seq;
+	char name[4];
+} rec;
+
+static
+int cmp_rec
+(const void * a, const void * b)
+{
+	return cmp_int(&((rec const *) a)->key, &((rec const *) b)->key);
+}
+
+static
+bool find_walker
+(const void * el, void * ctx)
+{
+	/* stops once the item is found */
+	return *(int *) el != *(int *) ctx;
+}
+
+static
+bool is_odd
+(const void * el)
+{
+	return *(int const *) el % 2 != 0;
+}
+
+static size_t odd_checks;
+
+static
+bool is_odd_counted
+(const void * el)
+{
+	++odd_checks;
+	return is_odd(el);
+}
+
 int main
 (void)
 {
@@ -26,7 +76,12 @@ int main
 	arrlist_foreach(&list, &default_walker);
 	printf("\nSize is %zu\n", arrlist_size(&list));
 
-	int val = 10;
+	int val = 5;
+	assert(("5 is found", !arrlist_foreach_ctx(&list, &find_walker, &val)));
+	val = 11;
+	assert(("11 is not found", arrlist_foreach_ctx(&list, &find_walker, &val)));
+
+	val = 10;
 	arrlist_remove_last(&list, &val);
 	arrlist_remove_last(&list, &val);
 	arrlist_remove_last(&list, &val);
@@ -54,6 +109,235 @@ int main
 	arrlist_foreach(&list, &default_walker);
 	printf("\nSize is %zu\n", arrlist_size(&list));
 
+	free_arrlist(&list);
+
+	/* appends grow geometrically */
+	init_arrlist(&list, sizeof(int));
+	size_t reallocs = 0;
+	for (int i = 0; i < 1000000; ++i)
+	{
+		size_t const cap = arrlist_capacity(&list);
+		arrlist_add(&list, &i);
+		reallocs += arrlist_capacity(&list) != cap;
+	}
+	printf("\n%zu reallocations for a million appends\n", reallocs);
+	assert(("Appends grow geometrically", reallocs < 40));
+	assert(("Last element is kept", *(int const *) arrlist_get(&list, 999999) == 999999));
+	free_arrlist(&list);
+
+	init_arrlist(&list, sizeof(int));
+	assert(("Factor under 1 is rejected", !arrlist_set_growth(&list, &(growth_policy) { 0.5, 1, 0 })));
+	assert(("Max step under min step is rejected", !arrlist_set_growth(&list, &(growth_policy) { 2, 8, 4 })));
+	assert(("Set doubling", arrlist_set_growth(&list, &(growth_policy) { 2, 4, 0 })));
+	for (int i = 0; i < 5; ++i)
+	{
+		arrlist_add(&list, &i);
+	}
+	assert(("Capacity doubles", arrlist_capacity(&list) == 8));
+	assert(("Set bounded steps", arrlist_set_growth(&list, &(growth_policy) { 2, 1, 100 })));
+	arrlist_ensure_capacity(&list, 1000);
+	assert(("Steps never leave capacity short", arrlist_capacity(&list) == 1000));
+	arrlist_ensure_capacity(&list, 1001);
+	assert(("Steps are bounded", arrlist_capacity(&list) == 1100));
+	free_arrlist(&list);
+
+	/* sorting */
+	init_arrlist(&list, sizeof(int));
+	unsigned seed = 1;
+	for (int i = 0; i < 100000; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		int const v = (int) (seed >> 8) % 1000;
+		arrlist_add(&list, &v);
+	}
+	arrlist_sort(&list, &cmp_int);
+	for (size_t j = 1; j < arrlist_size(&list); ++j)
+	{
+		assert(("Ints are sorted", cmp_int(arrlist_get(&list, j - 1), arrlist_get(&list, j)) <= 0));
+	}
+	free_arrlist(&list);
+
+	/* records are not of a directly sorted size */
+	init_arrlist(&list, sizeof(rec));
+	for (int i = 0; i < 5000; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		arrlist_add(&list, &(rec) { (int) (seed >> 8) % 50, i, "abc" });
+	}
+	assert(("Stable sort", arrlist_sort_stable(&list, &cmp_rec)));
+	for (size_t j = 1; j < arrlist_size(&list); ++j)
+	{
+		rec const * prev = arrlist_get(&list, j - 1);
+		rec const * cur = arrlist_get(&list, j);
+		assert(("Records are sorted", prev->key <= cur->key));
+		assert(("Equal records keep their order", prev->key < cur->key || prev->seq < cur->seq));
+	}
+	arrlist_sort(&list, &cmp_rec);
+	for (size_t j = 1; j < arrlist_size(&list); ++j)
+	{
+		assert(("Sorted records stay sorted", cmp_rec(arrlist_get(&list, j - 1), arrlist_get(&list, j)) <= 0));
+	}
+	free_arrlist(&list);
+
+	/* range operations */
+	init_arrlist(&list, sizeof(int));
+	int const evens[] = { 0, 2, 4, 6, 8 };
+	int const odds[] = { 1, 3, 5, 7, 9 };
+	assert(("Add nothing", arrlist_add_all(&list, evens, 0) && arrlist_size(&list) == 0));
+	assert(("Add all", arrlist_add_all(&list, evens, 5)));
+	assert(("Insert range past the end", !arrlist_insert_range(&list, 6, odds, 5)));
+	assert(("Insert range", arrlist_insert_range(&list, 1, odds, 3)));
+	assert(("Insert range at the end", arrlist_insert_range(&list, 8, odds + 3, 2)));
+	int const mixed[] = { 0, 1, 3, 5, 2, 4, 6, 8, 7, 9 };
+	for (size_t j = 0; j < 10; ++j)
+	{
+		assert(("Range was inserted", *(int const *) arrlist_get(&list, j) == mixed[j]));
+	}
+
+	assert(("Remove empty range", arrlist_remove_range(&list, 4, 4) == 0));
+	assert(("Remove range", arrlist_remove_range(&list, 1, 4) == 3 && arrlist_size(&list) == 7));
+	assert(("Remove range past the end", arrlist_remove_range(&list, 5, 100) == 2 && arrlist_size(&list) == 5));
+	for (size_t j = 0; j < 5; ++j)
+	{
+		assert(("Range was removed", *(int const *) arrlist_get(&list, j) == evens[j]));
+	}
+
+	arrlist_clear(&list);
+	for (int i = 0; i < 100; ++i)
+	{
+		/* runs of odd and even numbers of varying length */
+		int const val = i * (i % 7 < 3 ? 2 : 1);
+		arrlist_add(&list, &val);
+	}
+	assert(("Retain if", arrlist_retain_if(&list, &is_odd) == 100 - 28));
+	for (size_t j = 0; j < arrlist_size(&list); ++j)
+	{
+		assert(("Only odd numbers are kept", is_odd(arrlist_get(&list, j))));
+		assert(("Order is kept", j == 0 || cmp_int(arrlist_get(&list, j - 1), arrlist_get(&list, j)) < 0));
+	}
+	assert(("Remove if", arrlist_remove_if(&list, &is_odd) == 28 && arrlist_size(&list) == 0));
+	assert(("Remove if on empty list", arrlist_remove_if(&list, &is_odd) == 0));
+
+	for (int i = 0; i < 10; ++i)
+	{
+		arrlist_add(&list, &i);
+	}
+	assert(("Remove odd values", arrlist_remove_if(&list, &is_odd_counted) == 5));
+	assert(("One check per item", odd_checks == 10));
+	for (int i = 0; i < 10; ++i)
+	{
+		arrlist_add(&list, &i);
+	}
+	odd_checks = 0;
+	assert(("Retain odd values", arrlist_retain_if(&list, &is_odd_counted) == 10));
+	assert(("One check per item", odd_checks == 15));
+	for (size_t j = 0; j < arrlist_size(&list); ++j)
+	{
+		assert(("Odd values in order", *(int const *) arrlist_get(&list, j) == (int) j * 2 + 1));
+	}
+	free_arrlist(&list);
+
+	/* small lists keep their items inline */
+	init_arrlist(&list, sizeof(int));
+	size_t const inline_cap = ARRLIST_INLINE / sizeof(int);
+	assert(("Inline capacity", arrlist_capacity(&list) == inline_cap));
+	for (int i = 0; i < (int) inline_cap; ++i)
+	{
+		arrlist_add(&list, &i);
+	}
+	char const * data = arrlist_data(&list);
+	assert(("Items are inline", data >= (char const *) &list && data < (char const *) (&list + 1)));
+	int const past = (int) inline_cap;
+	arrlist_add(&list, &past);
+	data = arrlist_data(&list);
+	assert(("Items moved to the heap", data < (char const *) &list || data >= (char const *) (&list + 1)));
+	for (int i = 0; i <= (int) inline_cap; ++i)
+	{
+		assert(("Items survive the move", *(int const *) arrlist_get(&list, i) == i));
+	}
+	arrlist_remove_range(&list, 2, inline_cap);
+	arrlist_compact(&list);
+	assert(("Compact moves items back", arrlist_capacity(&list) == inline_cap));
+	assert(("Items survive compaction", *(int const *) arrlist_get(&list, 1) == 1
+		&& *(int const *) arrlist_get(&list, 2) == past));
+	int * copy = cpy_free_arrlist(&list);
+	assert(("Inline items are copied out", copy[0] == 0 && copy[2] == past));
+	free(copy);
+
+	array_list big;
+	init_arrlist(&big, ARRLIST_INLINE + 1);
+	assert(("Big items never fit inline", arrlist_capacity(&big) == 0));
+	free_arrlist(&big);
+
+	/* big lists are mapped, but still handed out as malloc blocks */
+	init_arrlist(&list, sizeof(int));
+	assert(("Reserve a mapped block", arrlist_ensure_capacity(&list, HUGE_ALLOC_THRESHOLD / sizeof(int))));
+	for (int i = 0; i < 1000; ++i)
+	{
+		arrlist_add(&list, &i);
+	}
+	assert(("Grow the mapped block", arrlist_ensure_capacity(&list, HUGE_ALLOC_THRESHOLD)));
+	assert(("Items survive remapping", *(int const *) arrlist_get(&list, 999) == 999));
+	copy = cpy_free_arrlist(&list);
+	assert(("Mapped items are copied out", copy != NULL && copy[999] == 999));
+	free(copy);
+
+	/* sorted operations */
+	init_arrlist(&list, sizeof(int));
+	for (int i = 0; i < 50; ++i)
+	{
+		/* every even number twice */
+		int const val = i / 2 * 2;
+		assert(("Insert sorted", arrlist_insert_sorted(&list, &val, &cmp_int)));
+	}
+	int key = -1;
+	assert(("Lower bound before all", arrlist_lower_bound(&list, &key, &cmp_int) == 0));
+	key = 10;
+	assert(("Lower bound", arrlist_lower_bound(&list, &key, &cmp_int) == 10));
+	assert(("Upper bound", arrlist_upper_bound(&list, &key, &cmp_int) == 12));
+	assert(("Found", *(int const *) arrlist_bsearch(&list, &key, &cmp_int) == 10));
+	key = 11;
+	assert(("Lower bound between", arrlist_lower_bound(&list, &key, &cmp_int) == 12));
+	assert(("Not found", arrlist_bsearch(&list, &key, &cmp_int) == NULL));
+	key = 100;
+	assert(("Lower bound after all", arrlist_lower_bound(&list, &key, &cmp_int) == 50));
+
+	array_list odd;
+	init_arrlist(&odd, sizeof(int));
+	for (int i = -1; i < 60; i += 2)
+	{
+		arrlist_add(&odd, &i);
+	}
+	assert(("Merge sorted", arrlist_merge_sorted(&list, &odd, &cmp_int) && arrlist_size(&list) == 81));
+	for (size_t j = 1; j < arrlist_size(&list); ++j)
+	{
+		assert(("Merged list is sorted", cmp_int(arrlist_get(&list, j - 1), arrlist_get(&list, j)) <= 0));
+	}
+	free_arrlist(&odd);
+
+	init_arrlist(&odd, sizeof(rec));
+	assert(("Merge needs the same data size", !arrlist_merge_sorted(&list, &odd, &cmp_int)));
+	free_arrlist(&odd);
+
+	assert(("Eytzinger order", arrlist_to_eytzinger(&list)));
+	for (key = -2; key < 62; ++key)
+	{
+		size_t const at = arrlist_eytzinger_lower_bound(&list, &key, &cmp_int);
+		int const expect = key < -1 ? -1 : key % 2 == 0 && key > 48 ? key + 1 : key;
+		if (key > 59)
+		{
+			assert(("Nothing past the end", at == arrlist_size(&list)));
+		}
+		else
+		{
+			assert(("Eytzinger lower bound", *(int const *) arrlist_get(&list, at) == expect));
+		}
+	}
+	assert(("Sorted order", arrlist_from_eytzinger(&list)));
+	for (size_t j = 1; j < arrlist_size(&list); ++j)
+	{
+		assert(("Order is restored", cmp_int(arrlist_get(&list, j - 1), arrlist_get(&list, j)) <= 0));
+	}
 	free_arrlist(&list);
 	printf("\nDONE\n");
 	return 0;
@@ -23,6 +23,20 @@ int comparator
   return ch_a - ch_b;
 }
 
+static
+bool copy_until_comma
+(void const * ptr, void * ctx)
+{
+  char ** out = ctx;
+  char const ch = *(char const *) ptr;
+  if (ch == ',')
+  {
+    return false;
+  }
+  *(*out)++ = ch;
+  return true;
+}
+
 int main
 (int argc, char ** argv)
 {
@@ -187,6 +201,32 @@ int main
 
   printf("DONE %s\n", output);
 
+  /* walk until the comma, from either end, then walk everything */
+
+  for (size_t i = 0; i < str_len; ++i)
+  {
+    list_add_last(&list, hello_world + i);
+  }
+
+  char * cursor = memset(output, 0, sizeof(output));
+  assert(!list_foreach_ctx(&list, &copy_until_comma, &cursor));
+  assert(strcmp(output, "Hello") == 0);
+
+  cursor = memset(output, 0, sizeof(output));
+  assert(!list_reveach_ctx(&list, &copy_until_comma, &cursor));
+  assert(strcmp(output, "!dlroW ") == 0);
+
+  char const ch_comma = ',';
+  list_remove_match(&list, &ch_comma);
+
+  cursor = memset(output, 0, sizeof(output));
+  assert(list_foreach_ctx(&list, &copy_until_comma, &cursor));
+  assert(strcmp(output, "Hello World!") == 0);
+
+  cursor = memset(output, 0, sizeof(output));
+  assert(list_reveach_ctx(&list, &copy_until_comma, &cursor));
+  assert(strcmp(output, "!dlroW olleH") == 0);
+
   free_list(&list);
   return 0;
 }
\ No newline at end of file
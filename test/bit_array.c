@@ -10,6 +10,15 @@ default_walker (bool b)
 	printf("%d ", b);
 }
 
+bool
+count_leading_ones (bool b, void *ctx)
+{
+	if (!b)
+		return false;
+	++*(size_t *) ctx;
+	return true;
+}
+
 int
 main (void)
 {
@@ -30,6 +39,10 @@ main (void)
 	bitarr_foreach(&arr, &default_walker);
 	printf("\n");
 
+	size_t ones = 0;
+	assert(!bitarr_foreach_ctx(&arr, &count_leading_ones, &ones));
+	assert(ones == 3);
+
 	// Perform binary NOT on the array
 	bit_array arr1;
 	init_cpy_bitarr(&arr1, &arr);
@@ -48,6 +61,10 @@ main (void)
 	bitarr_foreach(&arr, &default_walker);
 	printf("\n");
 
+	ones = 0;
+	assert(bitarr_foreach_ctx(&arr, &count_leading_ones, &ones));
+	assert(ones == 10);
+
 	// Clear the array
 	bitarr_clear(&arr);
 
@@ -74,5 +91,16 @@ main (void)
 	free_bitarr(&arr1);
 	free_bitarr(&arr2);
 
+	// Shrinking then growing again leaves the dropped bits unset
+	assert(bitarr_resize(&arr, 40));
+	bitarr_not(&arr);
+	assert(bitarr_resize(&arr, 5));
+	bitarr_compact(&arr);
+	assert(bitarr_resize(&arr, 100));
+	assert(bitarr_get(&arr, 4) && !bitarr_get(&arr, 5) && !bitarr_get(&arr, 39));
+	assert(bitarr_resize(&arr, 0));
+	bitarr_compact(&arr);
+	assert(bitarr_resize(&arr, 3) && !bitarr_get(&arr, 0));
+
 	free_bitarr(&arr);
 }
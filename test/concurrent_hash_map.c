@@ -0,0 +1,104 @@
+#include "concurrent_hash_map.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#define THREADS 4
+#define PER_THREAD 20000
+
+typedef struct int_pair
+{
+	int key;
+	int val;
+} int_pair;
+
+static int_pair pairs[THREADS * PER_THREAD];
+static concurrent_hash_map *map;
+
+static
+unsigned long key_hash
+(void const * ptr)
+{
+	int_pair const * pair = ptr;
+	return (unsigned long) pair->key * 2654435761UL;
+}
+
+static
+bool key_eql
+(void const * ptrA, void const * ptrB)
+{
+	int_pair const * pairA = ptrA;
+	int_pair const * pairB = ptrB;
+	return pairA->key == pairB->key;
+}
+
+static
+void *writer
+(void * arg)
+{
+	int_pair * chunk = arg;
+	for (int i = 0; i < PER_THREAD; ++i)
+	{
+		chmap_put(map, &chunk[i], NULL);
+	}
+
+	/* remove every other pair again */
+	for (int i = 0; i < PER_THREAD; i += 2)
+	{
+		chmap_remove(map, &chunk[i]);
+	}
+	return NULL;
+}
+
+static
+void *reader
+(void * arg)
+{
+	int_pair const * chunk = arg;
+	for (int i = 0; i < PER_THREAD; ++i)
+	{
+		int_pair const * found = chmap_get(map, &chunk[i]);
+		assert(("Readers only see complete pairs", found == NULL || found == &chunk[i]));
+	}
+	return NULL;
+}
+
+int main
+(void)
+{
+	map = new_chmap(&key_hash, &key_eql, 0);
+	assert(("Construct concurrent hash map", map != NULL));
+
+	for (int i = 0; i < THREADS * PER_THREAD; ++i)
+	{
+		pairs[i].key = i;
+		pairs[i].val = -i;
+	}
+
+	pthread_t threads[THREADS * 2];
+	for (int i = 0; i < THREADS; ++i)
+	{
+		pthread_create(&threads[i], NULL, &writer, &pairs[i * PER_THREAD]);
+		pthread_create(&threads[THREADS + i], NULL, &reader, &pairs[i * PER_THREAD]);
+	}
+	for (int i = 0; i < THREADS * 2; ++i)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	printf("Size is %zu\n", chmap_size(map));
+	assert(("Half of the pairs are left", chmap_size(map) == THREADS * PER_THREAD / 2));
+	for (int i = 0; i < THREADS * PER_THREAD; ++i)
+	{
+		assert(("Only odd keys are left", chmap_has_key(map, &pairs[i]) == (i % 2 == 1)));
+	}
+
+	assert(("Cannot put the same key twice", !chmap_put_if_absent(map, &(int_pair) { 1, 0 })));
+	assert(("Replace returns the old pair", chmap_replace(map, &(int_pair) { 1, 0 }) == &pairs[1]));
+
+	chmap_reclaim(map);
+	delete_chmap(map);
+	printf("\nDONE\n");
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "cuckoo_hash_map.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct str_str_pair
+{
+	char const * key;
+	char const * val;
+} str_str_pair;
+
+static
+unsigned long key_hash
+(void const * ptr)
+{
+	str_str_pair const * pair = ptr;
+	char const * key = pair->key;
+	unsigned long hash = 5381;
+	int c;
+	while ((c = *key++))
+	{
+		hash = (hash << 5) + hash + c;
+	}
+	return hash;
+}
+
+static
+unsigned long bad_hash
+(void const * ptr)
+{
+	(void) ptr;
+	return 42;
+}
+
+static
+bool key_eql
+(void const * ptrA, void const * ptrB)
+{
+	str_str_pair const * pairA = ptrA;
+	str_str_pair const * pairB = ptrB;
+	return strcmp(pairA->key, pairB->key) == 0;
+}
+
+static
+void default_walker
+(void const * ptr)
+{
+	str_str_pair const * pair = ptr;
+	printf("%s => %s\n", pair->key, pair->val);
+}
+
+int main
+(void)
+{
+	cuckoo_hash_map map;
+	init_ckmap(&map, &key_hash, &key_eql);
+
+	ckmap_put(&map, &(str_str_pair) { "A", "Apple" }, NULL);
+	ckmap_put(&map, &(str_str_pair) { "B", "Ball" }, NULL);
+	ckmap_put(&map, &(str_str_pair) { "C", "Cat" }, NULL);
+	ckmap_put(&map, &(str_str_pair) { "MLG", "Noscoped" }, NULL);
+	printf("MLG => %s\n\n", ((str_str_pair *) ckmap_get(&map, &(str_str_pair) { "MLG" }))->val);
+	ckmap_foreach(&map, &default_walker);
+	ckmap_remove(&map, &(str_str_pair) { "A" });
+	assert(("Size after remove is 3", ckmap_size(&map) == 3));
+	ckmap_put(&map, &(str_str_pair) { "B", "Bat" }, NULL);
+	printf("\n");
+	ckmap_foreach(&map, &default_walker);
+	printf("\nGet hui (default \"A\") %s\n",
+			((str_str_pair *) ckmap_get_or_default(&map, &(str_str_pair) { "hui", "A" }))->val);
+	printf("Does A exist? %d\n", ckmap_has_key(&map, &(str_str_pair) { "A" }));
+	printf("Does B exist? %d\n", ckmap_has_key(&map, &(str_str_pair) { "B" }));
+	printf("\nFinal size of map: %zu\n", ckmap_size(&map));
+	free_ckmap(&map);
+
+	/* enough pairs to make insertions move others around */
+	enum { COUNT = 20000 };
+	static char keys[COUNT][8];
+	static str_str_pair pairs[COUNT];
+	init_ckmap(&map, &key_hash, &key_eql);
+	for (int i = 0; i < COUNT; ++i)
+	{
+		sprintf(keys[i], "k%d", i);
+		pairs[i] = (str_str_pair) { keys[i], keys[i] };
+		assert(("Put new key", ckmap_put_if_absent(&map, &pairs[i])));
+	}
+	for (int i = 0; i < COUNT; ++i)
+	{
+		assert(("Every key is found", ckmap_get(&map, &pairs[i]) == &pairs[i]));
+	}
+	assert(("Size is the number of keys", ckmap_size(&map) == COUNT));
+	free_ckmap(&map);
+
+	/* the same hashcode everywhere ends up in the overflow list */
+	init_ckmap(&map, &bad_hash, &key_eql);
+	for (int i = 0; i < 100; ++i)
+	{
+		ckmap_put(&map, &pairs[i], NULL);
+	}
+	assert(("Colliding keys are found", ckmap_get(&map, &pairs[99]) == &pairs[99]));
+	assert(("Colliding key is removed", ckmap_remove(&map, &pairs[50]) == &pairs[50]));
+	assert(("Removed key is gone", !ckmap_has_key(&map, &pairs[50])));
+	assert(("Size after remove is 99", ckmap_size(&map) == 99));
+	free_ckmap(&map);
+	return 0;
+}
@@ -0,0 +1,125 @@
+#include "flat_hash_map.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static
+unsigned long int_hash
+(void const * ptr)
+{
+  int const * key = ptr;
+  return (unsigned long) *key * 2654435761UL;
+}
+
+static
+bool int_eql
+(void const * a, void const * b)
+{
+  return *(int const *) a == *(int const *) b;
+}
+
+static
+unsigned long str_hash
+(void const * ptr)
+{
+  char const * const * key = ptr;
+  char const * str = *key;
+  unsigned long hash = 5381;
+  int c;
+  while ((c = *str++))
+  {
+    hash = (hash << 5) + hash + c;
+  }
+  return hash;
+}
+
+static
+bool str_eql
+(void const * a, void const * b)
+{
+  char const * const * strA = a;
+  char const * const * strB = b;
+  return strcmp(*strA, *strB) == 0;
+}
+
+static
+void default_walker
+(void const * key_slot, void const * values)
+{
+  char const * const * key = key_slot;
+  double const * value = values;
+  printf("%s: %g\n", *key, *value);
+}
+
+static
+bool count_walker
+(void const * key_slot, void * values, void * ctx)
+{
+  (void) key_slot;
+  (void) values;
+  return --*(int *) ctx > 0;
+}
+
+int main
+(int argc, char **argv)
+{
+  flat_hash_map map;
+  init_fmap(&map, &str_hash, &str_eql, sizeof(char const *), sizeof(double));
+
+  char const * keys[] = { "Alpha", "Beta", "Gamma", "Alpha" };
+  for (size_t i = 0; i < sizeof(keys) / sizeof(char const *); ++i)
+  {
+    double const value = i * 1.5;
+    fmap_put(&map, &keys[i], &value);
+  }
+
+  fmap_foreach(&map, &default_walker);
+  assert(("Duplicate key is overwritten", fmap_size(&map) == 3));
+  assert(("Alpha has the last value", *(double *) fmap_get(&map, &keys[0]) == 4.5));
+
+  double const other = 100;
+  char const * delta = "Delta";
+  assert(("Beta is not replaced", !fmap_put_if_absent(&map, &keys[1], &other)));
+  assert(("Delta is added", fmap_put_if_absent(&map, &delta, &other)));
+  assert(("Beta is removed", fmap_remove(&map, &keys[1])));
+  assert(("Beta does not exist", !fmap_has_key(&map, &keys[1])));
+  printf("Beta (default 100) %g\n", *(double const *) fmap_get_or_default(&map, &keys[1], &other));
+  free_fmap(&map);
+
+  /* values are updated in place, no allocation per entry */
+  init_fmap(&map, &int_hash, &int_eql, sizeof(int), sizeof(long));
+  for (int i = 0; i < 100000; ++i)
+  {
+    int const key = i % 1000;
+    long * count = fmap_get(&map, &key);
+    if (count == NULL)
+    {
+      long const one = 1;
+      fmap_put(&map, &key, &one);
+    }
+    else
+    {
+      ++*count;
+    }
+  }
+  assert(("1000 distinct keys", fmap_size(&map) == 1000));
+  for (int i = 0; i < 1000; i += 2)
+  {
+    fmap_remove(&map, &i);
+  }
+  for (int i = 0; i < 1000; ++i)
+  {
+    long const * count = fmap_get(&map, &i);
+    assert(("Odd keys were counted", i % 2 ? *count == 100 : count == NULL));
+  }
+
+  int budget = 10;
+  assert(("Stop after ten entries", !fmap_foreach_ctx(&map, &count_walker, &budget)));
+  assert(("Visited ten entries", budget == 0));
+  budget = 501;
+  assert(("Walk all 500 entries", fmap_foreach_ctx(&map, &count_walker, &budget)));
+  assert(("Visited 500 entries", budget == 1));
+  free_fmap(&map);
+  return 0;
+}
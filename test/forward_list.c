@@ -23,6 +23,20 @@ int comparator
   return ch_a - ch_b;
 }
 
+static
+bool copy_until_comma
+(void const * ptr, void * ctx)
+{
+  char ** out = ctx;
+  char const ch = *(char const *) ptr;
+  if (ch == ',')
+  {
+    return false;
+  }
+  *(*out)++ = ch;
+  return true;
+}
+
 int main
 (int argc, char ** argv)
 {
@@ -120,6 +134,25 @@ int main
 
   printf("DONE %s\n", output);
 
+  /* walk until the comma, then walk everything */
+
+  for (size_t i = 0; i < str_len; ++i)
+  {
+    fwdlist_add_first(&list, hello_world + i);
+  }
+  fwdlist_reverse(&list);
+
+  char * cursor = memset(output, 0, sizeof(output));
+  assert(!fwdlist_foreach_ctx(&list, &copy_until_comma, &cursor));
+  assert(strcmp(output, "Hello") == 0);
+
+  char const ch_comma = ',';
+  fwdlist_remove_match(&list, &ch_comma);
+
+  cursor = memset(output, 0, sizeof(output));
+  assert(fwdlist_foreach_ctx(&list, &copy_until_comma, &cursor));
+  assert(strcmp(output, "Hello World!") == 0);
+
   free_fwdlist(&list);
   return 0;
 }
\ No newline at end of file
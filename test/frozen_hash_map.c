@@ -0,0 +1,116 @@
+#include "frozen_hash_map.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct str_str_pair
+{
+	char const * key;
+	char const * val;
+} str_str_pair;
+
+static
+unsigned long key_hash
+(void const * ptr)
+{
+	str_str_pair const * pair = ptr;
+	char const * key = pair->key;
+	unsigned long hash = 5381;
+	int c;
+	while ((c = *key++))
+	{
+		hash = (hash << 5) + hash + c;
+	}
+	return hash;
+}
+
+static
+unsigned long bad_hash
+(void const * ptr)
+{
+	(void) ptr;
+	return 42;
+}
+
+static
+bool key_eql
+(void const * ptrA, void const * ptrB)
+{
+	str_str_pair const * pairA = ptrA;
+	str_str_pair const * pairB = ptrB;
+	return strcmp(pairA->key, pairB->key) == 0;
+}
+
+static
+void default_walker
+(void const * ptr)
+{
+	str_str_pair const * pair = ptr;
+	printf("%s => %s\n", pair->key, pair->val);
+}
+
+static
+bool count_walker
+(void const * ptr, void * ctx)
+{
+	(void) ptr;
+	return --*(int *) ctx > 0;
+}
+
+int main
+(void)
+{
+	hash_map map;
+	frozen_hash_map frozen;
+	init_hmap(&map, &key_hash, &key_eql);
+
+	assert(("Freeze empty map", hmap_freeze(&map, &frozen)));
+	assert(("Empty map has no keys", !fzmap_has_key(&frozen, &(str_str_pair) { "A" })));
+	free_fzmap(&frozen);
+
+	hmap_put(&map, &(str_str_pair) { "A", "Apple" }, NULL);
+	hmap_put(&map, &(str_str_pair) { "B", "Ball" }, NULL);
+	hmap_put(&map, &(str_str_pair) { "C", "Cat" }, NULL);
+	hmap_put(&map, &(str_str_pair) { "MLG", "Noscoped" }, NULL);
+	hmap_remove(&map, &(str_str_pair) { "C" });
+	assert(("Freeze small map", hmap_freeze(&map, &frozen)));
+	fzmap_foreach(&frozen, &default_walker);
+	assert(("Size is 3", fzmap_size(&frozen) == 3));
+	printf("MLG => %s\n", ((str_str_pair const *) fzmap_get(&frozen, &(str_str_pair) { "MLG" }))->val);
+	assert(("C was removed", !fzmap_has_key(&frozen, &(str_str_pair) { "C" })));
+	assert(("hui does not exist", fzmap_get(&frozen, &(str_str_pair) { "hui" }) == NULL));
+	int budget = 2;
+	assert(("Stop after two pairs", !fzmap_foreach_ctx(&frozen, &count_walker, &budget)));
+	free_fzmap(&frozen);
+	free_hmap(&map);
+
+	enum { COUNT = 50000 };
+	static char keys[COUNT][8];
+	static str_str_pair pairs[COUNT];
+	init_hmap(&map, &key_hash, &key_eql);
+	for (int i = 0; i < COUNT; ++i)
+	{
+		sprintf(keys[i], "k%d", i);
+		pairs[i] = (str_str_pair) { keys[i], keys[i] };
+		hmap_put(&map, &pairs[i], NULL);
+	}
+	assert(("Freeze large map", hmap_freeze(&map, &frozen)));
+	for (int i = 0; i < COUNT; ++i)
+	{
+		assert(("Every key is found", fzmap_get(&frozen, &pairs[i]) == &pairs[i]));
+	}
+	assert(("Missing key", !fzmap_has_key(&frozen, &(str_str_pair) { "k-1" })));
+	free_fzmap(&frozen);
+	free_hmap(&map);
+
+	init_hmap(&map, &bad_hash, &key_eql);
+	hmap_put(&map, &(str_str_pair) { "A", "Apple" }, NULL);
+	hmap_put(&map, &(str_str_pair) { "B", "Ball" }, NULL);
+	assert(("Same hashcode cannot be frozen", !hmap_freeze(&map, &frozen)));
+	free_hmap(&map);
+	return 0;
+}
@@ -0,0 +1,63 @@
+#include "hash.h"
+#include "hash_map.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct str_int_pair
+{
+  char const * key;
+  int val;
+} str_int_pair;
+
+int main
+(int argc, char **argv)
+{
+  printf("Seed of this run: %llx\n", (unsigned long long) hash_seed());
+
+  static char text[4096];
+  for (size_t i = 0; i < sizeof(text); ++i)
+  {
+    text[i] = 'a' + i % 26;
+  }
+
+  /* every length goes through a different path, none should collide */
+  for (size_t len = 1; len < sizeof(text); len += len < 300 ? 1 : 61)
+  {
+    assert(("Same bytes hash the same", hash_bytes(text, len) == hash_bytes(text, len)));
+    assert(("Lengths are distinguished", hash_bytes(text, len) != hash_bytes(text, len - 1)));
+    assert(("Seed changes hashcode",
+        hash_bytes_seeded(text, len, 1) != hash_bytes_seeded(text, len, 2)));
+
+    text[len / 2] ^= 1;
+    uint64_t const flipped = hash_bytes(text, len);
+    text[len / 2] ^= 1;
+    assert(("Every byte matters", flipped != hash_bytes(text, len)));
+  }
+
+  assert(("String hash matches bytes", hash_str("Hello") == hash_bytes("Hello", 5)));
+  assert(("Integers are mixed", hash_u64(1) != hash_u64(2) && hash_u32(7) == hash_u64(7)));
+  assert(("Zero seed is rejected", !hash_set_seed(0)));
+
+  hash_map map;
+  init_hmap(&map, &hash_key_str, &equal_key_str);
+  char keys[100][8];
+  str_int_pair pairs[100];
+  for (int i = 0; i < 100; ++i)
+  {
+    sprintf(keys[i], "key%d", i);
+    pairs[i] = (str_int_pair) { keys[i], i };
+    hmap_put(&map, &pairs[i], NULL);
+  }
+  str_int_pair const * found = hmap_get(&map, &(str_int_pair) { "key42" });
+  assert(("Ready-made string key functions", found != NULL && found->val == 42));
+  free_hmap(&map);
+
+  init_hmap(&map, &hash_cstr, &equal_cstr);
+  hmap_put(&map, "Alpha", NULL);
+  hmap_put(&map, "Beta", NULL);
+  assert(("Strings as keys", hmap_has_key(&map, "Beta") && !hmap_has_key(&map, "Gamma")));
+  free_hmap(&map);
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include "hash_map.h"
 
+#include <assert.h>
 #include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -36,6 +37,44 @@ bool key_eql
 	return strcmp(pairA->key, pairB->key) == 0;
 }
 
+static
+void const *keep_first
+(void const * kept, void const * merged, void * ctx)
+{
+	++*(size_t *) ctx;
+	return kept;
+}
+
+static
+unsigned long key_hash_fnv
+(void const * ptr)
+{
+	str_str_pair const * pair = ptr;
+	unsigned long hash = 2166136261u;
+	for (char const * key = pair->key; *key; ++key)
+	{
+		hash = (hash ^ (unsigned char) *key) * 16777619u;
+	}
+	return hash;
+}
+
+static size_t dropped;
+
+static
+void count_drop
+(void const * pair)
+{
+	++dropped;
+}
+
+static
+bool count_walker
+(void const * ptr, void * ctx)
+{
+	(void) ptr;
+	return --*(int *) ctx > 0;
+}
+
 static
 void default_walker
 (void const * ptr)
@@ -57,6 +96,7 @@ main (void)
 	printf("MLG => %s\n\n", ((str_str_pair *) hmap_get(&map, &(str_str_pair) { "MLG" }))->key);
 	hmap_foreach(&map, &default_walker);
 	hmap_remove(&map, &(str_str_pair) { "A" });
+	assert(("Size after remove is 3", hmap_size(&map) == 3));
 	hmap_put(&map, &(str_str_pair) { "B", "Bat" }, NULL);
 	printf("\n");
 	hmap_foreach(&map, &default_walker);
@@ -65,6 +105,238 @@ main (void)
 	printf("Does A exist? %d\n", hmap_has_key(&map, &(str_str_pair) { "A" }));
 	printf("Does B exist? %d\n", hmap_has_key(&map, &(str_str_pair) { "B" }));
 	printf("\nFinal size of map: %zu\n", hmap_size(&map));
+
+	void const * probes[] = { &(str_str_pair) { "A" }, &(str_str_pair) { "B" }, &(str_str_pair) { "MLG" } };
+	void const * found[3];
+	bool exists[3];
+	hmap_get_many(&map, probes, 3, found);
+	assert(("Batch: A was removed", found[0] == NULL));
+	assert(("Batch: B is Bat", strcmp(((str_str_pair const *) found[1])->val, "Bat") == 0));
+	assert(("Batch: two keys exist", hmap_has_key_many(&map, probes, 3, exists) == 2));
+	assert(("Batch: MLG exists", exists[2]));
+
+	int budget = 2;
+	assert(("Stop after two pairs", !hmap_foreach_ctx(&map, &count_walker, &budget)));
+	assert(("Visited two pairs", budget == 0));
+	budget = 4;
+	assert(("Walk all three pairs", hmap_foreach_ctx(&map, &count_walker, &budget)));
+	assert(("Visited three pairs", budget == 1));
+	free_hmap(&map);
+
+	/* big enough to be built by several threads */
+	enum { BULK = 40000 };
+	static char bulk_keys[BULK][8];
+	static str_str_pair bulk_pairs[BULK];
+	static void const * bulk_ptrs[BULK + 1];
+	for (int i = 0; i < BULK; ++i)
+	{
+		sprintf(bulk_keys[i], "k%d", i);
+		bulk_pairs[i] = (str_str_pair) { bulk_keys[i], "old" };
+		bulk_ptrs[i] = &bulk_pairs[i];
+	}
+	bulk_ptrs[BULK] = &(str_str_pair) { "k7", "new" };
+	assert(("Bulk build", hmap_build_from(&map, &key_hash, &key_eql, bulk_ptrs, BULK + 1, 2)));
+	assert(("Bulk size", hmap_size(&map) == BULK));
+	assert(("Later duplicate wins",
+			strcmp(((str_str_pair const *) hmap_get(&map, &(str_str_pair) { "k7" }))->val, "new") == 0));
+
+	hmap_statistics stats;
+	hmap_stats(&map, &stats);
+	size_t binned = 0;
+	for (int i = 0; i < HMAP_STATS_BINS; ++i)
+	{
+		binned += stats.probe_hist[i];
+	}
+	printf("\nMean probe distance %.3f, longest %zu, longest cluster %zu\n",
+			stats.mean_probe, stats.max_probe, stats.longest_cluster);
+	assert(("Every pair is in the histogram", binned == hmap_size(&map)));
+	assert(("Clusters are shorter than the map", stats.longest_cluster < hmap_capacity(&map)));
+#ifdef HMAP_STATS
+	assert(("Every new pair was hashed", stats.hasher_calls >= BULK + 1));
+#else
+	assert(("Nothing is counted", stats.hasher_calls == 0 && stats.resizes == 0));
+#endif
+	free_hmap(&map);
+
+	init_hmap_flags(&map, &key_hash, &key_eql, HMAP_ROBIN_HOOD);
+	hmap_put(&map, &(str_str_pair) { "A", "Apple" }, NULL);
+	hmap_put(&map, &(str_str_pair) { "B", "Ball" }, NULL);
+	hmap_put(&map, &(str_str_pair) { "C", "Cat" }, NULL);
+	hmap_remove(&map, &(str_str_pair) { "B" });
+	assert(("Robin hood: B was removed", !hmap_has_key(&map, &(str_str_pair) { "B" })));
+	assert(("Robin hood: C still exists", hmap_has_key(&map, &(str_str_pair) { "C" })));
+	assert(("Robin hood: size is 2", hmap_size(&map) == 2));
+	free_hmap(&map);
+
+	/* set algebra: a holds k0 to k29999, b holds k20000 to k39999 */
+	unsigned const layouts[] = { 0, HMAP_ROBIN_HOOD, HMAP_INCREMENTAL };
+	for (int l = 0; l < 3; ++l)
+	{
+		hash_map a, b;
+		init_hmap_flags(&a, &key_hash, &key_eql, layouts[l]);
+		init_hmap_flags(&b, &key_hash, &key_eql, layouts[l]);
+		for (int i = 0; i < 30000; ++i)
+		{
+			hmap_put(&a, &bulk_pairs[i], NULL);
+			hmap_put(&b, &bulk_pairs[BULK - 1 - i], NULL);
+		}
+		for (int i = 0; i < 10000; ++i)
+		{
+			hmap_remove(&b, &bulk_pairs[i + 10000]);
+		}
+
+		hash_map merged;
+		init_hmap_flags(&merged, &key_hash, &key_eql, layouts[l]);
+		size_t conflicts = 0;
+		assert(("Merge into empty", hmap_merge(&merged, &a, NULL, NULL)));
+		assert(("Merge overlapping", hmap_merge(&merged, &b, &keep_first, &conflicts)));
+		assert(("Merged size is the union", hmap_size(&merged) == BULK));
+		assert(("Resolve is called for shared keys", conflicts == 10000));
+
+		hash_map common;
+		init_hmap_flags(&common, &key_hash, &key_eql, layouts[l]);
+		hmap_merge(&common, &merged, NULL, NULL);
+		assert(("Intersect", hmap_intersect(&common, &a, NULL) && hmap_intersect(&common, &b, NULL)));
+		assert(("Intersection size", hmap_size(&common) == 10000));
+		assert(("Intersection keeps shared keys",
+				hmap_has_key(&common, &bulk_pairs[25000]) && !hmap_has_key(&common, &bulk_pairs[5000])));
+
+		assert(("Difference", hmap_difference(&merged, &b, NULL)));
+		assert(("Difference size", hmap_size(&merged) == 20000));
+		assert(("Difference removes other keys",
+				hmap_has_key(&merged, &bulk_pairs[19999]) && !hmap_has_key(&merged, &bulk_pairs[20000])));
+		assert(("Difference from bigger map", hmap_difference(&a, &common, NULL)));
+		assert(("Difference leaves the rest", hmap_size(&a) == 20000 && hmap_has_key(&a, &bulk_pairs[0])));
+
+		dropped = 0;
+		assert(("Difference from smaller map", hmap_difference(&common, &a, &count_drop)));
+		assert(("Nothing in common is dropped", dropped == 0 && hmap_size(&common) == 10000));
+		assert(("Intersect with drop", hmap_intersect(&common, &merged, &count_drop)));
+		assert(("Every pair is dropped", dropped == 10000 && hmap_size(&common) == 0));
+
+		free_hmap(&common);
+		free_hmap(&merged);
+		free_hmap(&b);
+		free_hmap(&a);
+	}
+
+	/* incremental resizing: every operation while buckets are migrating */
+	static str_str_pair renamed[BULK];
+	init_hmap_flags(&map, &key_hash, &key_eql, HMAP_INCREMENTAL);
+	int filled = 0;
+	while (map.old_cap == 0 || filled < 20000)
+	{
+		hmap_put(&map, &bulk_pairs[filled++], NULL);
+	}
+	assert(("Migration is in progress", map.old_cap != 0));
+	for (int i = 0; i < filled; ++i)
+	{
+		assert(("Get while migrating", hmap_get(&map, &bulk_pairs[i]) == &bulk_pairs[i]));
+	}
+	assert(("Missing key while migrating", !hmap_has_key(&map, &bulk_pairs[filled])));
+
+	enum { TOUCHED = 300 };
+	for (int i = 0; i < TOUCHED; i += 3)
+	{
+		assert(("Still migrating", map.old_cap != 0));
+		renamed[i] = (str_str_pair) { bulk_keys[i], "replaced" };
+		assert(("Replace while migrating", hmap_replace(&map, &renamed[i]) == &bulk_pairs[i]));
+	}
+	for (int i = 1; i < TOUCHED; i += 3)
+	{
+		assert(("Still migrating", map.old_cap != 0));
+		assert(("Remove while migrating", hmap_remove(&map, &bulk_pairs[i]) == &bulk_pairs[i]));
+	}
+	assert(("Still migrating", map.old_cap != 0));
+	void const * repl = NULL;
+	assert(("Put over a key while migrating", hmap_put(&map, &bulk_pairs[2], &repl) && repl == &bulk_pairs[2]));
+	assert(("Put a new key while migrating", hmap_put(&map, &bulk_pairs[filled], NULL)));
+
+	size_t const live = filled - TOUCHED / 3 + 1;
+	assert(("Size while migrating", hmap_size(&map) == live));
+	while (hmap_migrate(&map, 7))
+	{
+		assert(("Migration makes progress", map.old_cap != 0));
+	}
+	assert(("Migration is done", map.old_cap == 0 && !hmap_migrate(&map, 1)));
+	for (int i = 0; i <= filled; ++i)
+	{
+		void const * got = hmap_get(&map, &bulk_pairs[i]);
+		void const * want = i >= TOUCHED || i % 3 == 2 ? &bulk_pairs[i]
+			: i % 3 == 0 ? (void const *) &renamed[i] : NULL;
+		assert(("Pairs survive the migration", got == want));
+	}
+
+	free_hmap(&map);
+
+	/* rehashing in the middle of a migration moves everything at once */
+	init_hmap_flags(&map, &key_hash, &key_eql, HMAP_INCREMENTAL);
+	filled = 0;
+	while (map.old_cap == 0 || filled < 1000)
+	{
+		hmap_put(&map, &bulk_pairs[filled++], NULL);
+	}
+	assert(("Rehash while migrating", hmap_rehash(&map, &key_hash_fnv)));
+	assert(("Rehash finishes the migration", map.old_cap == 0 && hmap_size(&map) == (size_t) filled));
+	for (int i = 0; i < filled; ++i)
+	{
+		assert(("Pairs survive the rehash", hmap_get(&map, &bulk_pairs[i]) == &bulk_pairs[i]));
+	}
+	assert(("Missing key after rehash", !hmap_has_key(&map, &bulk_pairs[filled])));
 	free_hmap(&map);
+
+	/*
+	 * batches on maps past the size where lookups are interleaved (262144
+	 * buckets in src/hash_map.c), hits and misses mixed, in every layout and
+	 * during a migration
+	 */
+	enum { BIG = 240000, PROBES = 5000 };
+	char (* big_keys)[16] = malloc(sizeof(*big_keys) * (BIG + PROBES));
+	str_str_pair * big_pairs = malloc(sizeof(*big_pairs) * (BIG + PROBES));
+	void const ** big_probes = malloc(sizeof(*big_probes) * PROBES * 2);
+	void const ** big_found = malloc(sizeof(*big_found) * PROBES * 2);
+	bool * big_exists = malloc(sizeof(*big_exists) * PROBES * 2);
+	for (int i = 0; i < BIG + PROBES; ++i)
+	{
+		sprintf(big_keys[i], "%s%d", i < BIG ? "b" : "miss", i);
+		big_pairs[i] = (str_str_pair) { big_keys[i], "big" };
+	}
+	for (int i = 0; i < PROBES; ++i)
+	{
+		big_probes[i * 2] = &big_pairs[(size_t) i * 47 % BIG];
+		big_probes[i * 2 + 1] = &big_pairs[BIG + i];
+	}
+
+	for (int l = 0; l < 3; ++l)
+	{
+		init_hmap_flags(&map, &key_hash, &key_eql, layouts[l]);
+		for (int i = 0; i < BIG && (i < BIG / 2 || map.old_cap == 0); ++i)
+		{
+			hmap_put(&map, &big_pairs[i], NULL);
+		}
+		assert(("Big enough to interleave", hmap_capacity(&map) >= 262144));
+		assert(("Incremental map is migrating", layouts[l] != HMAP_INCREMENTAL || map.old_cap != 0));
+
+		hmap_get_many(&map, big_probes, PROBES * 2, big_found);
+		size_t hits = 0;
+		for (int i = 0; i < PROBES * 2; ++i)
+		{
+			assert(("Batch matches single lookups", big_found[i] == hmap_get(&map, big_probes[i])));
+			assert(("Missing keys miss", i % 2 == 0 || big_found[i] == NULL));
+			hits += big_found[i] != NULL;
+		}
+		assert(("Batch has hits and misses", hits > 0 && hits <= PROBES));
+		assert(("Batch key checks", hmap_has_key_many(&map, big_probes, PROBES * 2, big_exists) == hits));
+		for (int i = 0; i < PROBES * 2; ++i)
+		{
+			assert(("Batch key checks match", big_exists[i] == (big_found[i] != NULL)));
+		}
+		free_hmap(&map);
+	}
+	free(big_exists);
+	free(big_found);
+	free(big_probes);
+	free(big_pairs);
+	free(big_keys);
 	return 0;
 }
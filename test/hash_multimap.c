@@ -0,0 +1,134 @@
+#include "hash_multimap.h"
+#include "hash.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static
+void default_walker
+(void const * key_slot, size_t matches, void const * values)
+{
+  char const * const * key = key_slot;
+  int const *ints = values;
+  printf("%s(%zu): ", *key, matches);
+  for (size_t i = 0; i < matches; ++i)
+  {
+    printf("%d ", ints[i]);
+  }
+  puts("");
+}
+
+int main
+(int argc, char **argv)
+{
+  hash_multimap map;
+  init_hmmap(&map, &hash_key_str, &equal_key_str, sizeof(char const *), sizeof(int));
+
+  static char const * const test_data[] =
+  {
+    "PzrhlPLqET",
+    "SEpxydXyeY",
+    "RfQzoZeUWt",
+
+    "Alpha",
+    "Alpha",
+    "Gamma",
+
+    "Remove this",
+    "Remove this",
+    "Remove this",
+    "Remove this",
+    "Remove this",
+    "Remove this",
+  };
+
+  for (int i = 0; i < (int) (sizeof(test_data) / sizeof(char const *)); ++i)
+  {
+    hmmap_put(&map, &test_data[i], &i);
+  }
+
+  int tmp = 100;
+  char const * str = "Beta";
+  assert(hmmap_put_if_absent(&map, &str, &tmp) == true);
+
+  tmp = 101;
+  assert(hmmap_put_if_absent(&map, &str, &tmp) == false);
+
+  hmmap_foreach(&map, &default_walker);
+  printf("Map size: %zu\n\n", hmmap_size(&map));
+  assert(hmmap_size(&map) == 13);
+
+  str = "Alpha";
+  assert(hmmap_count_matches(&map, &str) == 2);
+
+  str = "Foo";
+  assert(hmmap_count_matches(&map, &str) == 0);
+  assert(hmmap_get(&map, &str, NULL) == NULL);
+
+  str = "Remove this";
+  assert(hmmap_remove_values(&map, &str, 1, 3) == 2);
+  size_t matches;
+  int const * values = hmmap_get(&map, &str, &matches);
+  assert(matches == 4 && values[0] == 6 && values[1] == 9);
+  tmp = 100;
+  hmmap_put(&map, &str, &tmp);
+  assert(hmmap_count_matches(&map, &str) == 5);
+  assert(hmmap_remove_values(&map, &str, 0, 100) == 5);
+  assert(!hmmap_has_key(&map, &str));
+
+  str = "Alpha";
+  assert(hmmap_remove(&map, &str));
+  hmmap_foreach(&map, &default_walker);
+  printf("Map size: %zu\n\n", hmmap_size(&map));
+  assert(hmmap_size(&map) == 5);
+
+  str = "Beta";
+  printf("Beta --> %d\n", *(int const *) hmmap_get(&map, &str, NULL));
+
+  /* many values per key move the node around */
+  assert(!hmmap_set_growth(&map, &(growth_policy) { 0.5, 1, 0 }));
+  assert(!hmmap_set_growth(&map, &(growth_policy) { 2, 8, 4 }));
+  assert(hmmap_set_growth(&map, &(growth_policy) { 2, 8, 0 }));
+  str = "Many";
+  for (int i = 0; i < 1000; ++i)
+  {
+    hmmap_put(&map, &str, &i);
+  }
+  values = hmmap_get(&map, &str, &matches);
+  assert(matches == 1000 && values[999] == 999);
+
+  assert(hmmap_set_growth(&map, NULL));
+  str = "More";
+  for (int i = 0; i < 1000; ++i)
+  {
+    hmmap_put(&map, &str, &i);
+  }
+  values = hmmap_get(&map, &str, &matches);
+  assert(matches == 1000 && values[0] == 0 && values[999] == 999);
+
+  hmmap_clear(&map);
+  assert(hmmap_size(&map) == 0);
+  free_hmmap(&map);
+
+  /* values are aligned like malloc would align them */
+  typedef struct { char c; long double v; } align_probe;
+  size_t const align = offsetof(align_probe, v);
+  init_hmmap(&map, &hash_key_u32, &equal_key_u32, sizeof(uint32_t), sizeof(long double));
+  for (uint32_t i = 0; i < 8; ++i)
+  {
+    long double const value = i / 3.0L;
+    hmmap_put(&map, &i, &value);
+    hmmap_put(&map, &i, &value);
+  }
+  for (uint32_t i = 0; i < 8; ++i)
+  {
+    long double const * found = hmmap_get(&map, &i, &matches);
+    assert(matches == 2 && (uintptr_t) found % align == 0);
+    assert(found[0] == i / 3.0L && found[1] == i / 3.0L);
+  }
+  free_hmmap(&map);
+  return 0;
+}
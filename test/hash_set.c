@@ -0,0 +1,81 @@
+#include "hash_set.h"
+#include "hash.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <stdbool.h>
+
+static
+void default_walker
+(void const * key_slot)
+{
+  char const * const * key = key_slot;
+  printf("%s\n", *key);
+}
+
+int main
+(int argc, char **argv)
+{
+  hash_set set;
+  init_hset(&set, &hash_key_str, &equal_key_str, sizeof(char const *));
+
+  static char const * const test_data[] =
+  {
+    "PzrhlPLqET",
+    "SEpxydXyeY",
+    "RfQzoZeUWt",
+    "rYxhygHpTi",
+    "zuGxHdVzmr",
+
+    "Alpha",
+    "Alpha",
+    "Gamma",
+    "Zeta",
+  };
+
+  for (size_t i = 0; i < sizeof(test_data) / sizeof(char const *); ++i)
+  {
+    hset_put(&set, &test_data[i]);
+  }
+
+  char const * str = "Beta";
+  assert(hset_put_if_absent(&set, &str) == true);
+
+  assert(hset_put_if_absent(&set, &str) == false);
+
+  hset_foreach(&set, &default_walker);
+  printf("Set size: %zu\n\n", hset_size(&set));
+  assert(hset_size(&set) == 9);
+
+  str = "Gamma";
+  printf("Set has 'Gamma'?: %d\n", hset_has_key(&set, &str));
+
+  str = "Foo";
+  printf("Set has 'Foo'?: %d\n", hset_has_key(&set, &str));
+
+  str = "Alpha";
+  assert(hset_remove(&set, &str) == true);
+  assert(hset_remove(&set, &str) == false);
+  assert(hset_has_key(&set, &str) == false);
+  hset_foreach(&set, &default_walker);
+  printf("Set size: %zu\n\n", hset_size(&set));
+
+  /* keys are stored by value, the local can change */
+  int num;
+  hash_set ints;
+  init_hset(&ints, &hash_key_u32, &equal_key_u32, sizeof(int));
+  for (num = 0; num < 1000; ++num)
+  {
+    hset_put(&ints, &num);
+  }
+  num = 999;
+  assert(hset_has_key(&ints, &num));
+  num = 1000;
+  assert(!hset_has_key(&ints, &num));
+  assert(hset_size(&ints) == 1000);
+
+  free_hset(&ints);
+  free_hset(&set);
+  return 0;
+}
@@ -0,0 +1,235 @@
+#include "hash_snapshot.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct int_pair
+{
+	uint64_t key;
+	uint64_t val;
+} int_pair;
+
+static
+unsigned long int_hash
+(void const * ptr)
+{
+	return ((int_pair const *) ptr)->key * 0x9E3779B97F4A7C15u;
+}
+
+static
+bool int_eql
+(void const * ptrA, void const * ptrB)
+{
+	return ((int_pair const *) ptrA)->key == ((int_pair const *) ptrB)->key;
+}
+
+typedef struct str_str_pair
+{
+	char const * key;
+	char const * val;
+} str_str_pair;
+
+static
+unsigned long djb2
+(char const * key)
+{
+	unsigned long hash = 5381;
+	int c;
+	while ((c = *key++))
+	{
+		hash = (hash << 5) + hash + c;
+	}
+	return hash;
+}
+
+static
+unsigned long pair_hash
+(void const * ptr)
+{
+	return djb2(((str_str_pair const *) ptr)->key);
+}
+
+static
+bool pair_eql
+(void const * ptrA, void const * ptrB)
+{
+	return strcmp(((str_str_pair const *) ptrA)->key, ((str_str_pair const *) ptrB)->key) == 0;
+}
+
+/* stored as "key\0val\0", looked up by the key string alone */
+static
+size_t pair_writer
+(void const * ptr, void * out)
+{
+	str_str_pair const * pair = ptr;
+	size_t const klen = strlen(pair->key) + 1;
+	size_t const vlen = strlen(pair->val) + 1;
+	if (out != NULL)
+	{
+		memcpy(out, pair->key, klen);
+		memcpy((char *) out + klen, pair->val, vlen);
+	}
+	return klen + vlen;
+}
+
+static
+unsigned long stored_hash
+(void const * ptr)
+{
+	return djb2(ptr);
+}
+
+static
+bool stored_eql
+(void const * stored, void const * key)
+{
+	return strcmp(stored, key) == 0;
+}
+
+static
+char const * stored_val
+(void const * stored)
+{
+	return (char const *) stored + strlen(stored) + 1;
+}
+
+static
+bool sum_walker
+(void const * pair, void * ctx)
+{
+	*(uint64_t *) ctx += ((int_pair const *) pair)->val;
+	return true;
+}
+
+/* the header fields the corruption tests change, as 64-bit words */
+enum { HEAD_CAP = 4, HEAD_CTRL_OFF, HEAD_SLOTS_OFF, HEAD_DATA_OFF, HEAD_DATA_SIZE };
+
+static
+unsigned char * read_file
+(char const * path, size_t * size)
+{
+	FILE * f = fopen(path, "rb");
+	fseek(f, 0, SEEK_END);
+	*size = (size_t) ftell(f);
+	rewind(f);
+	unsigned char * bytes = malloc(*size);
+	*size = fread(bytes, 1, *size, f);
+	fclose(f);
+	return bytes;
+}
+
+/**
+ * Writes bytes as a snapshot and checks that opening it fails.
+ */
+static
+bool rejected
+(char const * path, unsigned char const * bytes, size_t size)
+{
+	FILE * f = fopen(path, "wb");
+	fwrite(bytes, 1, size, f);
+	fclose(f);
+
+	hash_snapshot snap;
+	if (init_hsnap(&snap, path, &int_hash, &int_eql))
+	{
+		free_hsnap(&snap);
+		return false;
+	}
+	return true;
+}
+
+static
+bool rejected_with
+(char const * path, unsigned char const * bytes, size_t size, size_t field, uint64_t value)
+{
+	unsigned char * copy = malloc(size);
+	memcpy(copy, bytes, size);
+	memcpy(copy + field * sizeof(uint64_t), &value, sizeof(value));
+	bool const ok = rejected(path, copy, size);
+	free(copy);
+	return ok;
+}
+
+int main
+(void)
+{
+	char const * path = "hash_snapshot_test.bin";
+
+	enum { COUNT = 1000 };
+	static int_pair pairs[COUNT];
+	hash_map map;
+	init_hmap(&map, &int_hash, &int_eql);
+	uint64_t expected = 0;
+	for (int i = 0; i < COUNT; ++i)
+	{
+		pairs[i] = (int_pair) { i, i * 3 };
+		expected += i * 3;
+		hmap_put(&map, &pairs[i], NULL);
+	}
+	hmap_remove(&map, &(int_pair) { 5 });
+	expected -= 15;
+	assert(("Write flat pairs", hmap_write_snapshot(&map, path, sizeof(int_pair), NULL)));
+	free_hmap(&map);
+
+	hash_snapshot snap;
+	assert(("Open flat pairs", init_hsnap(&snap, path, &int_hash, &int_eql)));
+	assert(("Snapshot size", hsnap_size(&snap) == COUNT - 1));
+	assert(("Removed key is not stored", !hsnap_has_key(&snap, &(int_pair) { 5 })));
+	for (int i = 0; i < COUNT; ++i)
+	{
+		int_pair const * pair = hsnap_get(&snap, &(int_pair) { i });
+		assert(("Every other key is stored", i == 5 || (pair != NULL && pair->val == (uint64_t) i * 3)));
+	}
+	uint64_t sum = 0;
+	assert(("Visit every pair", hsnap_foreach_ctx(&snap, &sum_walker, &sum)));
+	assert(("Sum of the values", sum == expected));
+	free_hsnap(&snap);
+
+	/* damaged files are rejected instead of pointing outside the mapping */
+	size_t size;
+	unsigned char * bytes = read_file(path, &size);
+	uint64_t head[9];
+	memcpy(head, bytes, sizeof(head));
+	assert(("Truncated", rejected(path, bytes, size - 8)));
+	assert(("Capacity wraps", rejected_with(path, bytes, size, HEAD_CAP, UINT64_C(1) << 63)));
+	assert(("Control bytes wrap", rejected_with(path, bytes, size, HEAD_CTRL_OFF, UINT64_MAX - 8)));
+	assert(("Misaligned slots", rejected_with(path, bytes, size, HEAD_SLOTS_OFF, head[HEAD_SLOTS_OFF] + 4)));
+	assert(("Data past the end", rejected_with(path, bytes, size, HEAD_DATA_SIZE, head[HEAD_DATA_SIZE] + 8)));
+
+	size_t full = head[HEAD_CTRL_OFF];
+	while (bytes[full] & 0x80)
+	{
+		++full;
+	}
+	size_t const slot = head[HEAD_SLOTS_OFF] + ((full - head[HEAD_CTRL_OFF]) * 2 + 1) * sizeof(uint64_t);
+	uint64_t offset;
+	memcpy(&offset, bytes + slot, sizeof(offset));
+	memcpy(bytes + slot, &head[HEAD_DATA_SIZE], sizeof(offset));
+	assert(("Pair past the data", rejected(path, bytes, size)));
+	offset += 4;
+	memcpy(bytes + slot, &offset, sizeof(offset));
+	assert(("Misaligned pair", rejected(path, bytes, size)));
+	free(bytes);
+
+	init_hmap(&map, &pair_hash, &pair_eql);
+	hmap_put(&map, &(str_str_pair) { "A", "Apple" }, NULL);
+	hmap_put(&map, &(str_str_pair) { "B", "Ball" }, NULL);
+	hmap_put(&map, &(str_str_pair) { "MLG", "Noscoped" }, NULL);
+	assert(("Write serialized pairs", hmap_write_snapshot(&map, path, 0, &pair_writer)));
+	free_hmap(&map);
+
+	assert(("Open serialized pairs", init_hsnap(&snap, path, &stored_hash, &stored_eql)));
+	printf("MLG => %s\n", stored_val(hsnap_get(&snap, "MLG")));
+	assert(("B is Ball", strcmp(stored_val(hsnap_get(&snap, "B")), "Ball") == 0));
+	assert(("C is not stored", hsnap_get(&snap, "C") == NULL));
+	free_hsnap(&snap);
+
+	assert(("Not a snapshot", !init_hsnap(&snap, "CMakeLists.txt", &stored_hash, &stored_eql)
+			&& !init_hsnap(&snap, "does/not/exist", &stored_hash, &stored_eql)));
+	remove(path);
+	return 0;
+}
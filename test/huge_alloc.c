@@ -0,0 +1,50 @@
+#include "huge_alloc.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main
+(void)
+{
+  /* small blocks behave like malloc */
+  char * small = huge_calloc(100);
+  assert(("Small block is zeroed", small != NULL && small[0] == 0 && small[99] == 0));
+  strcpy(small, "abc");
+  small = huge_realloc(small, 100, 200);
+  assert(("Small block keeps contents", strcmp(small, "abc") == 0));
+  free(huge_to_malloc(small, 200));
+
+  /* mapped blocks only touch the pages that are written */
+  size_t const size = HUGE_ALLOC_THRESHOLD;
+  char * big = huge_calloc(size);
+  assert(("Big block is allocated", big != NULL));
+  assert(("Big block is zeroed", big[0] == 0 && big[size - 1] == 0));
+  big[0] = 'a';
+  big[size - 1] = 'z';
+
+  big = huge_realloc(big, size, size * 4);
+  assert(("Big block grows", big != NULL));
+  assert(("Growth keeps contents", big[0] == 'a' && big[size - 1] == 'z'));
+  assert(("Growth is zeroed", big[size] == 0 && big[size * 4 - 1] == 0));
+  big[size * 4 - 1] = 'y';
+
+  big = huge_realloc(big, size * 4, size * 2);
+  assert(("Big block shrinks", big != NULL && big[size - 1] == 'z'));
+
+  big = huge_realloc(big, size * 2, 4096);
+  assert(("Block moves back to malloc", big != NULL && big[0] == 'a'));
+  big = huge_realloc(big, 4096, size);
+  assert(("Block moves to a mapping", big != NULL && big[0] == 'a'));
+
+  char * freeable = huge_to_malloc(big, size);
+  assert(("Mapped block is turned", freeable != NULL && freeable[0] == 'a'));
+  free(freeable);
+
+  huge_free(huge_alloc(size * 2), size * 2);
+  huge_free(NULL, size);
+
+  printf("DONE\n");
+  return 0;
+}
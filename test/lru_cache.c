@@ -0,0 +1,172 @@
+#include "lru_cache.h"
+#include "hash.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define THREADS 4
+#define PER_THREAD 20000
+
+static
+void count_evict
+(void const * key, void const * value, void * ctx)
+{
+  (void) key;
+  (void) value;
+  ++*(size_t *) ctx;
+}
+
+static
+bool print_entry
+(void const * key, void const * value, void * ctx)
+{
+  (void) ctx;
+  printf("%u=%u ", *(uint32_t const *) key, *(uint32_t const *) value);
+  return true;
+}
+
+static sharded_lru *shared;
+
+static
+void *worker
+(void * arg)
+{
+  uint32_t const base = *(uint32_t const *) arg;
+  for (uint32_t i = 0; i < PER_THREAD; ++i)
+  {
+    uint32_t const key = base + i % 1000;
+    uint32_t value;
+    if (slru_get(shared, &key, &value))
+    {
+      assert(("Shared values match their keys", value == key * 3));
+    }
+    else
+    {
+      value = key * 3;
+      slru_put(shared, &key, &value);
+    }
+  }
+  return NULL;
+}
+
+int main
+(int argc, char **argv)
+{
+  lru_cache cache;
+  assert(("Keys cannot be empty", !init_lru(&cache, &hash_key_u32, &equal_key_u32, 0, 4, 3)));
+  init_lru(&cache, &hash_key_u32, &equal_key_u32, sizeof(uint32_t), sizeof(uint32_t), 3);
+
+  size_t evicted = 0;
+  lru_set_evict(&cache, &count_evict, &evicted);
+
+  for (uint32_t i = 1; i <= 3; ++i)
+  {
+    uint32_t const value = i * 10;
+    assert(("Put entry", lru_put(&cache, &i, &value)));
+  }
+
+  uint32_t key = 1;
+  assert(("Get marks as used", *(uint32_t const *) lru_get(&cache, &key) == 10));
+
+  key = 4;
+  lru_put(&cache, &key, &(uint32_t) { 40 });
+  lru_foreach_ctx(&cache, &print_entry, NULL);
+  puts("");
+  assert(("Bounded by entries", lru_size(&cache) == 3));
+  assert(("Least recently used is evicted", !lru_has_key(&cache, &(uint32_t) { 2 })));
+  assert(("Eviction is reported", evicted == 1));
+
+  key = 3;
+  assert(("Peek finds entry", *(uint32_t const *) lru_peek(&cache, &key) == 30));
+  key = 5;
+  lru_put(&cache, &key, &(uint32_t) { 50 });
+  assert(("Peek does not mark as used", !lru_has_key(&cache, &(uint32_t) { 3 })));
+
+  key = 4;
+  lru_put(&cache, &key, &(uint32_t) { 44 });
+  assert(("Replaced value is reported", evicted == 3));
+  assert(("Value is replaced", *(uint32_t const *) lru_peek(&cache, &key) == 44));
+
+  uint32_t removed = 0;
+  assert(("Remove entry", lru_remove(&cache, &key, &removed) && removed == 44));
+  assert(("Removal is not reported", evicted == 3));
+  assert(("Missing key is not removed", !lru_remove(&cache, &key, NULL)));
+
+  assert(("Evict the oldest", lru_evict(&cache) && !lru_has_key(&cache, &(uint32_t) { 1 })));
+  assert(("Only one entry left", lru_size(&cache) == 1));
+
+  /* bound by weight */
+  lru_set_bounds(&cache, 0, 100);
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    assert(("Put weighted entry", lru_put_weighted(&cache, &i, &i, 30)));
+  }
+  printf("Bytes: %zu\n", lru_bytes(&cache));
+  assert(("Bounded by bytes", lru_bytes(&cache) == 90 && lru_size(&cache) == 3));
+  assert(("Too heavy to cache", !lru_put_weighted(&cache, &key, &key, 101)));
+
+  key = 8;
+  lru_put_weighted(&cache, &key, &key, 70);
+  assert(("Heavier value pushes others out", lru_size(&cache) == 2 && lru_bytes(&cache) == 100));
+  key = 0;
+  lru_put_weighted(&cache, &key, &key, 80);
+  assert(("New entry pushes others out", lru_size(&cache) == 1 && lru_has_key(&cache, &key)));
+
+  evicted = 0;
+  lru_clear(&cache);
+  assert(("Clearing is reported", evicted == 1 && lru_size(&cache) == 0));
+  free_lru(&cache);
+
+  /* values are aligned like malloc would align them */
+  typedef struct { char c; long double v; } align_probe;
+  size_t const align = offsetof(align_probe, v);
+  init_lru(&cache, &hash_key_u32, &equal_key_u32, sizeof(uint32_t), sizeof(long double), 0);
+  for (uint32_t i = 0; i < 8; ++i)
+  {
+    long double const value = i / 3.0L;
+    lru_put(&cache, &i, &value);
+  }
+  for (uint32_t i = 0; i < 8; ++i)
+  {
+    long double const * found = lru_get(&cache, &i);
+    assert(("Value is aligned", (uintptr_t) found % align == 0));
+    assert(("Value is kept", *found == i / 3.0L));
+  }
+  free_lru(&cache);
+
+  /* the global bound holds even with fewer entries than shards */
+  shared = new_slru(&hash_key_u32, &equal_key_u32, sizeof(uint32_t), sizeof(uint32_t), 5, 0, 16);
+  for (uint32_t i = 0; i < 1000; ++i)
+  {
+    slru_put(shared, &i, &i);
+  }
+  assert(("Small sharded cache is exactly full", slru_size(shared) == 5));
+  delete_slru(shared);
+
+  /* sharded */
+  shared = new_slru(&hash_key_u32, &equal_key_u32, sizeof(uint32_t), sizeof(uint32_t), 2048, 0, 0);
+  assert(("Construct sharded cache", shared != NULL));
+
+  uint32_t bases[THREADS];
+  pthread_t threads[THREADS];
+  for (int i = 0; i < THREADS; ++i)
+  {
+    bases[i] = i * 500;
+    pthread_create(&threads[i], NULL, &worker, &bases[i]);
+  }
+  for (int i = 0; i < THREADS; ++i)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  printf("Sharded size: %zu\n", slru_size(shared));
+  assert(("Sharded cache stays bounded", slru_size(shared) <= 2048));
+  assert(("Sharded cache is filled", slru_size(shared) > 1024));
+  delete_slru(shared);
+
+  printf("\nDONE\n");
+  return 0;
+}
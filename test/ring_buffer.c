@@ -1,6 +1,7 @@
 #include "ring_buffer.h"
 
 #include <stdio.h>
+#include <assert.h>
 
 static
 void iterate
@@ -9,6 +10,19 @@ void iterate
   printf("%d ", *(const int *) data);
 }
 
+static
+bool sum_until_negative
+(const void * data, void * ctx)
+{
+  int const value = *(const int *) data;
+  if (value < 0)
+  {
+    return false;
+  }
+  *(int *) ctx += value;
+  return true;
+}
+
 int main
 (int argc, char **argv)
 {
@@ -24,6 +38,10 @@ int main
   ringbuf_foreach(&buf, &iterate);
   puts("");
 
+  int sum = 0;
+  assert(("Stop at -54", !ringbuf_foreach_ctx(&buf, &sum_until_negative, &sum)));
+  assert(("Sum before -54", sum == 1 + 124 + 973));
+
   printf("current element: %d\n", *(const int *) ringbuf_peek(&buf));
 
   while (!ringbuf_empty(&buf))
@@ -45,6 +63,10 @@ int main
   ringbuf_foreach(&buf, &iterate);
   puts("");
 
+  sum = 0;
+  assert(("Walk every element", ringbuf_foreach_ctx(&buf, &sum_until_negative, &sum)));
+  assert(("Sum of every element", sum == 500));
+
   free_ringbuf(&buf);
 
   return 0;
@@ -24,6 +24,47 @@ int main
   char * str = cpy_free_strbuf(&strbuf);
   assert(("str == \"Hello, world!\"", strcmp("Hello, world!", str) == 0));
 
+  free(str);
+
+  init_strbuf(&strbuf);
+  strbuf_set_growth(&strbuf, &(growth_policy) { 2, 1, 0 });
+  size_t reallocs = 0;
+  for (int i = 0; i < 100000; ++i)
+  {
+    size_t const cap = strbuf_capacity(&strbuf);
+    strbuf_append_ch(&strbuf, 'a' + i % 26);
+    reallocs += strbuf_capacity(&strbuf) != cap;
+  }
+  assert(("Appends grow geometrically", reallocs <= 18));
+  assert(("Buffer ends with the last char", strbuf_data(&strbuf)[99999] == 'a' + 99999 % 26));
+  assert(("Buffer is terminated", strbuf_data(&strbuf)[100000] == '\0'));
+  free_strbuf(&strbuf);
+
+  /* short strings stay inside the buffer */
+  init_strbuf(&strbuf);
+  strbuf_clear(&strbuf);
+  assert(("Inline capacity", strbuf_capacity(&strbuf) == STRBUF_INLINE - 1));
+  for (size_t i = 0; i < STRBUF_INLINE - 1; ++i)
+  {
+    strbuf_append_ch(&strbuf, 'x');
+  }
+  char const * data = strbuf_data(&strbuf);
+  assert(("String is inline", data >= (char const *) &strbuf && data < (char const *) (&strbuf + 1)));
+  str = strbuf_copy(&strbuf);
+  assert(("Copy is terminated", strlen(str) == STRBUF_INLINE - 1));
+  free(str);
+
+  strbuf_append_str(&strbuf, "yz");
+  data = strbuf_data(&strbuf);
+  assert(("String moved to the heap", data < (char const *) &strbuf || data >= (char const *) (&strbuf + 1)));
+  assert(("String survives the move", strlen(data) == STRBUF_INLINE + 1 && data[STRBUF_INLINE] == 'z'));
+
+  strbuf_clear(&strbuf);
+  strbuf_append_str(&strbuf, "short");
+  strbuf_compact(&strbuf);
+  assert(("Compact moves string back", strbuf_capacity(&strbuf) == STRBUF_INLINE - 1));
+  str = cpy_free_strbuf(&strbuf);
+  assert(("Inline string is copied out", strcmp("short", str) == 0));
   free(str);
   return 0;
 }
\ No newline at end of file
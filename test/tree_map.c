@@ -1,5 +1,6 @@
 #include "tree_map.h"
 
+#include <assert.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -26,6 +27,15 @@ void default_walker
   printf("%s: %d\n", *key, *ints);
 }
 
+static
+bool count_walker
+(void const * key_slot, void const * values, void * ctx)
+{
+  /* stops after visiting 3 entries */
+  size_t * count = ctx;
+  return ++*count < 3;
+}
+
 int main
 (int argc, char **argv)
 {
@@ -99,6 +109,15 @@ int main
   printf("\nThings greater than \"a\":\n");
   tmap_foreach_gt(&tree, &str, &default_walker);
 
+  size_t count = 0;
+  assert(("Stop after three of five", !tmap_foreach_gt_ctx(&tree, &str, &count_walker, &count)));
+  assert(("Visited three", count == 3));
+
+  str = "x";
+  count = 0;
+  assert(("Walk both entries past x", tmap_foreach_gt_ctx(&tree, &str, &count_walker, &count)));
+  assert(("Visited two", count == 2));
+
   free_tmap(&tree);
   return 0;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "tree_multimap.h"
 
+#include <assert.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -31,6 +32,16 @@ void default_walker
   puts("");
 }
 
+static
+bool count_walker
+(void const * key_slot, size_t matches, void const * values, void * ctx)
+{
+  (void) key_slot;
+  (void) matches;
+  (void) values;
+  return --*(int *) ctx > 0;
+}
+
 int main
 (int argc, char **argv)
 {
@@ -121,6 +132,25 @@ int main
   printf("\nThings greater than \"a\":\n");
   tmmap_foreach_gt(&tree, &str, &default_walker);
 
+  int budget = 3;
+  assert(("Stop after three keys", !tmmap_foreach_ctx(&tree, &count_walker, &budget)));
+  assert(("Visited three keys", budget == 0));
+  budget = 12;
+  assert(("Walk all eleven keys", tmmap_foreach_ctx(&tree, &count_walker, &budget)));
+  assert(("Visited eleven keys", budget == 1));
+
+  free_tmmap(&tree);
+
+  /* many values under one key */
+  init_tmmap(&tree, &string_cmp, sizeof(char const *), sizeof(int));
+  str = "Many";
+  for (int i = 0; i < 100000; ++i)
+  {
+    tmmap_put(&tree, &str, &i);
+  }
+  size_t matches;
+  int const * values = tmmap_get(&tree, &str, &matches);
+  assert(("Every value is kept", matches == 100000 && values[99999] == 99999));
   free_tmmap(&tree);
   return 0;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "tree_multiset.h"
 
+#include <assert.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -25,6 +26,15 @@ void default_walker
   printf("%s(%zu)\n", *key, matches);
 }
 
+static
+bool count_walker
+(void const * key_slot, size_t matches, void * ctx)
+{
+  (void) key_slot;
+  (void) matches;
+  return --*(int *) ctx > 0;
+}
+
 int main
 (int argc, char **argv)
 {
@@ -93,6 +103,13 @@ int main
   printf("\nThings greater than \"a\":\n");
   tmset_foreach_gt(&tree, &str, &default_walker);
 
+  int budget = 3;
+  assert(("Stop after three keys", !tmset_foreach_ctx(&tree, &count_walker, &budget)));
+  assert(("Visited three keys", budget == 0));
+  budget = 13;
+  assert(("Walk all twelve keys", tmset_foreach_ctx(&tree, &count_walker, &budget)));
+  assert(("Visited twelve keys", budget == 1));
+
   free_tmset(&tree);
   return 0;
 }
\ No newline at end of file
@@ -23,6 +23,14 @@ void default_walker
   printf("%s\n", *key);
 }
 
+static
+bool count_walker
+(void const * key_slot, void * ctx)
+{
+  (void) key_slot;
+  return --*(int *) ctx > 0;
+}
+
 int main
 (int argc, char **argv)
 {
@@ -88,6 +96,13 @@ int main
   printf("\nThings greater than \"a\":\n");
   tset_foreach_gt(&tree, &str, &default_walker);
 
+  int budget = 3;
+  assert(("Stop after three keys", !tset_foreach_ctx(&tree, &count_walker, &budget)));
+  assert(("Visited three keys", budget == 0));
+  budget = 12;
+  assert(("Walk all eleven keys", tset_foreach_ctx(&tree, &count_walker, &budget)));
+  assert(("Visited eleven keys", budget == 1));
+
   free_tset(&tree);
   return 0;
 }
\ No newline at end of file
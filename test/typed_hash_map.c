@@ -0,0 +1,67 @@
+#include "typed_hash_map.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define INT_HASH(k) ((unsigned long) (k) * 2654435761UL)
+#define INT_EQ(a, b) ((a) == (b))
+
+HMAP_DEFINE(int_map, int, double, INT_HASH, INT_EQ)
+
+static
+unsigned long str_hash
+(char const * str)
+{
+  unsigned long hash = 5381;
+  int c;
+  while ((c = *str++))
+  {
+    hash = (hash << 5) + hash + c;
+  }
+  return hash;
+}
+
+#define STR_EQ(a, b) (strcmp((a), (b)) == 0)
+
+HMAP_DEFINE(str_map, char const *, int, str_hash, STR_EQ)
+
+static
+void default_walker
+(char const * const * key, int * value)
+{
+  printf("%s: %d\n", *key, *value);
+}
+
+int main
+(int argc, char **argv)
+{
+  int_map ints;
+  init_int_map(&ints);
+  for (int i = 0; i < 10000; ++i)
+  {
+    int_map_put(&ints, i, i / 2.0);
+  }
+  for (int i = 0; i < 10000; i += 3)
+  {
+    int_map_remove(&ints, i);
+  }
+  assert(("Removed every third key", int_map_size(&ints) == 6666));
+  assert(("Removed key is gone", int_map_get(&ints, 300) == NULL));
+  assert(("Value is stored", *int_map_get(&ints, 301) == 150.5));
+  assert(("Existing key is kept", !int_map_put_if_absent(&ints, 302, 0)));
+  *int_map_get(&ints, 302) += 1;
+  assert(("Value is updated in place", *int_map_get(&ints, 302) == 152));
+  free_int_map(&ints);
+
+  str_map strs;
+  init_str_map(&strs);
+  str_map_put(&strs, "A", 1);
+  str_map_put(&strs, "B", 2);
+  str_map_put(&strs, "A", 3);
+  str_map_foreach(&strs, &default_walker);
+  assert(("Duplicate key is overwritten", str_map_size(&strs) == 2 && *str_map_get(&strs, "A") == 3));
+  assert(("Missing key", !str_map_has_key(&strs, "C")));
+  free_str_map(&strs);
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include "typed_sort.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define INT_LESS(a, b) ((a) < (b))
+
+SORT_DEFINE(int_sort, int, INT_LESS)
+
+typedef struct pair
+{
+  char const * name;
+  int age;
+} pair;
+
+#define AGE_LESS(a, b) ((a).age < (b).age)
+
+SORT_DEFINE(pair_sort, pair, AGE_LESS)
+
+#define BY_VALUE(a, b) (ctx[a] < ctx[b])
+
+SORT_DEFINE_CTX(index_sort, size_t, double const *, BY_VALUE)
+
+enum { COUNT = 200000 };
+
+static int ints[COUNT];
+
+int main
+(int argc, char **argv)
+{
+  /* random, sorted, reversed, few distinct and organ pipe inputs */
+  for (int pattern = 0; pattern < 5; ++pattern)
+  {
+    unsigned seed = 7;
+    for (int i = 0; i < COUNT; ++i)
+    {
+      seed = seed * 1103515245 + 12345;
+      switch (pattern)
+      {
+        case 0: ints[i] = (int) (seed >> 4); break;
+        case 1: ints[i] = i; break;
+        case 2: ints[i] = COUNT - i; break;
+        case 3: ints[i] = (seed >> 16) % 4; break;
+        default: ints[i] = i < COUNT / 2 ? i : COUNT - i; break;
+      }
+    }
+
+    int_sort(ints, COUNT);
+    for (int i = 1; i < COUNT; ++i)
+    {
+      assert(("Ints are sorted", ints[i - 1] <= ints[i]));
+    }
+  }
+
+  pair people[] =
+  {
+    { "Dan", 40 }, { "Ann", 25 }, { "Bob", 40 }, { "Cid", 25 }, { "Eve", 31 },
+  };
+  assert(("Stable sort", pair_sort_stable(people, 5)));
+  printf("By age:");
+  for (int i = 0; i < 5; ++i)
+  {
+    printf(" %s(%d)", people[i].name, people[i].age);
+  }
+  puts("");
+  assert(("Equal ages keep their order",
+      strcmp(people[0].name, "Ann") == 0 && strcmp(people[1].name, "Cid") == 0
+      && strcmp(people[3].name, "Dan") == 0 && strcmp(people[4].name, "Bob") == 0));
+
+  double const values[] = { 0.5, -1, 3, 2 };
+  size_t order[] = { 0, 1, 2, 3 };
+  index_sort(order, 4, values);
+  assert(("Indices follow the values",
+      order[0] == 1 && order[1] == 0 && order[2] == 3 && order[3] == 2));
+
+  printf("\nDONE\n");
+  return 0;
+}